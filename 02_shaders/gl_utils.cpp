@@ -3,6 +3,15 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define GL_LOG_FILE "gl.log"
 #define MAX_SHADER_LENGTH 262144
@@ -122,3 +131,145 @@ void _update_fps_counter(GLFWwindow* window) {
 	}
 	frame_count++;
 }
+
+bool map_file(const char* file_name, mapped_file* mf) {
+	mf->data = NULL;
+	mf->size = 0;
+#ifdef _WIN32
+	mf->file = INVALID_HANDLE_VALUE;
+	mf->mapping = NULL;
+	HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		gl_log_err("ERROR: opening file for reading: %s\n", file_name);
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		gl_log_err("ERROR: reading size of file %s\n", file_name);
+		CloseHandle(file);
+		return false;
+	}
+	mf->file = file;
+	mf->size = (size_t)size.QuadPart;
+	if (mf->size == 0) {
+		mf->data = "";
+		return true;
+	}
+	mf->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mf->mapping) {
+		mf->data = (const char*)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		gl_log_err("ERROR: opening file for reading: %s\n", file_name);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		gl_log_err("ERROR: reading size of file %s\n", file_name);
+		close(fd);
+		return false;
+	}
+	mf->size = (size_t)st.st_size;
+	if (mf->size == 0) {
+		// mmap refuses zero-length mappings
+		close(fd);
+		mf->data = "";
+		return true;
+	}
+	void* p = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (p != MAP_FAILED) {
+		mf->data = (const char*)p;
+	}
+#endif
+	if (!mf->data) {
+		gl_log_err("ERROR: could not map file %s\n", file_name);
+		unmap_file(mf);
+		return false;
+	}
+	return true;
+}
+
+void unmap_file(mapped_file* mf) {
+#ifdef _WIN32
+	if (mf->data && mf->size > 0) {
+		UnmapViewOfFile(mf->data);
+	}
+	if (mf->mapping) {
+		CloseHandle(mf->mapping);
+	}
+	if (mf->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mf->file);
+	}
+	mf->mapping = NULL;
+	mf->file = INVALID_HANDLE_VALUE;
+#else
+	if (mf->data && mf->size > 0) {
+		munmap((void*)mf->data, mf->size);
+	}
+#endif
+	mf->data = NULL;
+	mf->size = 0;
+}
+
+/*-----------------------------GL STATE CACHE--------------------------------*/
+#define GL_STATE_UNKNOWN 0xFFFFFFFF
+
+struct gl_state_shadow {
+	GLuint programme;
+	GLuint vao;
+	GLint viewport[4];
+};
+
+static gl_state_shadow g_state = { GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, { -1, -1, -1, -1 } };
+static gl_state_counters g_state_counters;
+
+void gl_state_reset() {
+	g_state.programme = GL_STATE_UNKNOWN;
+	g_state.vao = GL_STATE_UNKNOWN;
+	for (int i = 0; i < 4; i++) {
+		g_state.viewport[i] = -1;
+	}
+}
+
+// true if the value differs from the cached one, and updates the cache
+static inline bool state_changed(GLuint* cached, GLuint value) {
+	if (*cached == value) {
+		g_state_counters.skipped++;
+		return false;
+	}
+	*cached = value;
+	g_state_counters.issued++;
+	return true;
+}
+
+void gl_state_use_programme(GLuint programme) {
+	if (state_changed(&g_state.programme, programme)) {
+		glUseProgram(programme);
+	}
+}
+
+void gl_state_bind_vao(GLuint vao) {
+	if (state_changed(&g_state.vao, vao)) {
+		glBindVertexArray(vao);
+	}
+}
+
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	GLint* v = g_state.viewport;
+	if (v[0] == x && v[1] == y && v[2] == width && v[3] == height) {
+		g_state_counters.skipped++;
+		return;
+	}
+	v[0] = x;
+	v[1] = y;
+	v[2] = width;
+	v[3] = height;
+	g_state_counters.issued++;
+	glViewport(x, y, width, height);
+}
+
+const gl_state_counters* gl_state_get_counters() { return &g_state_counters; }
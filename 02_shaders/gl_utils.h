@@ -3,6 +3,7 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <cstdarg>
+#include <cstddef>
 
 #define GL_LOG_FILE "gl.log"
 
@@ -26,3 +27,34 @@ void _update_fps_counter(GLFWwindow* window);
 
 void glfw_framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
+// read-only view of a whole file. data is NOT null-terminated - use size
+struct mapped_file {
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
+
+// memory-maps the whole file, no size limit and no copy
+bool map_file(const char* file_name, mapped_file* mf);
+
+void unmap_file(mapped_file* mf);
+
+/* the part of 03's gl_state cache that this chapter's loop needs. each call
+compares against what was last set and only reaches GL when the value changes.
+everything starts as unknown, so the first call always goes through. call
+gl_state_reset() if GL state is changed behind the cache's back */
+struct gl_state_counters {
+	unsigned long long issued;  // calls that reached GL
+	unsigned long long skipped; // calls dropped because nothing changed
+};
+
+void gl_state_reset();
+
+void gl_state_use_programme(GLuint programme);
+void gl_state_bind_vao(GLuint vao);
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+const gl_state_counters* gl_state_get_counters();
@@ -155,19 +155,22 @@ int main() {
 
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	gl_state_bind_vao(vao);
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
-	char vertex_shader[1024 * 256];
-	char fragment_shader[1024 * 256];
-	parse_file_into_str("test_vs.glsl", vertex_shader, 1024 * 256);
-	parse_file_into_str("test_fs.glsl", fragment_shader, 1024 * 256);
+	mapped_file vertex_shader, fragment_shader;
+	if (!map_file("test_vs.glsl", &vertex_shader) || !map_file("test_fs.glsl", &fragment_shader)) {
+		return 1;
+	}
 
+	// the mapped files aren't null-terminated, so pass the lengths too
 	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-	const GLchar* p = (const GLchar*)vertex_shader;
-	glShaderSource(vs, 1, &p, NULL);
+	const GLchar* p = (const GLchar*)vertex_shader.data;
+	GLint length = (GLint)vertex_shader.size;
+	glShaderSource(vs, 1, &p, &length);
+	unmap_file(&vertex_shader);
 	glCompileShader(vs);
 
 	int params;
@@ -179,8 +182,10 @@ int main() {
 	}
 
 	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-	p = (const GLchar*)fragment_shader;
-	glShaderSource(fs, 1, &p, NULL);
+	p = (const GLchar*)fragment_shader.data;
+	length = (GLint)fragment_shader.size;
+	glShaderSource(fs, 1, &p, &length);
+	unmap_file(&fragment_shader);
 	glCompileShader(fs);
 
 	glGetShaderiv(fs, GL_COMPILE_STATUS, &params);
@@ -207,16 +212,17 @@ int main() {
 
 	GLint colour_loc = glGetUniformLocation(shader_programme, "inputColour");
 	assert(colour_loc > -1);
-	glUseProgram(shader_programme);
+	gl_state_use_programme(shader_programme);
 	glUniform4f(colour_loc, 1.0f, 0.0f, 0.0f, 1.0f);
 
 	while (!glfwWindowShouldClose(g_window)) {
 		_update_fps_counter(g_window);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, g_gl_width, g_gl_height);
+		gl_state_viewport(0, 0, g_gl_width, g_gl_height);
 
-		glUseProgram(shader_programme);
-		glBindVertexArray(vao);
+		// these only reach GL when the values change
+		gl_state_use_programme(shader_programme);
+		gl_state_bind_vao(vao);
 		glDrawArrays(GL_TRIANGLES, 0, 3);
 		glfwPollEvents();
 		if (glfwGetKey(g_window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -225,6 +231,8 @@ int main() {
 		glfwSwapBuffers(g_window);
 	}
 
+	const gl_state_counters* counters = gl_state_get_counters();
+	gl_log("state cache: %llu calls issued, %llu skipped\n", counters->issued, counters->skipped);
 	glfwTerminate();
 	return 0;
 }
\ No newline at end of file
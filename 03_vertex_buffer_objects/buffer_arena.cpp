@@ -0,0 +1,238 @@
+#include "buffer_arena.h"
+#include "gl_utils.h"
+#include <algorithm>
+
+static size_t round_up(size_t n, size_t alignment) { return (n + alignment - 1) / alignment * alignment; }
+
+bool buffer_arena_create(buffer_arena* arena, size_t capacity, size_t alignment) {
+	if (alignment == 0) {
+		alignment = 1;
+	}
+	arena->alignment = alignment;
+	arena->capacity = round_up(capacity, alignment);
+	arena->used = 0;
+	arena->free_ranges.clear();
+	arena->blocks.clear();
+	arena->free_handles.clear();
+	arena_range all = { 0, arena->capacity };
+	arena->free_ranges.push_back(all);
+
+	glGenBuffers(1, &arena->buffer);
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, arena->buffer);
+	// only an out of memory from this glBufferData() should fail the create
+	gl_clear_errors();
+	glBufferData(GL_COPY_WRITE_BUFFER, arena->capacity, NULL, GL_STATIC_DRAW);
+	if (glGetError() != GL_NO_ERROR) {
+		gl_log_err("ERROR: could not allocate %u byte arena\n", (unsigned int)arena->capacity);
+		glDeleteBuffers(1, &arena->buffer);
+		gl_state_forget_buffer(arena->buffer);
+		arena->buffer = 0;
+		return false;
+	}
+	gl_log("buffer arena %u: %u bytes, alignment %u\n", arena->buffer, (unsigned int)arena->capacity, (unsigned int)alignment);
+	return true;
+}
+
+void buffer_arena_destroy(buffer_arena* arena) {
+	gl_state_forget_buffer(arena->buffer);
+	glDeleteBuffers(1, &arena->buffer);
+	arena->buffer = 0;
+	arena->free_ranges.clear();
+	arena->blocks.clear();
+	arena->free_handles.clear();
+	arena->used = 0;
+}
+
+static int new_handle(buffer_arena* arena, size_t offset, size_t size) {
+	arena_range block = { offset, size };
+	if (!arena->free_handles.empty()) {
+		int handle = arena->free_handles.back();
+		arena->free_handles.pop_back();
+		arena->blocks[handle] = block;
+		return handle;
+	}
+	arena->blocks.push_back(block);
+	return (int)arena->blocks.size() - 1;
+}
+
+// first fit. ranges are kept in offset order so this also tends to pack low
+static int alloc_from_free_list(buffer_arena* arena, size_t size) {
+	for (size_t i = 0; i < arena->free_ranges.size(); i++) {
+		arena_range* r = &arena->free_ranges[i];
+		if (r->size < size) {
+			continue;
+		}
+		size_t offset = r->offset;
+		r->offset += size;
+		r->size -= size;
+		if (r->size == 0) {
+			arena->free_ranges.erase(arena->free_ranges.begin() + i);
+		}
+		arena->used += size;
+		return new_handle(arena, offset, size);
+	}
+	return -1;
+}
+
+int buffer_arena_alloc(buffer_arena* arena, size_t size) {
+	size = round_up(size > 0 ? size : 1, arena->alignment);
+	int handle = alloc_from_free_list(arena, size);
+	if (handle < 0 && arena->capacity - arena->used >= size) {
+		gl_log("buffer arena %u fragmented - defragmenting for %u bytes\n", arena->buffer, (unsigned int)size);
+		buffer_arena_defragment(arena);
+		handle = alloc_from_free_list(arena, size);
+	}
+	if (handle < 0) {
+		gl_log_err("ERROR: buffer arena %u full. %u of %u bytes used, wanted %u\n", arena->buffer, (unsigned int)arena->used,
+			(unsigned int)arena->capacity, (unsigned int)size);
+	}
+	return handle;
+}
+
+static bool range_offset_less(const arena_range& a, const arena_range& b) { return a.offset < b.offset; }
+
+void buffer_arena_free(buffer_arena* arena, int handle) {
+	arena_range freed = arena->blocks[handle];
+	if (freed.size == 0) {
+		return;
+	}
+	arena->blocks[handle].size = 0;
+	arena->free_handles.push_back(handle);
+	arena->used -= freed.size;
+
+	std::vector<arena_range>& ranges = arena->free_ranges;
+	std::vector<arena_range>::iterator it = std::lower_bound(ranges.begin(), ranges.end(), freed, range_offset_less);
+	// merge into the range after
+	if (it != ranges.end() && freed.offset + freed.size == it->offset) {
+		it->offset = freed.offset;
+		it->size += freed.size;
+	} else {
+		it = ranges.insert(it, freed);
+	}
+	// and the range before
+	if (it != ranges.begin()) {
+		std::vector<arena_range>::iterator prev = it - 1;
+		if (prev->offset + prev->size == it->offset) {
+			prev->size += it->size;
+			ranges.erase(it);
+		}
+	}
+}
+
+void buffer_arena_upload(buffer_arena* arena, int handle, const void* data, size_t size) {
+	// GL_COPY_WRITE_BUFFER so that the upload doesn't disturb any VAO's element buffer
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, arena->buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, arena->blocks[handle].offset, size, data);
+}
+
+static bool handle_offset_less(const std::pair<size_t, int>& a, const std::pair<size_t, int>& b) { return a.first < b.first; }
+
+void buffer_arena_defragment(buffer_arena* arena) {
+	if (arena->used == 0) {
+		arena->free_ranges.clear();
+		arena_range all = { 0, arena->capacity };
+		arena->free_ranges.push_back(all);
+		return;
+	}
+	std::vector<std::pair<size_t, int> > live;
+	for (size_t i = 0; i < arena->blocks.size(); i++) {
+		if (arena->blocks[i].size > 0) {
+			live.push_back(std::make_pair(arena->blocks[i].offset, (int)i));
+		}
+	}
+	std::sort(live.begin(), live.end(), handle_offset_less);
+
+	/* copying within one buffer is undefined if the ranges overlap, so pack
+	into a scratch buffer then copy the whole packed run back in one go. the
+	arena keeps its buffer name, so VAOs that point at it stay valid */
+	GLuint scratch;
+	glGenBuffers(1, &scratch);
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, scratch);
+	glBufferData(GL_COPY_WRITE_BUFFER, arena->used, NULL, GL_STREAM_COPY);
+	gl_state_bind_buffer(GL_COPY_READ_BUFFER, arena->buffer);
+	size_t packed = 0;
+	for (size_t i = 0; i < live.size(); i++) {
+		arena_range* block = &arena->blocks[live[i].second];
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, block->offset, packed, block->size);
+		block->offset = packed;
+		packed += block->size;
+	}
+	gl_state_bind_buffer(GL_COPY_READ_BUFFER, scratch);
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, arena->buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, packed);
+	gl_state_forget_buffer(scratch);
+	glDeleteBuffers(1, &scratch);
+
+	arena->free_ranges.clear();
+	if (packed < arena->capacity) {
+		arena_range rest = { packed, arena->capacity - packed };
+		arena->free_ranges.push_back(rest);
+	}
+	gl_log("buffer arena %u defragmented: %u live blocks, %u bytes\n", arena->buffer, (unsigned int)live.size(), (unsigned int)packed);
+}
+
+/*-------------------------------MESH ARENA-----------------------------------*/
+bool mesh_arena_create(mesh_arena* ma, const vertex_format* fmt, size_t max_vertices, size_t max_indices) {
+	ma->format = *fmt;
+	if (!buffer_arena_create(&ma->vertices, max_vertices * fmt->stride, fmt->stride)) {
+		return false;
+	}
+	if (!buffer_arena_create(&ma->indices, max_indices * sizeof(GLuint), sizeof(GLuint))) {
+		buffer_arena_destroy(&ma->vertices);
+		return false;
+	}
+	ma->vao = create_vao_for_format(fmt, ma->vertices.buffer);
+	// element buffer binding is part of the VAO
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ma->indices.buffer);
+	return true;
+}
+
+void mesh_arena_destroy(mesh_arena* ma) {
+	gl_state_forget_vao(ma->vao);
+	glDeleteVertexArrays(1, &ma->vao);
+	ma->vao = 0;
+	buffer_arena_destroy(&ma->vertices);
+	buffer_arena_destroy(&ma->indices);
+}
+
+bool mesh_arena_add(mesh_arena* ma, const void* vertices, size_t n_vertices, const GLuint* indices, size_t n_indices, arena_mesh* mesh) {
+	size_t vertex_bytes = n_vertices * ma->format.stride;
+	size_t index_bytes = n_indices * sizeof(GLuint);
+	mesh->vertex_block = buffer_arena_alloc(&ma->vertices, vertex_bytes);
+	if (mesh->vertex_block < 0) {
+		return false;
+	}
+	mesh->index_block = buffer_arena_alloc(&ma->indices, index_bytes);
+	if (mesh->index_block < 0) {
+		buffer_arena_free(&ma->vertices, mesh->vertex_block);
+		mesh->vertex_block = -1;
+		return false;
+	}
+	mesh->n_indices = (GLsizei)n_indices;
+	buffer_arena_upload(&ma->vertices, mesh->vertex_block, vertices, vertex_bytes);
+	buffer_arena_upload(&ma->indices, mesh->index_block, indices, index_bytes);
+	return true;
+}
+
+void mesh_arena_remove(mesh_arena* ma, arena_mesh* mesh) {
+	if (mesh->vertex_block >= 0) {
+		buffer_arena_free(&ma->vertices, mesh->vertex_block);
+	}
+	if (mesh->index_block >= 0) {
+		buffer_arena_free(&ma->indices, mesh->index_block);
+	}
+	mesh->vertex_block = -1;
+	mesh->index_block = -1;
+	mesh->n_indices = 0;
+}
+
+GLint mesh_arena_base_vertex(const mesh_arena* ma, const arena_mesh* mesh) {
+	return (GLint)(buffer_arena_offset(&ma->vertices, mesh->vertex_block) / ma->format.stride);
+}
+
+size_t mesh_arena_index_offset(const mesh_arena* ma, const arena_mesh* mesh) { return buffer_arena_offset(&ma->indices, mesh->index_block); }
+
+void mesh_arena_draw(const mesh_arena* ma, const arena_mesh* mesh) {
+	gl_state_bind_vao(ma->vao);
+	glDrawElementsBaseVertex(GL_TRIANGLES, mesh->n_indices, GL_UNSIGNED_INT, (const GLvoid*)mesh_arena_index_offset(ma, mesh), mesh_arena_base_vertex(ma, mesh));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "vertex_format.h"
+#include <cstddef>
+#include <vector>
+
+/* sub-allocates ranges out of one big GL buffer so that thousands of small
+meshes don't each need their own buffer object. allocations are referred to by
+handle rather than offset - buffer_arena_defragment() slides live ranges down
+to close the gaps, and the handle table is updated to match, so look the
+offset up with buffer_arena_offset() each time it's needed rather than keeping
+it */
+
+struct arena_range {
+	size_t offset;
+	size_t size;
+};
+
+struct buffer_arena {
+	GLuint buffer;
+	size_t capacity;
+	size_t alignment; // every offset and size is a multiple of this
+	size_t used;
+	std::vector<arena_range> free_ranges; // sorted by offset, neighbours always merged
+	std::vector<arena_range> blocks;      // indexed by handle. size 0 = handle not in use
+	std::vector<int> free_handles;
+};
+
+/* creates a buffer of capacity bytes (rounded up to alignment). alignment
+needn't be a power of 2 - a vertex arena uses the vertex stride so that every
+offset is a whole number of vertices */
+bool buffer_arena_create(buffer_arena* arena, size_t capacity, size_t alignment);
+
+void buffer_arena_destroy(buffer_arena* arena);
+
+/* returns a handle, or -1 if there's no room. if the free space is there but
+fragmented the arena is defragmented first */
+int buffer_arena_alloc(buffer_arena* arena, size_t size);
+
+void buffer_arena_free(buffer_arena* arena, int handle);
+
+inline size_t buffer_arena_offset(const buffer_arena* arena, int handle) { return arena->blocks[handle].offset; }
+
+inline size_t buffer_arena_size(const buffer_arena* arena, int handle) { return arena->blocks[handle].size; }
+
+// glBufferSubData() into the start of an allocation
+void buffer_arena_upload(buffer_arena* arena, int handle, const void* data, size_t size);
+
+/* packs every live allocation to the front of the buffer with
+glCopyBufferSubData(), leaving one free range at the end. GPU-side only, the
+data never comes back to the CPU */
+void buffer_arena_defragment(buffer_arena* arena);
+
+/* meshes sharing one vertex arena, one index arena and one VAO. each mesh's
+indices are relative to its own first vertex and it's drawn with
+glDrawElementsBaseVertex(), so adding a mesh never touches the VAO */
+struct mesh_arena {
+	vertex_format format;
+	buffer_arena vertices;
+	buffer_arena indices; // GLuint indices
+	GLuint vao;
+};
+
+struct arena_mesh {
+	int vertex_block;
+	int index_block;
+	GLsizei n_indices;
+};
+
+bool mesh_arena_create(mesh_arena* ma, const vertex_format* fmt, size_t max_vertices, size_t max_indices);
+
+void mesh_arena_destroy(mesh_arena* ma);
+
+// vertices are already packed with pack_vertices(). returns false if either arena is full
+bool mesh_arena_add(mesh_arena* ma, const void* vertices, size_t n_vertices, const GLuint* indices, size_t n_indices, arena_mesh* mesh);
+
+void mesh_arena_remove(mesh_arena* ma, arena_mesh* mesh);
+
+// base vertex and byte offset into the index buffer, for building draw commands
+GLint mesh_arena_base_vertex(const mesh_arena* ma, const arena_mesh* mesh);
+size_t mesh_arena_index_offset(const mesh_arena* ma, const arena_mesh* mesh);
+
+// binds the arena's VAO (through the state cache) and draws one mesh
+void mesh_arena_draw(const mesh_arena* ma, const arena_mesh* mesh);
@@ -0,0 +1,371 @@
+#include "frame_profiler.h"
+#include "gl_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* a slot in the event ring. sequence is 0 while a thread is filling it in and
+the event's index + 1 once it's done, so the trace writer can tell a finished
+event from a half-written one (a seqlock). the fields are atomics only so that
+reading one mid-write isn't a data race - all the ordering comes from sequence */
+struct profile_event {
+	std::atomic<unsigned long long> sequence;
+	std::atomic<const char*> name;
+	std::atomic<long long> start_us; // since the profiler started
+	std::atomic<long long> duration_us;
+	std::atomic<int> thread;
+};
+
+static const std::chrono::steady_clock::time_point g_profiler_epoch = std::chrono::steady_clock::now();
+
+static double g_frame_ms[PROFILER_FRAMES];
+static int g_frame_head = 0;
+static int g_frame_count = 0;
+static long long g_last_frame_us = -1;
+
+// thread index used for GPU events in the trace
+#define PROFILER_GPU_THREAD 1000
+
+static profile_event g_events[PROFILER_MAX_EVENTS];
+static std::atomic<unsigned long long> g_event_head(0);
+static std::atomic<int> g_next_thread(0);
+
+// each thread's stack of open scopes
+struct scope_stack {
+	int thread;
+	int depth;
+	const char* names[PROFILER_MAX_DEPTH];
+	long long starts_us[PROFILER_MAX_DEPTH];
+};
+
+static thread_local scope_stack t_scopes = { -1, 0, {}, {} };
+
+static long long now_us() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_profiler_epoch).count();
+}
+
+static void push_event(const char* name, long long start_us, long long duration_us, int thread) {
+	// claim a slot. once the ring wraps the oldest events are overwritten
+	unsigned long long index = g_event_head.fetch_add(1, std::memory_order_relaxed);
+	profile_event* e = &g_events[index & (PROFILER_MAX_EVENTS - 1)];
+	e->sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e->name.store(name, std::memory_order_relaxed);
+	e->start_us.store(start_us, std::memory_order_relaxed);
+	e->duration_us.store(duration_us, std::memory_order_relaxed);
+	e->thread.store(thread, std::memory_order_relaxed);
+	e->sequence.store(index + 1, std::memory_order_release);
+}
+
+// copies out event index. false if it's being written or has been overwritten
+static bool read_event(unsigned long long index, const char** name, long long* start_us, long long* duration_us, int* thread) {
+	const profile_event* e = &g_events[index & (PROFILER_MAX_EVENTS - 1)];
+	if (e->sequence.load(std::memory_order_acquire) != index + 1) {
+		return false;
+	}
+	*name = e->name.load(std::memory_order_relaxed);
+	*start_us = e->start_us.load(std::memory_order_relaxed);
+	*duration_us = e->duration_us.load(std::memory_order_relaxed);
+	*thread = e->thread.load(std::memory_order_relaxed);
+	// a writer that started on the slot while we were copying has bumped this
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return e->sequence.load(std::memory_order_relaxed) == index + 1;
+}
+
+static int this_thread_index() {
+	if (t_scopes.thread < 0) {
+		t_scopes.thread = g_next_thread.fetch_add(1);
+	}
+	return t_scopes.thread;
+}
+
+static void gpu_next_frame();
+
+void profiler_frame() {
+	gpu_next_frame();
+	long long now = now_us();
+	if (g_last_frame_us >= 0) {
+		long long duration = now - g_last_frame_us;
+		g_frame_ms[g_frame_head] = duration / 1000.0;
+		g_frame_head = (g_frame_head + 1) % PROFILER_FRAMES;
+		if (g_frame_count < PROFILER_FRAMES) {
+			g_frame_count++;
+		}
+		push_event("frame", g_last_frame_us, duration, this_thread_index());
+	}
+	g_last_frame_us = now;
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int n, double p) {
+	int rank = (int)ceil(p / 100.0 * n);
+	rank = rank < 1 ? 1 : (rank > n ? n : rank);
+	return sorted[rank - 1];
+}
+
+static bool ring_stats(const double* ring, int n, frame_stats* stats) {
+	memset(stats, 0, sizeof(frame_stats));
+	if (n < 1) {
+		return false;
+	}
+	std::vector<double> sorted(ring, ring + n);
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (int i = 0; i < n; i++) {
+		total += sorted[i];
+	}
+	stats->n_frames = n;
+	stats->mean_ms = total / n;
+	stats->p50_ms = percentile(sorted.data(), n, 50.0);
+	stats->p95_ms = percentile(sorted.data(), n, 95.0);
+	stats->p99_ms = percentile(sorted.data(), n, 99.0);
+	stats->max_ms = sorted[n - 1];
+	return true;
+}
+
+bool profiler_frame_stats(frame_stats* stats) { return ring_stats(g_frame_ms, g_frame_count, stats); }
+
+void profiler_begin_scope(const char* name) {
+	this_thread_index();
+	scope_stack* s = &t_scopes;
+	if (s->depth < PROFILER_MAX_DEPTH) {
+		s->names[s->depth] = name;
+		s->starts_us[s->depth] = now_us();
+	}
+	s->depth++;
+}
+
+void profiler_end_scope() {
+	scope_stack* s = &t_scopes;
+	if (s->depth < 1) {
+		return;
+	}
+	s->depth--;
+	// too deep to have been recorded
+	if (s->depth >= PROFILER_MAX_DEPTH) {
+		return;
+	}
+	long long start = s->starts_us[s->depth];
+	push_event(s->names[s->depth], start, now_us() - start, s->thread);
+}
+
+// names go into JSON strings
+void write_json_string(FILE* file, const char* str) {
+	fputc('"', file);
+	for (const char* p = str; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			fputc('\\', file);
+			fputc(*p, file);
+		} else if ((unsigned char)*p < 0x20) {
+			fprintf(file, "\\u%04x", *p);
+		} else {
+			fputc(*p, file);
+		}
+	}
+	fputc('"', file);
+}
+
+bool profiler_write_trace(const char* file_name) {
+	FILE* file = fopen(file_name, "w");
+	if (!file) {
+		gl_log_err("ERROR: could not open %s for writing\n", file_name);
+		return false;
+	}
+	unsigned long long head = g_event_head.load(std::memory_order_acquire);
+	unsigned long long first = head > PROFILER_MAX_EVENTS ? head - PROFILER_MAX_EVENTS : 0;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"GPU\"}}", PROFILER_GPU_THREAD);
+	/* other threads can carry on profiling while this runs. events they're still
+	writing, or that the ring overwrites before we get to them, are left out */
+	unsigned int written = 0;
+	for (unsigned long long i = first; i < head; i++) {
+		const char* name;
+		long long start_us, duration_us;
+		int thread;
+		if (!read_event(i, &name, &start_us, &duration_us, &thread)) {
+			continue;
+		}
+		fprintf(file, ",\n{\"name\":");
+		write_json_string(file, name ? name : "?");
+		fprintf(file, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%i}", start_us, duration_us, thread);
+		written++;
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	gl_log("wrote %u profiler events to %s\n", written, file_name);
+	return true;
+}
+
+/*------------------------------GPU TIMERS-----------------------------------*/
+struct gpu_scope {
+	const char* name;
+	GLuint queries[2]; // begin and end timestamps
+};
+
+// one frame's worth of queries
+struct gpu_frame {
+	gpu_scope scopes[PROFILER_GPU_SCOPES_PER_FRAME];
+	int n_scopes;
+	int stack[PROFILER_MAX_DEPTH]; // open scopes, -1 for ones that didn't fit
+	int depth;
+	/* the most recently issued timestamp. nested scopes end in a different order
+	to the one they're listed in, so this is what says the frame is finished */
+	GLuint last_query;
+	long long gpu_minus_cpu_ns; // clock offset measured at the start of the frame
+};
+
+static gpu_frame g_gpu_frames[PROFILER_GPU_LATENCY];
+static int g_gpu_frame = 0;
+static bool g_gpu_enabled = false;
+static double g_gpu_frame_ms[PROFILER_FRAMES];
+static int g_gpu_frame_head = 0;
+static int g_gpu_frame_count = 0;
+static unsigned int g_gpu_dropped = 0;
+
+static void start_gpu_frame(gpu_frame* f) {
+	f->n_scopes = 0;
+	f->depth = 0;
+	f->last_query = 0;
+	// GL_TIMESTAMP query results and this are on the same GPU clock
+	GLint64 gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	f->gpu_minus_cpu_ns = (long long)gpu_now - now_us() * 1000;
+}
+
+bool profiler_gpu_init() {
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	if (bits == 0) {
+		gl_log("GPU profiler: no timestamp queries\n");
+		return false;
+	}
+	for (int i = 0; i < PROFILER_GPU_LATENCY; i++) {
+		for (int j = 0; j < PROFILER_GPU_SCOPES_PER_FRAME; j++) {
+			glGenQueries(2, g_gpu_frames[i].scopes[j].queries);
+		}
+	}
+	g_gpu_frame = 0;
+	start_gpu_frame(&g_gpu_frames[0]);
+	g_gpu_enabled = true;
+	gl_log("GPU profiler: %i bit timestamps, %i frames latency\n", bits, PROFILER_GPU_LATENCY);
+	return true;
+}
+
+void profiler_gpu_shutdown() {
+	if (!g_gpu_enabled) {
+		return;
+	}
+	for (int i = 0; i < PROFILER_GPU_LATENCY; i++) {
+		for (int j = 0; j < PROFILER_GPU_SCOPES_PER_FRAME; j++) {
+			glDeleteQueries(2, g_gpu_frames[i].scopes[j].queries);
+		}
+	}
+	g_gpu_enabled = false;
+}
+
+void profiler_begin_gpu_scope(const char* name) {
+	if (!g_gpu_enabled) {
+		return;
+	}
+	gpu_frame* f = &g_gpu_frames[g_gpu_frame];
+	int index = -1;
+	// a scope too deep for the stack would never get its end query, so isn't timed
+	if (f->n_scopes < PROFILER_GPU_SCOPES_PER_FRAME && f->depth < PROFILER_MAX_DEPTH) {
+		index = f->n_scopes++;
+		f->scopes[index].name = name;
+		glQueryCounter(f->scopes[index].queries[0], GL_TIMESTAMP);
+		f->last_query = f->scopes[index].queries[0];
+	}
+	if (f->depth < PROFILER_MAX_DEPTH) {
+		f->stack[f->depth] = index;
+	}
+	f->depth++;
+}
+
+void profiler_end_gpu_scope() {
+	if (!g_gpu_enabled) {
+		return;
+	}
+	gpu_frame* f = &g_gpu_frames[g_gpu_frame];
+	if (f->depth < 1) {
+		return;
+	}
+	f->depth--;
+	if (f->depth >= PROFILER_MAX_DEPTH) {
+		return;
+	}
+	int index = f->stack[f->depth];
+	if (index >= 0) {
+		glQueryCounter(f->scopes[index].queries[1], GL_TIMESTAMP);
+		f->last_query = f->scopes[index].queries[1];
+	}
+}
+
+/* reads back a finished frame. queries complete in the order they were issued,
+so if the last one issued is available they all are. returns false without
+waiting if not */
+static bool collect_gpu_frame(gpu_frame* f) {
+	if (f->n_scopes == 0) {
+		return true;
+	}
+	// a scope left open has no end query issued
+	if (f->depth > 0) {
+		return false;
+	}
+	GLuint available = 0;
+	glGetQueryObjectuiv(f->last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+	GLuint64 first_ns = ~(GLuint64)0, last_ns = 0;
+	for (int i = 0; i < f->n_scopes; i++) {
+		GLuint64 begin_ns = 0, end_ns = 0;
+		glGetQueryObjectui64v(f->scopes[i].queries[0], GL_QUERY_RESULT, &begin_ns);
+		glGetQueryObjectui64v(f->scopes[i].queries[1], GL_QUERY_RESULT, &end_ns);
+		first_ns = begin_ns < first_ns ? begin_ns : first_ns;
+		last_ns = end_ns > last_ns ? end_ns : last_ns;
+		long long start_us = ((long long)begin_ns - f->gpu_minus_cpu_ns) / 1000;
+		push_event(f->scopes[i].name, start_us, (long long)(end_ns - begin_ns) / 1000, PROFILER_GPU_THREAD);
+	}
+	g_gpu_frame_ms[g_gpu_frame_head] = (last_ns - first_ns) / 1000000.0;
+	g_gpu_frame_head = (g_gpu_frame_head + 1) % PROFILER_FRAMES;
+	if (g_gpu_frame_count < PROFILER_FRAMES) {
+		g_gpu_frame_count++;
+	}
+	return true;
+}
+
+static void gpu_next_frame() {
+	if (!g_gpu_enabled) {
+		return;
+	}
+	g_gpu_frame = (g_gpu_frame + 1) % PROFILER_GPU_LATENCY;
+	gpu_frame* f = &g_gpu_frames[g_gpu_frame];
+	// the oldest frame in flight. its queries are about to be reused
+	if (!collect_gpu_frame(f)) {
+		g_gpu_dropped++;
+	}
+	start_gpu_frame(f);
+}
+
+bool profiler_gpu_frame_stats(frame_stats* stats) { return ring_stats(g_gpu_frame_ms, g_gpu_frame_count, stats); }
+
+unsigned int profiler_gpu_dropped_frames() { return g_gpu_dropped; }
+
+void profiler_reset() {
+	g_frame_head = 0;
+	g_frame_count = 0;
+	g_last_frame_us = -1;
+	g_event_head.store(0);
+	// otherwise old events would pass for the new ones at the same index
+	for (int i = 0; i < PROFILER_MAX_EVENTS; i++) {
+		g_events[i].sequence.store(0);
+	}
+	g_gpu_frame_head = 0;
+	g_gpu_frame_count = 0;
+	g_gpu_dropped = 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdio>
+
+/* CPU frame timing. call profiler_frame() once a frame (_update_fps_counter()
+does) and the time since the last call goes into a ring of the last
+PROFILER_FRAMES frame times, which profiler_frame_stats() turns into
+percentiles. spikes show up in p99 and max where an average FPS hides them.
+
+named scopes time parts of a frame and can nest:
+
+  void draw_scene() {
+    PROFILE_SCOPE( "draw_scene" );
+    { PROFILE_SCOPE( "sort" ); ... }
+    ...
+  }
+
+every scope and every frame is kept as an event in a ring of the last
+PROFILER_MAX_EVENTS, and profiler_write_trace() dumps them as Chrome
+trace-event JSON - open it in chrome://tracing or ui.perfetto.dev. scopes can be
+used from any thread. names must be string literals, or at least outlive the
+profiler - only the pointer is kept */
+
+/* GPU scopes work the same way once profiler_gpu_init() has been called with
+a context current. each GPU_PROFILE_SCOPE() puts a GL_TIMESTAMP query either
+side of the GL commands in it (timestamps rather than GL_TIME_ELAPSED, so they
+can nest) and also opens a CPU scope of the same name, so the trace shows the
+CPU submitting a pass next to the GPU running it. queries are pooled over
+PROFILER_GPU_LATENCY frames and a frame's results are read when its pool comes
+round again - by then they're normally ready, and if not that frame is dropped
+rather than waited for. GPU events go in the same trace on their own "GPU"
+track, and profiler_gpu_frame_stats() gives GPU frame time percentiles */
+
+#define PROFILER_FRAMES 1024
+#define PROFILER_MAX_EVENTS 65536 // must be a power of 2
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_GPU_LATENCY 4         // frames of queries in flight
+#define PROFILER_GPU_SCOPES_PER_FRAME 64
+
+struct frame_stats {
+	int n_frames; // how many of the ring's entries are filled
+	double mean_ms;
+	double p50_ms;
+	double p95_ms;
+	double p99_ms;
+	double max_ms;
+};
+
+// marks the end of one frame and the start of the next
+void profiler_frame();
+
+// false until at least one full frame has been timed
+bool profiler_frame_stats(frame_stats* stats);
+
+void profiler_begin_scope(const char* name);
+void profiler_end_scope();
+
+/* writes every event still in the ring. safe to call while other threads are
+profiling - events they are part way through recording are skipped */
+bool profiler_write_trace(const char* file_name);
+
+// writes str quoted, with quotes, backslashes and control characters escaped
+void write_json_string(FILE* file, const char* str);
+
+// drops all frame times and events
+void profiler_reset();
+
+// false if the context can't do timestamp queries. GPU scopes are no-ops until this succeeds
+bool profiler_gpu_init();
+
+void profiler_gpu_shutdown();
+
+void profiler_begin_gpu_scope(const char* name);
+void profiler_end_gpu_scope();
+
+// GPU time from the first GPU scope of a frame to the end of the last one
+bool profiler_gpu_frame_stats(frame_stats* stats);
+
+// frames whose queries weren't ready in time and were skipped
+unsigned int profiler_gpu_dropped_frames();
+
+struct profile_scope {
+	explicit profile_scope(const char* name) { profiler_begin_scope(name); }
+	~profile_scope() { profiler_end_scope(); }
+	profile_scope(const profile_scope&) = delete;
+	profile_scope& operator=(const profile_scope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+struct gpu_profile_scope {
+	explicit gpu_profile_scope(const char* name) {
+		profiler_begin_scope(name);
+		profiler_begin_gpu_scope(name);
+	}
+	~gpu_profile_scope() {
+		profiler_end_gpu_scope();
+		profiler_end_scope();
+	}
+	gpu_profile_scope(const gpu_profile_scope&) = delete;
+	gpu_profile_scope& operator=(const gpu_profile_scope&) = delete;
+};
+
+#define GPU_PROFILE_SCOPE(name) gpu_profile_scope PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(name)
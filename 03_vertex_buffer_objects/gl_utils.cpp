@@ -1,57 +1,395 @@
 #include "gl_utils.h"
+#include "frame_profiler.h"
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifdef GL_UTILS_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define GL_LOG_FILE "gl.log"
-#define MAX_SHADER_LENGTH 262144
+
+/* gl_log() and gl_log_err() format into a fixed ring of slots and return
+straight away. a background thread drains the ring into the log file, which is
+held open for the life of the program. producers claim slots with a
+compare-and-swap (bounded mpmc queue, used here with a single consumer), so any
+thread can log without taking a lock. memory use is fixed - if the ring fills
+up faster than the thread writes it out, the logging thread drains it itself
+before carrying on, so nothing is lost. a message longer than a slot is
+split over several consecutive ones. */
+#define GL_LOG_SLOTS 1024 // must be a power of 2
+#define GL_LOG_SLOT_SIZE 512
+#define GL_LOG_FLUSH_MS 50
+// the most slots one long message can take, about 128KB of text
+#define GL_LOG_MAX_MESSAGE_SLOTS (GL_LOG_SLOTS / 4)
+
+struct log_slot {
+	std::atomic<size_t> sequence;
+	char text[GL_LOG_SLOT_SIZE];
+};
+
+static log_slot g_log_slots[GL_LOG_SLOTS];
+static std::atomic<size_t> g_log_head(0);
+static size_t g_log_tail = 0; // only touched while holding g_log_drain_mutex
+static FILE* g_log_file = NULL;
+// g_log_file's descriptor, for the crash handler, which can't use stdio. -1 if closed
+static std::atomic<int> g_log_fd(-1);
+static std::mutex g_log_drain_mutex;
+static std::mutex g_log_wake_mutex;
+static std::condition_variable g_log_wake;
+static std::atomic<bool> g_log_running(false);
+static std::thread g_log_thread;
+static std::once_flag g_log_once;
+
+// writes out everything that producers have finished with. caller holds g_log_drain_mutex
+static void drain_log_ring() {
+	if (!g_log_file) {
+		return;
+	}
+	for (;;) {
+		log_slot* slot = &g_log_slots[g_log_tail & (GL_LOG_SLOTS - 1)];
+		if (slot->sequence.load(std::memory_order_acquire) != g_log_tail + 1) {
+			break;
+		}
+		fputs(slot->text, g_log_file);
+		slot->sequence.store(g_log_tail + GL_LOG_SLOTS, std::memory_order_release);
+		g_log_tail++;
+	}
+	fflush(g_log_file);
+}
+
+static void log_thread_main() {
+	while (g_log_running.load()) {
+		{
+			std::unique_lock<std::mutex> lock(g_log_wake_mutex);
+			g_log_wake.wait_for(lock, std::chrono::milliseconds(GL_LOG_FLUSH_MS));
+		}
+		std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+		drain_log_ring();
+	}
+}
+
+static void set_log_file(FILE* f) {
+	g_log_file = f;
+#ifdef _WIN32
+	g_log_fd.store(f ? _fileno(f) : -1);
+#else
+	g_log_fd.store(f ? fileno(f) : -1);
+#endif
+}
+
+/* best effort - get whatever is in the ring onto disk, then hand over to the
+handler that was there before, or die as normal. only async-signal-safe calls
+in here, so no locks and no stdio: published slots are written straight to the
+log file's descriptor and the ring itself is left alone. a slot the logging
+thread was writing out at the time of the crash can appear twice */
+static const int g_crash_signals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+#define GL_LOG_N_CRASH_SIGNALS (sizeof(g_crash_signals) / sizeof(g_crash_signals[0]))
+static volatile sig_atomic_t g_log_crashed = 0;
+
+static void write_log_ring_raw() {
+	int fd = g_log_fd.load();
+	if (fd < 0 || g_log_crashed) {
+		return;
+	}
+	g_log_crashed = 1;
+	for (size_t pos = g_log_tail;; pos++) {
+		log_slot* slot = &g_log_slots[pos & (GL_LOG_SLOTS - 1)];
+		if (slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+			break;
+		}
+#ifdef _WIN32
+		_write(fd, slot->text, (unsigned int)strlen(slot->text));
+#else
+		ssize_t ignored = write(fd, slot->text, strlen(slot->text));
+		(void)ignored;
+#endif
+	}
+}
+
+#ifdef _WIN32
+typedef void (*crash_handler_proc)(int);
+static crash_handler_proc g_previous_handlers[GL_LOG_N_CRASH_SIGNALS];
+
+static void log_crash_handler(int sig) {
+	write_log_ring_raw();
+	for (size_t i = 0; i < GL_LOG_N_CRASH_SIGNALS; i++) {
+		if (g_crash_signals[i] == sig) {
+			crash_handler_proc previous = g_previous_handlers[i];
+			signal(sig, previous == SIG_ERR ? SIG_DFL : previous);
+			if (previous != SIG_DFL && previous != SIG_IGN && previous != SIG_ERR) {
+				previous(sig);
+				return;
+			}
+		}
+	}
+	raise(sig);
+}
+
+static void install_crash_handlers() {
+	for (size_t i = 0; i < GL_LOG_N_CRASH_SIGNALS; i++) {
+		g_previous_handlers[i] = signal(g_crash_signals[i], log_crash_handler);
+	}
+}
+#else
+static struct sigaction g_previous_actions[GL_LOG_N_CRASH_SIGNALS];
+
+static void log_crash_handler(int sig, siginfo_t* info, void* context) {
+	write_log_ring_raw();
+	for (size_t i = 0; i < GL_LOG_N_CRASH_SIGNALS; i++) {
+		if (g_crash_signals[i] != sig) {
+			continue;
+		}
+		// put the previous action back first, so a fault it doesn't fix goes straight to it next time
+		struct sigaction* previous = &g_previous_actions[i];
+		sigaction(sig, previous, NULL);
+		if (previous->sa_flags & SA_SIGINFO) {
+			previous->sa_sigaction(sig, info, context);
+			return;
+		}
+		if (previous->sa_handler == SIG_IGN) {
+			return;
+		}
+		if (previous->sa_handler != SIG_DFL) {
+			previous->sa_handler(sig);
+			return;
+		}
+	}
+	// still blocked while we're in here, so it's delivered with the default action on return
+	raise(sig);
+}
+
+static void install_crash_handlers() {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = log_crash_handler;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	for (size_t i = 0; i < GL_LOG_N_CRASH_SIGNALS; i++) {
+		sigaction(g_crash_signals[i], &action, &g_previous_actions[i]);
+	}
+}
+#endif
+
+static void start_log_thread() {
+	for (size_t i = 0; i < GL_LOG_SLOTS; i++) {
+		g_log_slots[i].sequence.store(i);
+	}
+	{
+		std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+		if (!g_log_file) {
+			set_log_file(fopen(GL_LOG_FILE, "a"));
+			if (!g_log_file) {
+				fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
+			}
+		}
+	}
+	g_log_running.store(true);
+	g_log_thread = std::thread(log_thread_main);
+	atexit(gl_log_shutdown);
+	install_crash_handlers();
+}
+
+/* claims n consecutive slots and returns the first position. taking them all
+in one compare-and-swap keeps a multi-slot message in one piece */
+static bool claim_log_slots(size_t n, size_t* first) {
+	size_t pos = g_log_head.load(std::memory_order_relaxed);
+	for (;;) {
+		long long dif = 0;
+		for (size_t i = 0; i < n && dif == 0; i++) {
+			size_t seq = g_log_slots[(pos + i) & (GL_LOG_SLOTS - 1)].sequence.load(std::memory_order_acquire);
+			dif = (long long)seq - (long long)(pos + i);
+		}
+		if (dif == 0) {
+			if (g_log_head.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+				*first = pos;
+				return true;
+			}
+		}
+		else if (dif < 0) {
+			// full - write some out ourselves and try again
+			{
+				std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+				if (!g_log_file) {
+					return false;
+				}
+				drain_log_ring();
+			}
+			pos = g_log_head.load(std::memory_order_relaxed);
+		}
+		else {
+			pos = g_log_head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+// formats the message and queues it, in one slot or several in a row
+static bool push_log_message(const char* message, va_list argptr) {
+	std::call_once(g_log_once, start_log_thread);
+
+	char text[GL_LOG_SLOT_SIZE];
+	va_list copy;
+	va_copy(copy, argptr);
+	int len = vsnprintf(text, GL_LOG_SLOT_SIZE, message, copy);
+	va_end(copy);
+	if (len < 0) {
+		return false;
+	}
+	size_t pos;
+	if (len < GL_LOG_SLOT_SIZE) {
+		if (!claim_log_slots(1, &pos)) {
+			return false;
+		}
+		log_slot* slot = &g_log_slots[pos & (GL_LOG_SLOTS - 1)];
+		memcpy(slot->text, text, len + 1);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* too long for a slot (e.g. a shader info log). split it over as many
+	consecutive slots as it needs, so it comes out in order with everything else.
+	anything past GL_LOG_MAX_MESSAGE_SLOTS slots is cut off */
+	std::vector<char> long_text(len + 1);
+	vsnprintf(long_text.data(), long_text.size(), message, argptr);
+	const size_t per_slot = GL_LOG_SLOT_SIZE - 1;
+	size_t n_slots = (len + per_slot - 1) / per_slot;
+	if (n_slots > GL_LOG_MAX_MESSAGE_SLOTS) {
+		n_slots = GL_LOG_MAX_MESSAGE_SLOTS;
+		len = (int)(n_slots * per_slot);
+		memcpy(&long_text[len - 4], "...\n", 4);
+	}
+	if (!claim_log_slots(n_slots, &pos)) {
+		return false;
+	}
+	for (size_t i = 0; i < n_slots; i++) {
+		log_slot* slot = &g_log_slots[(pos + i) & (GL_LOG_SLOTS - 1)];
+		size_t offset = i * per_slot;
+		size_t n = (size_t)len - offset < per_slot ? (size_t)len - offset : per_slot;
+		memcpy(slot->text, &long_text[offset], n);
+		slot->text[n] = 0;
+		slot->sequence.store(pos + i + 1, std::memory_order_release);
+	}
+	return true;
+}
 
 bool restart_gl_log() {
-	FILE* file = fopen(GL_LOG_FILE, "w");
-	if (!file) {
+	std::call_once(g_log_once, start_log_thread);
+	std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+	drain_log_ring();
+	if (g_log_file) {
+		FILE* old_file = g_log_file;
+		set_log_file(NULL);
+		fclose(old_file);
+	}
+	set_log_file(fopen(GL_LOG_FILE, "w"));
+	if (!g_log_file) {
 		fprintf(stderr, "ERROR: could not open GL_LOG_FILE log file %s for writing\n", GL_LOG_FILE);
 		return false;
 	}
 
 	time_t now = time(NULL);
 	char* date = ctime(&now);
-	fprintf(file, "GL_LOG_FILE log. local time %s\n", date);
-	fclose(file);
+	fprintf(g_log_file, "GL_LOG_FILE log. local time %s\n", date);
+	fflush(g_log_file);
 	return true;
 }
 
 bool gl_log(const char* message, ...) {
-	FILE* file = fopen(GL_LOG_FILE, "a");
-	if (!file) {
-		fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
-		return false;
-	}
-	
 	va_list argptr;
 	va_start(argptr, message);
-	vfprintf(file, message, argptr);
+	bool result = push_log_message(message, argptr);
 	va_end(argptr);
-	fclose(file);
-	return true;
+	return result;
 }
 
 bool gl_log_err(const char* message, ...) {
-	FILE* file = fopen(GL_LOG_FILE, "a");
-	if (!file) {
-		fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
-		return false;
-	}
-
 	va_list argptr;
 	va_start(argptr, message);
-	vfprintf(file, message, argptr);
+	bool result = push_log_message(message, argptr);
 	va_end(argptr);
+	// errors still go to the console straight away
 	va_start(argptr, message);
 	vfprintf(stderr, message, argptr);
 	va_end(argptr);
-	fclose(file);
-	return true;
+	return result;
+}
+
+void gl_log_flush() {
+	std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+	drain_log_ring();
+}
+
+void gl_log_shutdown() {
+	if (!g_log_running.exchange(false)) {
+		return;
+	}
+	g_log_wake.notify_one();
+	if (g_log_thread.joinable()) {
+		g_log_thread.join();
+	}
+	std::lock_guard<std::mutex> lock(g_log_drain_mutex);
+	drain_log_ring();
+	if (g_log_file) {
+		FILE* old_file = g_log_file;
+		set_log_file(NULL);
+		fclose(old_file);
+	}
+}
+
+bool gl_extension_supported(const char* name) {
+	GLint n = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+	for (GLint i = 0; i < n; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && strcmp(ext, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void gl_clear_errors() {
+	// each call clears one flag. give up rather than spin if there's no context
+	for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++) {
+	}
+}
+
+#ifdef GL_UTILS_HEADLESS
+static EGLDisplay g_egl_display = EGL_NO_DISPLAY;
+static EGLContext g_egl_context = EGL_NO_CONTEXT;
+static EGLSurface g_egl_surface = EGL_NO_SURFACE;
+GLuint g_headless_fbo = 0;
+static GLuint g_headless_renderbuffers[2];
+#endif
+
+void* gl_proc_address(const char* name) {
+#ifdef GL_UTILS_HEADLESS
+	if (g_egl_context != EGL_NO_CONTEXT) {
+		return (void*)eglGetProcAddress(name);
+	}
+#endif
+	return (void*)glfwGetProcAddress(name);
 }
 
 bool start_gl() {
@@ -90,10 +428,251 @@ bool start_gl() {
 	printf("Renderer: %s\n", renderer);
 	printf("OpenGL version supported %s\n", version);
 	gl_log("renderer: %s\nversion: %s\n", renderer, version);
+	detect_gl_caps();
+	log_gl_params();
 
 	return true;
 }
 
+#ifdef GL_UTILS_HEADLESS
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static bool egl_has_extension(EGLDisplay display, const char* name) {
+	const char* list = eglQueryString(display, EGL_EXTENSIONS);
+	if (!list) {
+		return false;
+	}
+	size_t len = strlen(name);
+	for (const char* p = strstr(list, name); p; p = strstr(p + len, name)) {
+		if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void* egl_proc_address(const char* name) { return (void*)eglGetProcAddress(name); }
+
+bool start_gl_headless(int width, int height) {
+	gl_log("starting headless EGL context %ix%i\n", width, height);
+
+	// client extensions are queried on EGL_NO_DISPLAY
+	if (egl_has_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display) {
+			g_egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+	}
+	if (g_egl_display == EGL_NO_DISPLAY) {
+		g_egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint egl_major = 0, egl_minor = 0;
+	if (g_egl_display == EGL_NO_DISPLAY || !eglInitialize(g_egl_display, &egl_major, &egl_minor)) {
+		gl_log_err("ERROR: could not initialise EGL. error 0x%x\n", eglGetError());
+		return false;
+	}
+	gl_log("EGL %i.%i %s\n", egl_major, egl_minor, eglQueryString(g_egl_display, EGL_VENDOR));
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		gl_log_err("ERROR: EGL has no desktop OpenGL\n");
+		stop_gl_headless();
+		return false;
+	}
+
+	EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8, EGL_NONE };
+	EGLConfig config = NULL;
+	EGLint n_configs = 0;
+	eglChooseConfig(g_egl_display, config_attribs, &config, 1, &n_configs);
+	bool surfaceless = egl_has_extension(g_egl_display, "EGL_KHR_surfaceless_context");
+	if (n_configs < 1 && !egl_has_extension(g_egl_display, "EGL_KHR_no_config_context")) {
+		gl_log_err("ERROR: no usable EGL config\n");
+		stop_gl_headless();
+		return false;
+	}
+
+	EGLint context_attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 1, EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, EGL_TRUE, EGL_NONE };
+	g_egl_context = eglCreateContext(g_egl_display, n_configs > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+	if (g_egl_context == EGL_NO_CONTEXT) {
+		gl_log_err("ERROR: could not create a GL 4.1 core context. error 0x%x\n", eglGetError());
+		stop_gl_headless();
+		return false;
+	}
+	// everything is drawn into the FBO, so a surface is only needed if the context can't go without one
+	if (!surfaceless && n_configs > 0) {
+		EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		g_egl_surface = eglCreatePbufferSurface(g_egl_display, config, pbuffer_attribs);
+	}
+	if (!eglMakeCurrent(g_egl_display, g_egl_surface, g_egl_surface, g_egl_context)) {
+		gl_log_err("ERROR: could not make the EGL context current. error 0x%x\n", eglGetError());
+		stop_gl_headless();
+		return false;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)egl_proc_address)) {
+		gl_log_err("ERROR: failed to initialize GLAD\n");
+		stop_gl_headless();
+		return false;
+	}
+
+	glGenFramebuffers(1, &g_headless_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_headless_fbo);
+	glGenRenderbuffers(2, g_headless_renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, g_headless_renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_headless_renderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, g_headless_renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_headless_renderbuffers[1]);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		gl_log_err("ERROR: headless framebuffer incomplete. status 0x%x\n", status);
+		stop_gl_headless();
+		return false;
+	}
+	g_gl_width = width;
+	g_gl_height = height;
+	glViewport(0, 0, width, height);
+
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	const GLubyte* version = glGetString(GL_VERSION);
+	printf("Renderer: %s\n", renderer);
+	printf("OpenGL version supported %s\n", version);
+	gl_log("renderer: %s\nversion: %s\n", renderer, version);
+	detect_gl_caps();
+	log_gl_params();
+	return true;
+}
+
+void stop_gl_headless() {
+	if (g_egl_context != EGL_NO_CONTEXT && g_headless_fbo) {
+		glDeleteFramebuffers(1, &g_headless_fbo);
+		glDeleteRenderbuffers(2, g_headless_renderbuffers);
+		g_headless_fbo = 0;
+	}
+	if (g_egl_display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(g_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (g_egl_surface != EGL_NO_SURFACE) {
+			eglDestroySurface(g_egl_display, g_egl_surface);
+		}
+		if (g_egl_context != EGL_NO_CONTEXT) {
+			eglDestroyContext(g_egl_display, g_egl_context);
+		}
+		eglTerminate(g_egl_display);
+	}
+	g_egl_surface = EGL_NO_SURFACE;
+	g_egl_context = EGL_NO_CONTEXT;
+	g_egl_display = EGL_NO_DISPLAY;
+	gl_state_reset();
+}
+#endif
+
+bool write_framebuffer_ppm(const char* file_name, int width, int height) {
+	unsigned char* pixels = (unsigned char*)malloc(width * height * 3);
+	if (!pixels) {
+		return false;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+	FILE* file = fopen(file_name, "wb");
+	if (!file) {
+		gl_log_err("ERROR: could not open %s for writing\n", file_name);
+		free(pixels);
+		return false;
+	}
+	fprintf(file, "P6\n%i %i\n255\n", width, height);
+	// GL's rows start at the bottom
+	for (int y = height - 1; y >= 0; y--) {
+		fwrite(pixels + y * width * 3, 1, width * 3, file);
+	}
+	fclose(file);
+	free(pixels);
+	gl_log("wrote %ix%i framebuffer to %s\n", width, height, file_name);
+	return true;
+}
+
+gl_caps g_gl_caps;
+
+void detect_gl_caps() {
+	g_gl_caps.major = g_gl_caps.minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &g_gl_caps.major);
+	glGetIntegerv(GL_MINOR_VERSION, &g_gl_caps.minor);
+	int version = g_gl_caps.major * 10 + g_gl_caps.minor;
+	g_gl_caps.multi_draw_indirect = (version >= 43 || gl_extension_supported("GL_ARB_multi_draw_indirect")) &&
+		gl_proc_address("glMultiDrawElementsIndirect") != NULL;
+	g_gl_caps.buffer_storage = (version >= 44 || gl_extension_supported("GL_ARB_buffer_storage")) && gl_proc_address("glBufferStorage") != NULL;
+}
+
+void log_gl_params() {
+	GLenum params[] = {
+		GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,
+		GL_MAX_CUBE_MAP_TEXTURE_SIZE,
+		GL_MAX_DRAW_BUFFERS,
+		GL_MAX_FRAGMENT_UNIFORM_COMPONENTS,
+		GL_MAX_TEXTURE_IMAGE_UNITS,
+		GL_MAX_TEXTURE_SIZE,
+		GL_MAX_VARYING_FLOATS,
+		GL_MAX_VERTEX_ATTRIBS,
+		GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS,
+		GL_MAX_VERTEX_UNIFORM_COMPONENTS,
+		GL_MAX_VIEWPORT_DIMS,
+		GL_STEREO,
+	};
+	const char* names[] = {
+		"GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS",
+		"GL_MAX_CUBE_MAP_TEXTURE_SIZE",
+		"GL_MAX_DRAW_BUFFERS",
+		"GL_MAX_FRAGMENT_UNIFORM_COMPONENTS",
+		"GL_MAX_TEXTURE_IMAGE_UNITS",
+		"GL_MAX_TEXTURE_SIZE",
+		"GL_MAX_VARYING_FLOATS",
+		"GL_MAX_VERTEX_ATTRIBS",
+		"GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS",
+		"GL_MAX_VERTEX_UNIFORM_COMPONENTS",
+		"GL_MAX_VIEWPORT_DIMS",
+		"GL_STEREO",
+	};
+	gl_log("GL Context params:\n");
+	for (int i = 0; i < 10; i++) {
+		int v = 0;
+		glGetIntegerv(params[i], &v);
+		gl_log("%s %i\n", names[i], v);
+	}
+
+	int v[2] = { 0, 0 };
+	glGetIntegerv(params[10], v);
+	gl_log("%s %i %i\n", names[10], v[0], v[1]);
+	unsigned char s = 0;
+	glGetBooleanv(params[11], &s);
+	gl_log("%s %i\n", names[11], (unsigned int)s);
+	gl_log("context version %i.%i\n", g_gl_caps.major, g_gl_caps.minor);
+	gl_log("multi draw indirect: %s\n", g_gl_caps.multi_draw_indirect ? "yes" : "no");
+	gl_log("buffer storage: %s\n", g_gl_caps.buffer_storage ? "yes" : "no");
+	gl_log("-----------------------------\n");
+}
+
+const char* GL_type_to_string(unsigned int type) {
+	switch (type) {
+	case GL_BOOL: return "bool";
+	case GL_INT: return "int";
+	case GL_FLOAT: return "float";
+	case GL_FLOAT_VEC2: return "vec2";
+	case GL_FLOAT_VEC3: return "vec3";
+	case GL_FLOAT_VEC4: return "vec4";
+	case GL_FLOAT_MAT2: return "mat2";
+	case GL_FLOAT_MAT3: return "mat3";
+	case GL_FLOAT_MAT4: return "mat4";
+	case GL_SAMPLER_2D: return "sampler2D";
+	case GL_SAMPLER_3D: return "sampler3D";
+	case GL_SAMPLER_CUBE: return "samplerCube";
+	case GL_SAMPLER_2D_SHADOW: return "sampler2DShadow";
+	default: break;
+	}
+	return "other";
+}
+
 void glfw_error_callback(int error, const char* description) {
 	fputs(description, stderr);
 	gl_log_err("%s\n", description);
@@ -105,20 +684,22 @@ void glfw_framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 	printf("width %i height %i\n", width, height);
 }
 
+/* times the frame with the profiler and once a second puts the frame time
+percentiles in the window title. the title is only a glance - use
+profiler_frame_stats() or a trace for real numbers */
 void _update_fps_counter(GLFWwindow* window) {
 	static double previous_seconds = glfwGetTime();
-	static int frame_count = 0;
+	profiler_frame();
 	double current_seconds = glfwGetTime();
-	double elapsed_seconds = current_seconds - previous_seconds;
-	if (elapsed_seconds > 0.25) {
+	if (current_seconds - previous_seconds > 1.0) {
 		previous_seconds = current_seconds;
-		double fps = (double)frame_count / elapsed_seconds;
-		char tmp[128];
-		sprintf(tmp, "opengl @ fps: %.2f", fps);
-		glfwSetWindowTitle(window, tmp);
-		frame_count = 0;
+		frame_stats stats;
+		if (profiler_frame_stats(&stats)) {
+			char tmp[128];
+			snprintf(tmp, sizeof(tmp), "opengl @ p50 %.2f ms  p99 %.2f ms  max %.2f ms", stats.p50_ms, stats.p99_ms, stats.max_ms);
+			glfwSetWindowTitle(window, tmp);
+		}
 	}
-	frame_count++;
 }
 
 bool parse_file_into_str(const char* file_name, char* shader_str, int max_len) {
@@ -143,6 +724,89 @@ bool parse_file_into_str(const char* file_name, char* shader_str, int max_len) {
 	return true;
 }
 
+bool map_file(const char* file_name, mapped_file* mf) {
+	mf->data = NULL;
+	mf->size = 0;
+#ifdef _WIN32
+	mf->file = INVALID_HANDLE_VALUE;
+	mf->mapping = NULL;
+	HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		gl_log_err("ERROR: opening file for reading: %s\n", file_name);
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		gl_log_err("ERROR: reading size of file %s\n", file_name);
+		CloseHandle(file);
+		return false;
+	}
+	mf->file = file;
+	mf->size = (size_t)size.QuadPart;
+	if (mf->size == 0) {
+		mf->data = "";
+		return true;
+	}
+	mf->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mf->mapping) {
+		mf->data = (const char*)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		gl_log_err("ERROR: opening file for reading: %s\n", file_name);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		gl_log_err("ERROR: reading size of file %s\n", file_name);
+		close(fd);
+		return false;
+	}
+	mf->size = (size_t)st.st_size;
+	if (mf->size == 0) {
+		// mmap refuses zero-length mappings
+		close(fd);
+		mf->data = "";
+		return true;
+	}
+	void* p = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (p != MAP_FAILED) {
+		mf->data = (const char*)p;
+	}
+#endif
+	if (!mf->data) {
+		gl_log_err("ERROR: could not map file %s\n", file_name);
+		unmap_file(mf);
+		return false;
+	}
+	return true;
+}
+
+void unmap_file(mapped_file* mf) {
+#ifdef _WIN32
+	if (mf->data && mf->size > 0) {
+		UnmapViewOfFile(mf->data);
+	}
+	if (mf->mapping) {
+		CloseHandle(mf->mapping);
+	}
+	if (mf->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mf->file);
+	}
+	mf->mapping = NULL;
+	mf->file = INVALID_HANDLE_VALUE;
+#else
+	if (mf->data && mf->size > 0) {
+		munmap((void*)mf->data, mf->size);
+	}
+#endif
+	mf->data = NULL;
+	mf->size = 0;
+}
+
 void print_shader_info_log(GLuint shader_index) {
 	int max_length = 2048;
 	int actual_length = 0;
@@ -152,19 +816,81 @@ void print_shader_info_log(GLuint shader_index) {
 	gl_log("shader info log for GL index %i: \n%s\n", shader_index, log);
 }
 
-bool create_shader(const char* file_name, GLuint* shader, GLenum type) {
-	gl_log("creating shader form %s...\n", file_name);
-	char shader_string[MAX_SHADER_LENGTH];
-	parse_file_into_str(file_name, shader_string, MAX_SHADER_LENGTH);
-	*shader = glCreateShader(type);
-	const GLchar* p = (const GLchar*)shader_string;
-	glShaderSource(*shader, 1, &p, NULL);
-	glCompileShader(*shader);
+/* end of the #version line (just past its newline), or 0 if there isn't one.
+comments and blank lines may come before it. a directive is a # at the start of a
+line, optionally indented, with optional spaces before the name */
+static size_t find_version_line_end(const char* source, size_t length) {
+	size_t line = 0;
+	while (line < length) {
+		size_t p = line;
+		while (p < length && (source[p] == ' ' || source[p] == '\t')) {
+			p++;
+		}
+		bool is_version = false;
+		if (p < length && source[p] == '#') {
+			p++;
+			while (p < length && (source[p] == ' ' || source[p] == '\t')) {
+				p++;
+			}
+			is_version = length - p >= 7 && strncmp(source + p, "version", 7) == 0;
+		}
+		while (p < length && source[p] != '\n') {
+			p++;
+		}
+		if (p < length) {
+			p++;
+		}
+		if (is_version) {
+			return p;
+		}
+		line = p;
+	}
+	return 0;
+}
+
+GLuint start_shader_compile(const char* source, size_t length, const char* defines, GLenum type) {
+	/* source is handed over as several strings so nothing is copied: everything up
+	to and including the #version line (which has to come before anything else),
+	the defines, then the rest of the file. newlines are slipped in between where
+	the pieces don't end in one */
+	const GLchar* strings[5];
+	GLint lengths[5];
+	int count = 0;
+	size_t body = 0;
+	if (defines && defines[0]) {
+		body = find_version_line_end(source, length);
+		if (body > 0) {
+			strings[count] = source;
+			lengths[count++] = (GLint)body;
+			if (source[body - 1] != '\n') {
+				strings[count] = "\n";
+				lengths[count++] = 1;
+			}
+		}
+		size_t defines_length = strlen(defines);
+		strings[count] = defines;
+		lengths[count++] = (GLint)defines_length;
+		if (defines[defines_length - 1] != '\n') {
+			strings[count] = "\n";
+			lengths[count++] = 1;
+		}
+	}
+	strings[count] = source + body;
+	lengths[count++] = (GLint)(length - body);
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, count, strings, lengths);
+	glCompileShader(shader);
+	return shader;
+}
+
+bool create_shader_from_source(const char* name, const char* source, size_t length, const char* defines, GLuint* shader, GLenum type) {
+	*shader = start_shader_compile(source, length, defines, type);
 
 	int params = -1;
 	glGetShaderiv(*shader, GL_COMPILE_STATUS, &params);
 	if (params != GL_TRUE) {
-		gl_log_err("ERROR: GL shader index %i did not compile\n", *shader);
+		gl_log_err("ERROR: GL shader index %i (%s) did not compile\n", *shader, name);
 		print_shader_info_log(*shader);
 		return false;
 	}
@@ -172,6 +898,19 @@ bool create_shader(const char* file_name, GLuint* shader, GLenum type) {
 	return true;
 }
 
+bool create_shader(const char* file_name, GLuint* shader, GLenum type) {
+	gl_log("creating shader form %s...\n", file_name);
+	mapped_file source;
+	if (!map_file(file_name, &source)) {
+		*shader = 0;
+		return false;
+	}
+	// the mapping isn't null-terminated so the length is passed on. GL takes its own copy
+	bool result = create_shader_from_source(file_name, source.data, source.size, NULL, shader, type);
+	unmap_file(&source);
+	return result;
+}
+
 void print_programme_info_log(GLuint sp) {
 	int max_length = 2048;
 	int actual_length = 0;
@@ -194,25 +933,32 @@ bool is_programme_valid(GLuint sp) {
 	return true;
 }
 
-bool create_programme(GLuint vert, GLuint frag, GLuint* programme) {
-	*programme = glCreateProgram();
-	gl_log("created programme %u. attaching shaders %u and %u...\n", *programme, vert, frag);
-	glAttachShader(*programme, vert);
-	glAttachShader(*programme, frag);
-	glLinkProgram(*programme);
+bool link_programme(GLuint programme, GLuint vert, GLuint frag) {
+	// relinking resets the uniforms
+	gl_state_forget_programme(programme);
+	gl_log("attaching shaders %u and %u to programme %u...\n", vert, frag, programme);
+	glAttachShader(programme, vert);
+	glAttachShader(programme, frag);
+	glLinkProgram(programme);
 	GLint params = -1;
-	glGetProgramiv(*programme, GL_LINK_STATUS, &params);
+	glGetProgramiv(programme, GL_LINK_STATUS, &params);
 	if (params != GL_TRUE) {
-		gl_log_err("ERROR: could not link shader programme GL index%u\n", *programme);
-		print_programme_info_log(*programme);
+		gl_log_err("ERROR: could not link shader programme GL index%u\n", programme);
+		print_programme_info_log(programme);
 		return false;
 	}
-	is_programme_valid(*programme);
+	is_programme_valid(programme);
 	glDeleteShader(vert);
 	glDeleteShader(frag);
 	return true;
 }
 
+bool create_programme(GLuint vert, GLuint frag, GLuint* programme) {
+	*programme = glCreateProgram();
+	gl_log("created programme %u\n", *programme);
+	return link_programme(*programme, vert, frag);
+}
+
 GLuint create_programme_from_files(const char* vert_file_name, const char* frag_file_name) {
 	GLuint vert, frag, programme;
 	create_shader(vert_file_name, &vert, GL_VERTEX_SHADER);
@@ -220,3 +966,292 @@ GLuint create_programme_from_files(const char* vert_file_name, const char* frag_
 	create_programme(vert, frag, &programme);
 	return programme;
 }
+
+/*-----------------------------GL STATE CACHE--------------------------------*/
+#define GL_STATE_UNKNOWN 0xFFFFFFFF
+#define GL_STATE_N_BUFFER_TARGETS 6
+#define GL_STATE_N_CAPS 4
+#define GL_STATE_N_TEXTURE_UNITS 16
+
+static const GLenum g_state_buffer_targets[GL_STATE_N_BUFFER_TARGETS] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+	GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER };
+static const GLenum g_state_caps[GL_STATE_N_CAPS] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST };
+
+// up to a mat4 of raw 32-bit words, compared bitwise so NaNs and -0 are handled
+struct uniform_shadow {
+	unsigned int words[16];
+	int n_words;
+};
+
+struct gl_state_shadow {
+	GLuint programme;
+	GLuint vao;
+	GLuint buffers[GL_STATE_N_BUFFER_TARGETS];
+	GLuint active_texture_unit;
+	GLuint textures[GL_STATE_N_TEXTURE_UNITS];
+	GLint viewport[4];
+	GLuint caps[GL_STATE_N_CAPS]; // GL_STATE_UNKNOWN, 0 or 1
+	GLenum depth_func;
+	GLuint depth_mask;
+	GLenum cull_face;
+	GLenum front_face;
+	// key is programme << 32 | location
+	std::unordered_map<unsigned long long, uniform_shadow> uniforms;
+};
+
+static gl_state_shadow g_state;
+static gl_state_counters g_state_counters;
+static bool g_state_initialised = false;
+
+void gl_state_reset() {
+	g_state.programme = GL_STATE_UNKNOWN;
+	g_state.vao = GL_STATE_UNKNOWN;
+	for (int i = 0; i < GL_STATE_N_BUFFER_TARGETS; i++) {
+		g_state.buffers[i] = GL_STATE_UNKNOWN;
+	}
+	g_state.active_texture_unit = GL_STATE_UNKNOWN;
+	for (int i = 0; i < GL_STATE_N_TEXTURE_UNITS; i++) {
+		g_state.textures[i] = GL_STATE_UNKNOWN;
+	}
+	for (int i = 0; i < 4; i++) {
+		g_state.viewport[i] = -1;
+	}
+	for (int i = 0; i < GL_STATE_N_CAPS; i++) {
+		g_state.caps[i] = GL_STATE_UNKNOWN;
+	}
+	g_state.depth_func = GL_STATE_UNKNOWN;
+	g_state.depth_mask = GL_STATE_UNKNOWN;
+	g_state.cull_face = GL_STATE_UNKNOWN;
+	g_state.front_face = GL_STATE_UNKNOWN;
+	g_state.uniforms.clear();
+	g_state_initialised = true;
+}
+
+static inline void check_state_initialised() {
+	if (!g_state_initialised) {
+		gl_state_reset();
+	}
+}
+
+// true if the value differs from the cached one, and updates the cache
+static inline bool state_changed(GLuint* cached, GLuint value) {
+	check_state_initialised();
+	if (*cached == value) {
+		g_state_counters.skipped++;
+		return false;
+	}
+	*cached = value;
+	g_state_counters.issued++;
+	return true;
+}
+
+void gl_state_forget_programme(GLuint programme) {
+	check_state_initialised();
+	if (g_state.programme == programme) {
+		g_state.programme = GL_STATE_UNKNOWN;
+	}
+	for (auto it = g_state.uniforms.begin(); it != g_state.uniforms.end();) {
+		if ((GLuint)(it->first >> 32) == programme) {
+			it = g_state.uniforms.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void gl_state_forget_vao(GLuint vao) {
+	check_state_initialised();
+	if (g_state.vao == vao) {
+		g_state.vao = GL_STATE_UNKNOWN;
+		g_state.buffers[1] = GL_STATE_UNKNOWN;
+	}
+}
+
+void gl_state_forget_buffer(GLuint buffer) {
+	check_state_initialised();
+	for (int i = 0; i < GL_STATE_N_BUFFER_TARGETS; i++) {
+		if (g_state.buffers[i] == buffer) {
+			g_state.buffers[i] = GL_STATE_UNKNOWN;
+		}
+	}
+}
+
+void gl_state_forget_texture(GLuint texture) {
+	check_state_initialised();
+	for (int i = 0; i < GL_STATE_N_TEXTURE_UNITS; i++) {
+		if (g_state.textures[i] == texture) {
+			g_state.textures[i] = GL_STATE_UNKNOWN;
+		}
+	}
+}
+
+void gl_state_use_programme(GLuint programme) {
+	if (state_changed(&g_state.programme, programme)) {
+		glUseProgram(programme);
+	}
+}
+
+void gl_state_bind_vao(GLuint vao) {
+	if (state_changed(&g_state.vao, vao)) {
+		glBindVertexArray(vao);
+		// the element buffer binding belongs to the VAO
+		g_state.buffers[1] = GL_STATE_UNKNOWN;
+	}
+}
+
+void gl_state_bind_buffer(GLenum target, GLuint buffer) {
+	for (int i = 0; i < GL_STATE_N_BUFFER_TARGETS; i++) {
+		if (g_state_buffer_targets[i] == target) {
+			if (state_changed(&g_state.buffers[i], buffer)) {
+				glBindBuffer(target, buffer);
+			}
+			return;
+		}
+	}
+	g_state_counters.issued++;
+	glBindBuffer(target, buffer);
+}
+
+void gl_state_bind_texture(GLuint unit, GLuint texture) {
+	check_state_initialised();
+	if (unit >= GL_STATE_N_TEXTURE_UNITS) {
+		g_state_counters.issued++;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		g_state.active_texture_unit = unit;
+		glBindTexture(GL_TEXTURE_2D, texture);
+		return;
+	}
+	if (!state_changed(&g_state.textures[unit], texture)) {
+		return;
+	}
+	if (g_state.active_texture_unit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		g_state.active_texture_unit = unit;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	check_state_initialised();
+	GLint* v = g_state.viewport;
+	if (v[0] == x && v[1] == y && v[2] == width && v[3] == height) {
+		g_state_counters.skipped++;
+		return;
+	}
+	v[0] = x;
+	v[1] = y;
+	v[2] = width;
+	v[3] = height;
+	g_state_counters.issued++;
+	glViewport(x, y, width, height);
+}
+
+void gl_state_enable(GLenum cap, bool enabled) {
+	int i = 0;
+	while (i < GL_STATE_N_CAPS && g_state_caps[i] != cap) {
+		i++;
+	}
+	if (i < GL_STATE_N_CAPS) {
+		if (!state_changed(&g_state.caps[i], enabled ? 1 : 0)) {
+			return;
+		}
+	} else {
+		g_state_counters.issued++;
+	}
+	if (enabled) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+}
+
+void gl_state_depth_func(GLenum func) {
+	if (state_changed(&g_state.depth_func, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void gl_state_depth_mask(bool write) {
+	if (state_changed(&g_state.depth_mask, write ? 1 : 0)) {
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void gl_state_cull_face(GLenum face) {
+	if (state_changed(&g_state.cull_face, face)) {
+		glCullFace(face);
+	}
+}
+
+void gl_state_front_face(GLenum dir) {
+	if (state_changed(&g_state.front_face, dir)) {
+		glFrontFace(dir);
+	}
+}
+
+/* true if n_words of data differ from the last value set at this location.
+location -1 is silently ignored by GL so it's always skipped */
+static bool uniform_changed(GLuint programme, GLint location, const void* data, int n_words) {
+	check_state_initialised();
+	if (location < 0) {
+		g_state_counters.skipped++;
+		return false;
+	}
+	unsigned long long key = ((unsigned long long)programme << 32) | (unsigned int)location;
+	uniform_shadow* shadow = &g_state.uniforms[key];
+	size_t n_bytes = n_words * sizeof(unsigned int);
+	if (shadow->n_words == n_words && memcmp(shadow->words, data, n_bytes) == 0) {
+		g_state_counters.skipped++;
+		return false;
+	}
+	memcpy(shadow->words, data, n_bytes);
+	shadow->n_words = n_words;
+	g_state_counters.issued++;
+	return true;
+}
+
+void gl_state_uniform1i(GLuint programme, GLint location, int i) {
+	if (uniform_changed(programme, location, &i, 1)) {
+		glProgramUniform1i(programme, location, i);
+	}
+}
+
+void gl_state_uniform1f(GLuint programme, GLint location, float x) {
+	if (uniform_changed(programme, location, &x, 1)) {
+		glProgramUniform1f(programme, location, x);
+	}
+}
+
+void gl_state_uniform2f(GLuint programme, GLint location, float x, float y) {
+	float v[2] = { x, y };
+	if (uniform_changed(programme, location, v, 2)) {
+		glProgramUniform2f(programme, location, x, y);
+	}
+}
+
+void gl_state_uniform3f(GLuint programme, GLint location, float x, float y, float z) {
+	float v[3] = { x, y, z };
+	if (uniform_changed(programme, location, v, 3)) {
+		glProgramUniform3f(programme, location, x, y, z);
+	}
+}
+
+void gl_state_uniform4f(GLuint programme, GLint location, float x, float y, float z, float w) {
+	float v[4] = { x, y, z, w };
+	if (uniform_changed(programme, location, v, 4)) {
+		glProgramUniform4f(programme, location, x, y, z, w);
+	}
+}
+
+void gl_state_uniform_mat4(GLuint programme, GLint location, const float* m) {
+	if (uniform_changed(programme, location, m, 16)) {
+		glProgramUniformMatrix4fv(programme, location, 1, GL_FALSE, m);
+	}
+}
+
+const gl_state_counters* gl_state_get_counters() { return &g_state_counters; }
+
+void gl_state_reset_counters() {
+	g_state_counters.issued = 0;
+	g_state_counters.skipped = 0;
+}
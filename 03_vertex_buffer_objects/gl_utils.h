@@ -3,6 +3,7 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <cstdarg>
+#include <cstddef>
 
 #define GL_LOG_FILE "gl.log"
 
@@ -13,14 +14,61 @@ extern GLFWwindow* g_window;
 
 bool start_gl();
 
+#ifdef GL_UTILS_HEADLESS
+/* build with GL_UTILS_HEADLESS (and link EGL) for machines with no display.
+creates the same GL 4.1 core context as start_gl() through EGL - the Mesa
+surfaceless platform if it's there, otherwise a pbuffer on the default display -
+so it runs on llvmpipe on a CPU-only box. there's no window: rendering goes
+into g_headless_fbo, width x height with colour and depth, which is left bound.
+g_window stays NULL, so don't call the glfw window functions */
+extern GLuint g_headless_fbo;
+
+bool start_gl_headless(int width, int height);
+
+void stop_gl_headless();
+#endif
+
+// reads back the bound framebuffer and writes it as a binary PPM, e.g. for pixel regression tests
+bool write_framebuffer_ppm(const char* file_name, int width, int height);
+
+// checks the GL_EXTENSIONS list of the current context
+bool gl_extension_supported(const char* name);
+
+/* clears any errors left by earlier calls, so that the next glGetError()
+reports only what comes after */
+void gl_clear_errors();
+
+// looks up a GL entry point that the loader doesn't provide
+void* gl_proc_address(const char* name);
+
 bool restart_gl_log();
 
 bool gl_log(const char* message, ...);
 
 bool gl_log_err(const char* message, ...);
 
+// write out everything logged so far
+void gl_log_flush();
+
+// stop the log thread and close the log file. registered with atexit()
+void gl_log_shutdown();
+
 void glfw_error_callback(int error, const char* description);
 
+/* optional features of the current context, filled in by detect_gl_caps().
+start_gl() only asks for 4.1, so anything newer is found here at startup */
+struct gl_caps {
+	int major;
+	int minor;
+	bool multi_draw_indirect; // GL 4.3 or GL_ARB_multi_draw_indirect
+	bool buffer_storage;      // GL 4.4 or GL_ARB_buffer_storage
+};
+
+extern gl_caps g_gl_caps;
+
+void detect_gl_caps();
+
+// logs the context limits and the detected caps
 void log_gl_params();
 
 void _update_fps_counter(GLFWwindow* window);
@@ -38,3 +86,79 @@ void print_all(GLuint sp);
 bool is_valid(GLuint sp);
 
 bool parse_file_into_str(const char* file_name, char* shader_str, int max_len);
+
+// read-only view of a whole file. data is NOT null-terminated - use size
+struct mapped_file {
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
+
+// memory-maps the whole file, no size limit and no copy
+bool map_file(const char* file_name, mapped_file* mf);
+
+void unmap_file(mapped_file* mf);
+
+/* creates a shader and issues the compile without waiting for the result. see
+create_shader_from_source() for the arguments */
+GLuint start_shader_compile(const char* source, size_t length, const char* defines, GLenum type);
+
+/* compiles length bytes of source (need not be null-terminated). defines, if
+not NULL, is inserted straight after the #version line */
+bool create_shader_from_source(const char* name, const char* source, size_t length, const char* defines, GLuint* shader, GLenum type);
+
+bool create_shader(const char* file_name, GLuint* shader, GLenum type);
+
+// attach, link and validate an existing programme. deletes the shaders on success
+bool link_programme(GLuint programme, GLuint vert, GLuint frag);
+
+bool create_programme(GLuint vert, GLuint frag, GLuint* programme);
+
+GLuint create_programme_from_files(const char* vert_file_name, const char* frag_file_name);
+
+/* shadow copy of the GL state that the render loop keeps setting. each
+gl_state_*() call compares against what was last set and only calls GL when the
+value actually changes. everything starts as unknown, so the first call always
+goes through. if GL state is changed behind the cache's back (or a context is
+recreated) call gl_state_reset(). only use from the thread that owns the
+context */
+struct gl_state_counters {
+	unsigned long long issued;  // calls that reached GL
+	unsigned long long skipped; // calls dropped because nothing changed
+};
+
+void gl_state_reset();
+
+// forget everything cached about an object before deleting or relinking it
+void gl_state_forget_programme(GLuint programme);
+void gl_state_forget_vao(GLuint vao);
+void gl_state_forget_buffer(GLuint buffer);
+void gl_state_forget_texture(GLuint texture);
+
+void gl_state_use_programme(GLuint programme);
+void gl_state_bind_vao(GLuint vao);
+// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_DRAW_INDIRECT_BUFFER etc.
+void gl_state_bind_buffer(GLenum target, GLuint buffer);
+// GL_TEXTURE_2D on a texture unit. switches the active unit only when it needs to
+void gl_state_bind_texture(GLuint unit, GLuint texture);
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+// GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND and GL_SCISSOR_TEST are cached. anything else is passed through
+void gl_state_enable(GLenum cap, bool enabled);
+void gl_state_depth_func(GLenum func);
+void gl_state_depth_mask(bool write);
+void gl_state_cull_face(GLenum face);
+void gl_state_front_face(GLenum dir);
+
+// glProgramUniform*() with the last value per programme + location remembered
+void gl_state_uniform1i(GLuint programme, GLint location, int i);
+void gl_state_uniform1f(GLuint programme, GLint location, float x);
+void gl_state_uniform2f(GLuint programme, GLint location, float x, float y);
+void gl_state_uniform3f(GLuint programme, GLint location, float x, float y, float z);
+void gl_state_uniform4f(GLuint programme, GLint location, float x, float y, float z, float w);
+void gl_state_uniform_mat4(GLuint programme, GLint location, const float* m);
+
+const gl_state_counters* gl_state_get_counters();
+void gl_state_reset_counters();
@@ -0,0 +1,60 @@
+#include "instancing.h"
+#include "gl_utils.h"
+
+bool instance_stream_create(instance_stream* is, size_t max_instances) {
+	is->capacity = max_instances > 0 ? max_instances : 1;
+	is->count = 0;
+	gl_clear_errors();
+	glGenBuffers(1, &is->vbo);
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, is->vbo);
+	glBufferData(GL_ARRAY_BUFFER, is->capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	gl_log("instance buffer %u: room for %u matrices\n", is->vbo, (unsigned int)is->capacity);
+	return glGetError() == GL_NO_ERROR;
+}
+
+void instance_stream_destroy(instance_stream* is) {
+	gl_state_forget_buffer(is->vbo);
+	glDeleteBuffers(1, &is->vbo);
+	is->vbo = 0;
+	is->capacity = is->count = 0;
+}
+
+void instance_stream_attach(const instance_stream* is, GLuint vao, GLuint first_location) {
+	gl_state_bind_vao(vao);
+	instance_stream_point(is, first_location, 0);
+}
+
+void instance_stream_point(const instance_stream* is, GLuint first_location, size_t first_instance) {
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, is->vbo);
+	// mat4 is 16 floats in column order, so column i is 4 floats at i * 16 bytes
+	size_t base = first_instance * sizeof(mat4);
+	for (GLuint i = 0; i < 4; i++) {
+		GLuint location = first_location + i;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (const GLvoid*)(base + i * 4 * sizeof(float)));
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+}
+
+void instance_stream_upload(instance_stream* is, const mat4* matrices, size_t count) {
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, is->vbo);
+	if (count > is->capacity) {
+		while (is->capacity < count) {
+			is->capacity *= 2;
+		}
+		gl_log("instance buffer %u grown to %u matrices\n", is->vbo, (unsigned int)is->capacity);
+	}
+	glBufferData(GL_ARRAY_BUFFER, is->capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(mat4), matrices);
+	is->count = count;
+}
+
+void draw_arrays_instanced(GLuint vao, GLint first, GLsizei n_vertices, const instance_stream* is) {
+	gl_state_bind_vao(vao);
+	glDrawArraysInstanced(GL_TRIANGLES, first, n_vertices, (GLsizei)is->count);
+}
+
+void draw_elements_instanced(GLuint vao, GLsizei n_indices, GLenum index_type, size_t index_offset, const instance_stream* is) {
+	gl_state_bind_vao(vao);
+	glDrawElementsInstanced(GL_TRIANGLES, n_indices, index_type, (const GLvoid*)index_offset, (GLsizei)is->count);
+}
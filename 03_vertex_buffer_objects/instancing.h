@@ -0,0 +1,49 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "maths_funcs.h"
+#include <cstddef>
+
+/* per-instance model matrices for drawing many copies of a mesh in one call.
+the matrices are uploaded as-is from mat4 arrays (e.g. transform_store::world)
+into an instance buffer, and a mat4 vertex attribute reads one per instance -
+it fills 4 consecutive vec4 locations, each with a divisor of 1. see
+test_instanced_vs.glsl.
+
+  instance_stream is;
+  instance_stream_create( &is, 100000 );
+  instance_stream_attach( &is, vao, INSTANCE_MATRIX_LOCATION );
+  each frame:
+    instance_stream_upload( &is, store.world.data(), store.size() );
+    draw_arrays_instanced( vao, 0, 3, &is );
+*/
+
+#define INSTANCE_MATRIX_LOCATION 2 // uses 2, 3, 4 and 5
+
+struct instance_stream {
+	GLuint vbo;
+	size_t capacity; // in matrices
+	size_t count;    // matrices in the last upload
+};
+
+bool instance_stream_create(instance_stream* is, size_t max_instances);
+
+void instance_stream_destroy(instance_stream* is);
+
+// points locations first_location to first_location + 3 of vao at the instance buffer
+void instance_stream_attach(const instance_stream* is, GLuint vao, GLuint first_location);
+
+/* same, but for the VAO that's already bound and starting first_instance
+matrices into the buffer. GL 4.1 has no base instance for draws, so this is
+how several instanced draws share one upload */
+void instance_stream_point(const instance_stream* is, GLuint first_location, size_t first_instance);
+
+/* replaces the instance data. the old storage is orphaned first so a frame
+still drawing from it isn't stalled. grows the buffer if count is bigger than
+the capacity - the buffer name stays the same so attached VAOs still work */
+void instance_stream_upload(instance_stream* is, const mat4* matrices, size_t count);
+
+// one call for every instance in the stream
+void draw_arrays_instanced(GLuint vao, GLint first, GLsizei n_vertices, const instance_stream* is);
+
+void draw_elements_instanced(GLuint vao, GLsizei n_indices, GLenum index_type, size_t index_offset, const instance_stream* is);
@@ -1,4 +1,7 @@
 #include "gl_utils.h"
+#include "frame_profiler.h"
+#include "shader_watch.h"
+#include "vertex_format.h"
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <cassert>
@@ -9,102 +12,142 @@
 #include <ctime>
 
 #define GL_LOG_FILE "gl.log"
+#define HEADLESS_FRAMES 100
 
 int g_gl_width = 640;
 int g_gl_height = 480;
 GLFWwindow* g_window = NULL;
 
+static void log_frame_stats() {
+	frame_stats stats;
+	if (profiler_frame_stats(&stats)) {
+		gl_log("last %i frames: mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n", stats.n_frames, stats.mean_ms, stats.p50_ms, stats.p95_ms,
+			stats.p99_ms, stats.max_ms);
+	}
+	if (profiler_gpu_frame_stats(&stats)) {
+		gl_log("GPU, last %i frames: mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f. %u frames dropped\n", stats.n_frames, stats.mean_ms,
+			stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms, profiler_gpu_dropped_frames());
+	}
+}
+
 int main() {
 	restart_gl_log();
+#ifdef GL_UTILS_HEADLESS
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		return 1;
+	}
+#else
 	start_gl();
+#endif
+	profiler_gpu_init();
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
+	gl_state_enable(GL_DEPTH_TEST, true);
+	gl_state_depth_func(GL_LESS);
 
 	GLfloat points[] = { 0.0f, 0.5f, 0.0f, 0.5f, -0.5f, 0.0f, -0.5f, -0.5f, 0.0f };
 	GLfloat colours[] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
 
-	GLuint points_vbo;
-	glGenBuffers(1, &points_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-	glBufferData(GL_ARRAY_BUFFER, 9 * sizeof(GLfloat), points, GL_STATIC_DRAW);
-
-	GLuint colours_vbo;
-	glGenBuffers(1, &colours_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, colours_vbo);
-	glBufferData(GL_ARRAY_BUFFER, 9 * sizeof(GLfloat), colours, GL_STATIC_DRAW);
-
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glBindBuffer(GL_ARRAY_BUFFER, colours_vbo);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-
-	char vertex_shader[1024 * 256];
-	char fragment_shader[1024 * 256];
-	parse_file_into_str("test_vs.glsl", vertex_shader, 1024 * 256);
-	parse_file_into_str("test_fs.glsl", fragment_shader, 1024 * 256);
-
-	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-	const GLchar* p = (const GLchar*)vertex_shader;
-	glShaderSource(vs, 1, &p, NULL);
-	glCompileShader(vs);
-
-	int params = -1;
-	glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-	if (params != GL_TRUE) {
-		fprintf(stderr, "ERROR: GL shader index %i did not compile\n", vs);
-		print_shader_info_log(vs);
+	/* one interleaved buffer: float3 position then a unorm8 colour, 16 bytes a
+	vertex */
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	vertex_format_add(&fmt, 1, 3, VA_UNORM8);
+	const float* sources[] = { points, colours };
+	GLuint vbo = create_interleaved_vbo(&fmt, sources, 3);
+	GLuint vao = create_vao_for_format(&fmt, vbo);
+
+	GLuint vs, fs, shader_programme;
+	if (!create_shader("test_vs.glsl", &vs, GL_VERTEX_SHADER)) {
 		return 1;
 	}
-
-	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-	p = (const GLchar*)fragment_shader;
-	glShaderSource(fs, 1, &p, NULL);
-	glCompileShader(fs);
-
-	glGetShaderiv(fs, GL_COMPILE_STATUS, &params);
-	if (params != GL_TRUE) {
-		fprintf(stderr, "ERROR: GL shader index %i did not compile\n", fs);
-		print_shader_info_log(fs);
+	if (!create_shader("test_fs.glsl", &fs, GL_FRAGMENT_SHADER)) {
 		return 1;
 	}
-
-	GLuint shader_programme = glCreateProgram();
-	glAttachShader(shader_programme, vs);
-	glAttachShader(shader_programme, fs);
-	glLinkProgram(shader_programme);
-
-	glGetProgramiv(shader_programme, GL_LINK_STATUS, &params);
-	if (params != GL_TRUE) {
-		fprintf(stderr, "ERROR: could not link shader programme GL index %i\n", shader_programme);
-		print_programme_info_log(shader_programme);
-		return false;
+	if (!create_programme(vs, fs, &shader_programme)) {
+		return 1;
 	}
 
-	glEnable(GL_DEPTH_TEST);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CW);
-
+#ifdef GL_UTILS_HEADLESS
+	// no window to close. draw a fixed number of frames and save the last one
+	gl_state_cull_face(GL_BACK);
+	gl_state_front_face(GL_CW);
+	for (int frame = 0; frame < HEADLESS_FRAMES; frame++) {
+		profiler_frame();
+		{
+			GPU_PROFILE_SCOPE("clear");
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		GPU_PROFILE_SCOPE("draw");
+		gl_state_viewport(0, 0, g_gl_width, g_gl_height);
+		gl_state_use_programme(shader_programme);
+		gl_state_bind_vao(vao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		// stands in for the swap, which is what normally submits the frame
+		glFlush();
+	}
+	// enough extra frame boundaries for the last frames' GPU times to be read back
+	glFinish();
+	for (int frame = 0; frame < PROFILER_GPU_LATENCY; frame++) {
+		profiler_frame();
+	}
+	glFinish();
+	write_framebuffer_ppm("headless.ppm", g_gl_width, g_gl_height);
+	log_frame_stats();
+	profiler_write_trace("trace.json");
+	profiler_gpu_shutdown();
+	stop_gl_headless();
+#else
+	// edits to the shader files are picked up without restarting
+	shader_watcher watcher;
+	shader_watch_start(&watcher);
+	int watch_handle = shader_watch_add(&watcher, "test_vs.glsl", "test_fs.glsl", shader_programme);
+
+	gl_state_enable(GL_DEPTH_TEST, true);
+	gl_state_cull_face(GL_BACK);
+	gl_state_front_face(GL_CW);
+
+	bool p_was_down = false;
 	while (!glfwWindowShouldClose(g_window)) {
 		_update_fps_counter(g_window);
+		{
+			PROFILE_SCOPE("shader_watch_update");
+			shader_watch_update(&watcher);
+			shader_programme = shader_watch_programme(&watcher, watch_handle);
+		}
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, g_gl_width, g_gl_height);
-
-		glUseProgram(shader_programme);
-		glBindVertexArray(vao);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
+		{
+			GPU_PROFILE_SCOPE("clear");
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		{
+			GPU_PROFILE_SCOPE("draw");
+			gl_state_viewport(0, 0, g_gl_width, g_gl_height);
+
+			// these only reach GL when the values change
+			gl_state_use_programme(shader_programme);
+			gl_state_bind_vao(vao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
 		glfwPollEvents();
 		if (glfwGetKey(g_window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 			glfwSetWindowShouldClose(g_window, 1);
 		}
+		// dump the last few seconds as a chrome://tracing file, once per press
+		bool p_down = glfwGetKey(g_window, GLFW_KEY_P) == GLFW_PRESS;
+		if (p_down && !p_was_down) {
+			profiler_write_trace("trace.json");
+		}
+		p_was_down = p_down;
+		PROFILE_SCOPE("swap");
 		glfwSwapBuffers(g_window);
 	}
+	shader_watch_stop(&watcher);
+	log_frame_stats();
+	profiler_gpu_shutdown();
+	const gl_state_counters* counters = gl_state_get_counters();
+	gl_log("state cache: %llu calls issued, %llu skipped\n", counters->issued, counters->skipped);
 	glfwTerminate();
+#endif
 	return 0;
 }
\ No newline at end of file
@@ -1,95 +1,7 @@
 #include "maths_funcs.h"
-#include <stdio.h>
-#define _USE_MATH_DEFINES
+#include "maths_simd.h"
 #include <math.h>
-
-/*--------------------------------CONSTRUCTORS--------------------------------*/
-vec2::vec2() {}
-
-vec2::vec2( float x, float y ) {
-  v[0] = x;
-  v[1] = y;
-}
-
-vec3::vec3() {}
-
-vec3::vec3( float x, float y, float z ) {
-  v[0] = x;
-  v[1] = y;
-  v[2] = z;
-}
-
-vec3::vec3( const vec2& vv, float z ) {
-  v[0] = vv.v[0];
-  v[1] = vv.v[1];
-  v[2] = z;
-}
-
-vec3::vec3( const vec4& vv ) {
-  v[0] = vv.v[0];
-  v[1] = vv.v[1];
-  v[2] = vv.v[2];
-}
-
-vec4::vec4() {}
-
-vec4::vec4( float x, float y, float z, float w ) {
-  v[0] = x;
-  v[1] = y;
-  v[2] = z;
-  v[3] = w;
-}
-
-vec4::vec4( const vec2& vv, float z, float w ) {
-  v[0] = vv.v[0];
-  v[1] = vv.v[1];
-  v[2] = z;
-  v[3] = w;
-}
-
-vec4::vec4( const vec3& vv, float w ) {
-  v[0] = vv.v[0];
-  v[1] = vv.v[1];
-  v[2] = vv.v[2];
-  v[3] = w;
-}
-
-mat3::mat3() {}
-
-/* note: entered in COLUMNS */
-mat3::mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i ) {
-  m[0] = a;
-  m[1] = b;
-  m[2] = c;
-  m[3] = d;
-  m[4] = e;
-  m[5] = f;
-  m[6] = g;
-  m[7] = h;
-  m[8] = i;
-}
-
-mat4::mat4() {}
-
-/* note: entered in COLUMNS */
-mat4::mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p ) {
-  m[0]  = a;
-  m[1]  = b;
-  m[2]  = c;
-  m[3]  = d;
-  m[4]  = e;
-  m[5]  = f;
-  m[6]  = g;
-  m[7]  = h;
-  m[8]  = i;
-  m[9]  = j;
-  m[10] = k;
-  m[11] = l;
-  m[12] = mm;
-  m[13] = n;
-  m[14] = o;
-  m[15] = p;
-}
+#include <stdio.h>
 
 /*-----------------------------PRINT FUNCTIONS--------------------------------*/
 void print( const vec2& v ) { printf( "[%.2f, %.2f]\n", v.v[0], v.v[1] ); }
@@ -114,118 +26,10 @@ void print( const mat4& m ) {
 }
 
 /*------------------------------VECTOR FUNCTIONS------------------------------*/
-float length( const vec3& v ) { return sqrt( v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2] ); }
-
-// squared length
-float length2( const vec3& v ) { return v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]; }
-
-// note: proper spelling (hehe)
-vec3 normalise( const vec3& v ) {
-  vec3 vb;
-  float l = length( v );
-  if ( 0.0f == l ) { return vec3( 0.0f, 0.0f, 0.0f ); }
-  vb.v[0] = v.v[0] / l;
-  vb.v[1] = v.v[1] / l;
-  vb.v[2] = v.v[2] / l;
-  return vb;
-}
-
-vec3 vec3::operator+( const vec3& rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] + rhs.v[0];
-  vc.v[1] = v[1] + rhs.v[1];
-  vc.v[2] = v[2] + rhs.v[2];
-  return vc;
-}
-
-vec3& vec3::operator+=( const vec3& rhs ) {
-  v[0] += rhs.v[0];
-  v[1] += rhs.v[1];
-  v[2] += rhs.v[2];
-  return *this; // return self
-}
-
-vec3 vec3::operator-( const vec3& rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] - rhs.v[0];
-  vc.v[1] = v[1] - rhs.v[1];
-  vc.v[2] = v[2] - rhs.v[2];
-  return vc;
-}
-
-vec3& vec3::operator-=( const vec3& rhs ) {
-  v[0] -= rhs.v[0];
-  v[1] -= rhs.v[1];
-  v[2] -= rhs.v[2];
-  return *this;
-}
-
-vec3 vec3::operator+( float rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] + rhs;
-  vc.v[1] = v[1] + rhs;
-  vc.v[2] = v[2] + rhs;
-  return vc;
-}
-
-vec3 vec3::operator-( float rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] - rhs;
-  vc.v[1] = v[1] - rhs;
-  vc.v[2] = v[2] - rhs;
-  return vc;
-}
-
-vec3 vec3::operator*( float rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] * rhs;
-  vc.v[1] = v[1] * rhs;
-  vc.v[2] = v[2] * rhs;
-  return vc;
-}
-
-vec3 vec3::operator/( float rhs ) {
-  vec3 vc;
-  vc.v[0] = v[0] / rhs;
-  vc.v[1] = v[1] / rhs;
-  vc.v[2] = v[2] / rhs;
-  return vc;
-}
-
-vec3& vec3::operator*=( float rhs ) {
-  v[0] = v[0] * rhs;
-  v[1] = v[1] * rhs;
-  v[2] = v[2] * rhs;
-  return *this;
-}
-
-vec3& vec3::operator=( const vec3& rhs ) {
-  v[0] = rhs.v[0];
-  v[1] = rhs.v[1];
-  v[2] = rhs.v[2];
-  return *this;
-}
-
-float dot( const vec3& a, const vec3& b ) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
-
-vec3 cross( const vec3& a, const vec3& b ) {
-  float x = a.v[1] * b.v[2] - a.v[2] * b.v[1];
-  float y = a.v[2] * b.v[0] - a.v[0] * b.v[2];
-  float z = a.v[0] * b.v[1] - a.v[1] * b.v[0];
-  return vec3( x, y, z );
-}
-
-float get_squared_dist( vec3 from, vec3 to ) {
-  float x = ( to.v[0] - from.v[0] ) * ( to.v[0] - from.v[0] );
-  float y = ( to.v[1] - from.v[1] ) * ( to.v[1] - from.v[1] );
-  float z = ( to.v[2] - from.v[2] ) * ( to.v[2] - from.v[2] );
-  return x + y + z;
-}
-
 /* converts an un-normalised direction into a heading in degrees
 NB i suspect that the z is backwards here but i've used in in
 several places like this. d'oh! */
-float direction_to_heading( vec3 d ) { return atan2( -d.v[0], -d.v[2] ) * ONE_RAD_IN_DEG; }
+float direction_to_heading( const vec3& d ) { return atan2( -d.v[0], -d.v[2] ) * ONE_RAD_IN_DEG; }
 
 vec3 heading_to_direction( float degrees ) {
   float rad = degrees * ONE_DEG_IN_RAD;
@@ -233,14 +37,6 @@ vec3 heading_to_direction( float degrees ) {
 }
 
 /*-----------------------------MATRIX FUNCTIONS-------------------------------*/
-mat3 zero_mat3() { return mat3( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
-
-mat3 identity_mat3() { return mat3( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
-
-mat4 zero_mat4() { return mat4( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
-
-mat4 identity_mat4() { return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
-
 /* mat4 array layout
  0  4  8 12
  1  5  9 13
@@ -248,47 +44,135 @@ mat4 identity_mat4() { return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.
  3  7 11 15
 */
 
-vec4 mat4::operator*( const vec4& rhs ) {
+/* the multiply kernels work on raw column-major floats so the single-object
+operators and the batch functions below share them. out may alias either
+input. */
+static inline void mul_mat4_vec4( const float* m, const float* v, float* out ) {
+#ifdef MATHS_SIMD
+  // sum of the columns weighted by the vector's components
+  f4 r = f4_mul( f4_load( &m[0] ), f4_splat( v[0] ) );
+  r    = f4_madd( f4_load( &m[4] ), f4_splat( v[1] ), r );
+  r    = f4_madd( f4_load( &m[8] ), f4_splat( v[2] ), r );
+  r    = f4_madd( f4_load( &m[12] ), f4_splat( v[3] ), r );
+  f4_store( out, r );
+#else
   // 0x + 4y + 8z + 12w
-  float x = m[0] * rhs.v[0] + m[4] * rhs.v[1] + m[8] * rhs.v[2] + m[12] * rhs.v[3];
+  float x = m[0] * v[0] + m[4] * v[1] + m[8] * v[2] + m[12] * v[3];
   // 1x + 5y + 9z + 13w
-  float y = m[1] * rhs.v[0] + m[5] * rhs.v[1] + m[9] * rhs.v[2] + m[13] * rhs.v[3];
+  float y = m[1] * v[0] + m[5] * v[1] + m[9] * v[2] + m[13] * v[3];
   // 2x + 6y + 10z + 14w
-  float z = m[2] * rhs.v[0] + m[6] * rhs.v[1] + m[10] * rhs.v[2] + m[14] * rhs.v[3];
+  float z = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14] * v[3];
   // 3x + 7y + 11z + 15w
-  float w = m[3] * rhs.v[0] + m[7] * rhs.v[1] + m[11] * rhs.v[2] + m[15] * rhs.v[3];
-  return vec4( x, y, z, w );
-}
-
-mat4 mat4::operator*( const mat4& rhs ) {
-  mat4 r      = zero_mat4();
+  float w = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
+  out[0]  = x;
+  out[1]  = y;
+  out[2]  = z;
+  out[3]  = w;
+#endif
+}
+
+static inline void mul_mat4( const float* a, const float* b, float* out ) {
+#ifdef MATHS_SIMD
+  // each result column is a's columns weighted by one column of b
+  f4 c0 = f4_load( &a[0] );
+  f4 c1 = f4_load( &a[4] );
+  f4 c2 = f4_load( &a[8] );
+  f4 c3 = f4_load( &a[12] );
+  for ( int col = 0; col < 4; col++ ) {
+    const float* bc = &b[col * 4];
+    f4 sum          = f4_mul( c0, f4_splat( bc[0] ) );
+    sum             = f4_madd( c1, f4_splat( bc[1] ), sum );
+    sum             = f4_madd( c2, f4_splat( bc[2] ), sum );
+    sum             = f4_madd( c3, f4_splat( bc[3] ), sum );
+    f4_store( &out[col * 4], sum );
+  }
+#else
+  float r[16];
   int r_index = 0;
   for ( int col = 0; col < 4; col++ ) {
     for ( int row = 0; row < 4; row++ ) {
       float sum = 0.0f;
-      for ( int i = 0; i < 4; i++ ) { sum += rhs.m[i + col * 4] * m[row + i * 4]; }
-      r.m[r_index] = sum;
+      for ( int i = 0; i < 4; i++ ) { sum += b[i + col * 4] * a[row + i * 4]; }
+      r[r_index] = sum;
       r_index++;
     }
   }
+  for ( int i = 0; i < 16; i++ ) { out[i] = r[i]; }
+#endif
+}
+
+vec4 mat4::operator*( const vec4& rhs ) const {
+  vec4 r;
+  mul_mat4_vec4( m, rhs.v, r.v );
   return r;
 }
 
-mat4& mat4::operator=( const mat4& rhs ) {
-  for ( int i = 0; i < 16; i++ ) { m[i] = rhs.m[i]; }
-  return *this;
+mat4 mat4::operator*( const mat4& rhs ) const {
+  mat4 r;
+  mul_mat4( m, rhs.m, r.m );
+  return r;
 }
 
+#ifdef MATHS_SIMD
+/* signed cofactors of mm, laid out as the columns of the adjugate. the 2x2
+sub-determinants are shared between columns so this does 6 vector
+multiply-subtracts for them instead of the 96 scalar products in the long-hand
+versions below. the inverse is this divided by the determinant. */
+static void cofactors( const mat4& mm, f4 inv[4] ) {
+  const float* m = mm.m;
+  // a_r = ( m[2][r], m[2][r], m[1][r], m[1][r] ) and b_r = ( m[3][r], m[3][r], m[3][r], m[2][r] )
+  f4 a0 = f4_set( m[8], m[8], m[4], m[4] );
+  f4 a1 = f4_set( m[9], m[9], m[5], m[5] );
+  f4 a2 = f4_set( m[10], m[10], m[6], m[6] );
+  f4 a3 = f4_set( m[11], m[11], m[7], m[7] );
+  f4 b0 = f4_set( m[12], m[12], m[12], m[8] );
+  f4 b1 = f4_set( m[13], m[13], m[13], m[9] );
+  f4 b2 = f4_set( m[14], m[14], m[14], m[10] );
+  f4 b3 = f4_set( m[15], m[15], m[15], m[11] );
+
+  // 2x2 sub-determinants
+  f4 fac0 = f4_sub( f4_mul( a2, b3 ), f4_mul( b2, a3 ) );
+  f4 fac1 = f4_sub( f4_mul( a1, b3 ), f4_mul( b1, a3 ) );
+  f4 fac2 = f4_sub( f4_mul( a1, b2 ), f4_mul( b1, a2 ) );
+  f4 fac3 = f4_sub( f4_mul( a0, b3 ), f4_mul( b0, a3 ) );
+  f4 fac4 = f4_sub( f4_mul( a0, b2 ), f4_mul( b0, a2 ) );
+  f4 fac5 = f4_sub( f4_mul( a0, b1 ), f4_mul( b0, a1 ) );
+
+  f4 v0 = f4_set( m[4], m[0], m[0], m[0] );
+  f4 v1 = f4_set( m[5], m[1], m[1], m[1] );
+  f4 v2 = f4_set( m[6], m[2], m[2], m[2] );
+  f4 v3 = f4_set( m[7], m[3], m[3], m[3] );
+
+  f4 sign_a = f4_set( 1.0f, -1.0f, 1.0f, -1.0f );
+  f4 sign_b = f4_set( -1.0f, 1.0f, -1.0f, 1.0f );
+  inv[0]    = f4_mul( f4_add( f4_sub( f4_mul( v1, fac0 ), f4_mul( v2, fac1 ) ), f4_mul( v3, fac2 ) ), sign_a );
+  inv[1]    = f4_mul( f4_add( f4_sub( f4_mul( v0, fac0 ), f4_mul( v2, fac3 ) ), f4_mul( v3, fac4 ) ), sign_b );
+  inv[2]    = f4_mul( f4_add( f4_sub( f4_mul( v0, fac1 ), f4_mul( v1, fac3 ) ), f4_mul( v3, fac5 ) ), sign_a );
+  inv[3]    = f4_mul( f4_add( f4_sub( f4_mul( v0, fac2 ), f4_mul( v1, fac4 ) ), f4_mul( v2, fac5 ) ), sign_b );
+}
+
+// expand along the first column: det = sum of m[0][r] * cofactor[r][0]
+static float det_from_cofactors( const mat4& mm, const float* adj ) { return mm.m[0] * adj[0] + mm.m[1] * adj[4] + mm.m[2] * adj[8] + mm.m[3] * adj[12]; }
+#endif
+
 // returns a scalar value with the determinant for a 4x4 matrix
 // see
 // http://www.euclideanspace.com/maths/algebra/matrix/functions/determinant/fourD/index.htm
 float determinant( const mat4& mm ) {
+#ifdef MATHS_SIMD
+  f4 inv[4];
+  cofactors( mm, inv );
+  float adj[16];
+  for ( int i = 0; i < 4; i++ ) { f4_store( &adj[i * 4], inv[i] ); }
+  return det_from_cofactors( mm, adj );
+#else
   return mm.m[12] * mm.m[9] * mm.m[6] * mm.m[3] - mm.m[8] * mm.m[13] * mm.m[6] * mm.m[3] - mm.m[12] * mm.m[5] * mm.m[10] * mm.m[3] + mm.m[4] * mm.m[13] * mm.m[10] * mm.m[3] +
          mm.m[8] * mm.m[5] * mm.m[14] * mm.m[3] - mm.m[4] * mm.m[9] * mm.m[14] * mm.m[3] - mm.m[12] * mm.m[9] * mm.m[2] * mm.m[7] + mm.m[8] * mm.m[13] * mm.m[2] * mm.m[7] +
          mm.m[12] * mm.m[1] * mm.m[10] * mm.m[7] - mm.m[0] * mm.m[13] * mm.m[10] * mm.m[7] - mm.m[8] * mm.m[1] * mm.m[14] * mm.m[7] + mm.m[0] * mm.m[9] * mm.m[14] * mm.m[7] +
          mm.m[12] * mm.m[5] * mm.m[2] * mm.m[11] - mm.m[4] * mm.m[13] * mm.m[2] * mm.m[11] - mm.m[12] * mm.m[1] * mm.m[6] * mm.m[11] + mm.m[0] * mm.m[13] * mm.m[6] * mm.m[11] +
          mm.m[4] * mm.m[1] * mm.m[14] * mm.m[11] - mm.m[0] * mm.m[5] * mm.m[14] * mm.m[11] - mm.m[8] * mm.m[5] * mm.m[2] * mm.m[15] + mm.m[4] * mm.m[9] * mm.m[2] * mm.m[15] +
          mm.m[8] * mm.m[1] * mm.m[6] * mm.m[15] - mm.m[0] * mm.m[9] * mm.m[6] * mm.m[15] - mm.m[4] * mm.m[1] * mm.m[10] * mm.m[15] + mm.m[0] * mm.m[5] * mm.m[10] * mm.m[15];
+#endif
 }
 
 /* returns a 16-element array that is the inverse of a 16-element array (4x4
@@ -296,6 +180,20 @@ matrix). see
 http://www.euclideanspace.com/maths/algebra/matrix/functions/inverse/fourD/index.htm
 */
 mat4 inverse( const mat4& mm ) {
+#ifdef MATHS_SIMD
+  f4 inv[4];
+  cofactors( mm, inv );
+  mat4 r;
+  for ( int i = 0; i < 4; i++ ) { f4_store( &r.m[i * 4], inv[i] ); }
+  float det = det_from_cofactors( mm, r.m );
+  if ( 0.0f == det ) {
+    fprintf( stderr, "WARNING. matrix has no determinant. can not invert\n" );
+    return mm;
+  }
+  f4 inv_det = f4_splat( 1.0f / det );
+  for ( int i = 0; i < 4; i++ ) { f4_store( &r.m[i * 4], f4_mul( inv[i], inv_det ) ); }
+  return r;
+#else
   float det = determinant( mm );
   /* there is no inverse if determinant is zero (not likely unless scale is
   broken) */
@@ -322,71 +220,23 @@ mat4 inverse( const mat4& mm ) {
     inv_det * ( mm.m[8] * mm.m[13] * mm.m[2] - mm.m[12] * mm.m[9] * mm.m[2] + mm.m[12] * mm.m[1] * mm.m[10] - mm.m[0] * mm.m[13] * mm.m[10] - mm.m[8] * mm.m[1] * mm.m[14] + mm.m[0] * mm.m[9] * mm.m[14] ),
     inv_det * ( mm.m[12] * mm.m[5] * mm.m[2] - mm.m[4] * mm.m[13] * mm.m[2] - mm.m[12] * mm.m[1] * mm.m[6] + mm.m[0] * mm.m[13] * mm.m[6] + mm.m[4] * mm.m[1] * mm.m[14] - mm.m[0] * mm.m[5] * mm.m[14] ),
     inv_det * ( mm.m[4] * mm.m[9] * mm.m[2] - mm.m[8] * mm.m[5] * mm.m[2] + mm.m[8] * mm.m[1] * mm.m[6] - mm.m[0] * mm.m[9] * mm.m[6] - mm.m[4] * mm.m[1] * mm.m[10] + mm.m[0] * mm.m[5] * mm.m[10] ) );
+#endif
 }
 
 // returns a 16-element array flipped on the main diagonal
 mat4 transpose( const mat4& mm ) {
+#ifdef MATHS_SIMD
+  mat4 r;
+  f4_transpose( mm.m, r.m );
+  return r;
+#else
   return mat4( mm.m[0], mm.m[4], mm.m[8], mm.m[12], mm.m[1], mm.m[5], mm.m[9], mm.m[13], mm.m[2], mm.m[6], mm.m[10], mm.m[14], mm.m[3], mm.m[7], mm.m[11], mm.m[15] );
-}
-
-/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
-// translate a 4d matrix with xyz array
-mat4 translate( const mat4& m, const vec3& v ) {
-  mat4 m_t  = identity_mat4();
-  m_t.m[12] = v.v[0];
-  m_t.m[13] = v.v[1];
-  m_t.m[14] = v.v[2];
-  return m_t * m;
-}
-
-// rotate around x axis by an angle in degrees
-mat4 rotate_x_deg( const mat4& m, float deg ) {
-  // convert to radians
-  float rad = deg * ONE_DEG_IN_RAD;
-  mat4 m_r  = identity_mat4();
-  m_r.m[5]  = cos( rad );
-  m_r.m[9]  = -sin( rad );
-  m_r.m[6]  = sin( rad );
-  m_r.m[10] = cos( rad );
-  return m_r * m;
-}
-
-// rotate around y axis by an angle in degrees
-mat4 rotate_y_deg( const mat4& m, float deg ) {
-  // convert to radians
-  float rad = deg * ONE_DEG_IN_RAD;
-  mat4 m_r  = identity_mat4();
-  m_r.m[0]  = cos( rad );
-  m_r.m[8]  = sin( rad );
-  m_r.m[2]  = -sin( rad );
-  m_r.m[10] = cos( rad );
-  return m_r * m;
-}
-
-// rotate around z axis by an angle in degrees
-mat4 rotate_z_deg( const mat4& m, float deg ) {
-  // convert to radians
-  float rad = deg * ONE_DEG_IN_RAD;
-  mat4 m_r  = identity_mat4();
-  m_r.m[0]  = cos( rad );
-  m_r.m[4]  = -sin( rad );
-  m_r.m[1]  = sin( rad );
-  m_r.m[5]  = cos( rad );
-  return m_r * m;
-}
-
-// scale a matrix by [x, y, z]
-mat4 scale( const mat4& m, const vec3& v ) {
-  mat4 a  = identity_mat4();
-  a.m[0]  = v.v[0];
-  a.m[5]  = v.v[1];
-  a.m[10] = v.v[2];
-  return a * m;
+#endif
 }
 
 /*-----------------------VIRTUAL CAMERA MATRIX FUNCTIONS----------------------*/
 // returns a view matrix using the opengl lookAt style. COLUMN ORDER.
-mat4 look_at( const vec3& cam_pos, vec3 targ_pos, const vec3& up ) {
+mat4 look_at( const vec3& cam_pos, const vec3& targ_pos, const vec3& up ) {
   // inverse translation
   mat4 p = identity_mat4();
   p      = translate( p, vec3( -cam_pos.v[0], -cam_pos.v[1], -cam_pos.v[2] ) );
@@ -412,23 +262,55 @@ mat4 look_at( const vec3& cam_pos, vec3 targ_pos, const vec3& up ) {
   return ori * p; // p * ori;
 }
 
-// returns a perspective function mimicking the opengl projection style.
-mat4 perspective( float fovy, float aspect, float near, float far ) {
-  float fov_rad       = fovy * ONE_DEG_IN_RAD;
-  float inverse_range = 1.0f / tan( fov_rad / 2.0f );
-  float sx            = inverse_range / aspect;
-  float sy            = inverse_range;
-  float sz            = -( far + near ) / ( far - near );
-  float pz            = -( 2.0f * far * near ) / ( far - near );
-  mat4 m              = zero_mat4(); // make sure bottom-right corner is zero
-  m.m[0]              = sx;
-  m.m[5]              = sy;
-  m.m[10]             = sz;
-  m.m[14]             = pz;
-  m.m[11]             = -1.0f;
-  return m;
+/*------------------------------BATCH FUNCTIONS-------------------------------*/
+void mat4_mul_batch( const mat4* a, const mat4* b, mat4* out, size_t n ) {
+  for ( size_t i = 0; i < n; i++ ) { mul_mat4( a[i].m, b[i].m, out[i].m ); }
 }
 
+void mat4_mul_batch( const mat4& a, const mat4* b, mat4* out, size_t n ) {
+  // copy first so out may alias &a
+  mat4 lhs = a;
+  for ( size_t i = 0; i < n; i++ ) { mul_mat4( lhs.m, b[i].m, out[i].m ); }
+}
+
+void transform_vec4s( const mat4& m, const vec4* in, vec4* out, size_t n ) {
+  for ( size_t i = 0; i < n; i++ ) { mul_mat4_vec4( m.m, in[i].v, out[i].v ); }
+}
+
+/* points get w = 1 so they pick up the translation, directions get w = 0.
+neither divides by w, so use transform_vec4s() for projections. */
+static void transform_vec3s( const mat4& m, const vec3* in, vec3* out, size_t n, float w ) {
+  size_t i = 0;
+#ifdef MATHS_SIMD
+  /* 4 vec3s at a time in structure-of-arrays form - x' = m0 x + m4 y + m8 z + m12 w
+  for all 4 xs at once etc. so no lanes are wasted on the missing 4th component */
+  f4 m0 = f4_splat( m.m[0] ), m1 = f4_splat( m.m[1] ), m2 = f4_splat( m.m[2] );
+  f4 m4 = f4_splat( m.m[4] ), m5 = f4_splat( m.m[5] ), m6 = f4_splat( m.m[6] );
+  f4 m8 = f4_splat( m.m[8] ), m9 = f4_splat( m.m[9] ), m10 = f4_splat( m.m[10] );
+  f4 tx = f4_splat( m.m[12] * w ), ty = f4_splat( m.m[13] * w ), tz = f4_splat( m.m[14] * w );
+  for ( ; i + 4 <= n; i += 4 ) {
+    f4 x, y, z;
+    f4_load_xyz4( in[i].v, x, y, z );
+    f4 rx = f4_add( f4_madd( m8, z, f4_madd( m4, y, f4_mul( m0, x ) ) ), tx );
+    f4 ry = f4_add( f4_madd( m9, z, f4_madd( m5, y, f4_mul( m1, x ) ) ), ty );
+    f4 rz = f4_add( f4_madd( m10, z, f4_madd( m6, y, f4_mul( m2, x ) ) ), tz );
+    f4_store_xyz4( out[i].v, rx, ry, rz );
+  }
+#endif
+  for ( ; i < n; i++ ) {
+    float v[4] = { in[i].v[0], in[i].v[1], in[i].v[2], w };
+    float r[4];
+    mul_mat4_vec4( m.m, v, r );
+    out[i].v[0] = r[0];
+    out[i].v[1] = r[1];
+    out[i].v[2] = r[2];
+  }
+}
+
+void transform_points( const mat4& m, const vec3* in, vec3* out, size_t n ) { transform_vec3s( m, in, out, n, 1.0f ); }
+
+void transform_directions( const mat4& m, const vec3* in, vec3* out, size_t n ) { transform_vec3s( m, in, out, n, 0.0f ); }
+
 /*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
 versor::versor() {}
 
@@ -488,8 +370,23 @@ mat4 quat_to_mat4( const versor& q ) {
   float x = q.q[1];
   float y = q.q[2];
   float z = q.q[3];
+#ifdef MATHS_SIMD
+  /* each column is a unit axis plus twice a sum of two component products, e.g.
+  column 0 = ( 1, 0, 0 ) + 2 * ( -yy - zz, xy + wz, xz - wy ) */
+  f4 two = f4_splat( 2.0f );
+  f4 c0  = f4_add( f4_mul( f4_set( -y, x, x, 0.0f ), f4_set( y, y, z, 0.0f ) ), f4_mul( f4_set( -z, w, -w, 0.0f ), f4_set( z, z, y, 0.0f ) ) );
+  f4 c1  = f4_add( f4_mul( f4_set( x, -x, y, 0.0f ), f4_set( y, x, z, 0.0f ) ), f4_mul( f4_set( -w, -z, w, 0.0f ), f4_set( z, z, x, 0.0f ) ) );
+  f4 c2  = f4_add( f4_mul( f4_set( x, y, -x, 0.0f ), f4_set( z, z, x, 0.0f ) ), f4_mul( f4_set( w, -w, -y, 0.0f ), f4_set( y, x, y, 0.0f ) ) );
+  mat4 r;
+  f4_store( &r.m[0], f4_madd( c0, two, f4_set( 1.0f, 0.0f, 0.0f, 0.0f ) ) );
+  f4_store( &r.m[4], f4_madd( c1, two, f4_set( 0.0f, 1.0f, 0.0f, 0.0f ) ) );
+  f4_store( &r.m[8], f4_madd( c2, two, f4_set( 0.0f, 0.0f, 1.0f, 0.0f ) ) );
+  f4_store( &r.m[12], f4_set( 0.0f, 0.0f, 0.0f, 1.0f ) );
+  return r;
+#else
   return mat4( 1.0f - 2.0f * y * y - 2.0f * z * z, 2.0f * x * y + 2.0f * w * z, 2.0f * x * z - 2.0f * w * y, 0.0f, 2.0f * x * y - 2.0f * w * z, 1.0f - 2.0f * x * x - 2.0f * z * z,
     2.0f * y * z + 2.0f * w * x, 0.0f, 2.0f * x * z + 2.0f * w * y, 2.0f * y * z - 2.0f * w * x, 1.0f - 2.0f * x * x - 2.0f * y * y, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f );
+#endif
 }
 
 versor normalise( versor& q ) {
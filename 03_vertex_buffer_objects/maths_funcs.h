@@ -1,5 +1,18 @@
 #pragma once
 
+/* the small, hot functions (constructors, vec3 operators, dot, cross,
+identity/zero, the affine builders, perspective) are defined inline at the
+bottom of this file so they can be inlined into callers without LTO. the ones
+marked constexpr fold to constants when given constant arguments, e.g.
+  constexpr mat4 m = translate( identity_mat4(), vec3( 1.0f, 0.0f, 0.0f ) );
+the larger functions (inverse, quaternions, batches) live in maths_funcs.cpp */
+
+#include <stddef.h>
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
 #define TAU 2.0 * M_PI
 #define ONE_DEG_IN_RAD ( 2.0 * M_PI ) / 360.0 // 0.017444444
 #define ONE_RAD_IN_DEG 360.0 / ( 2.0 * M_PI ) // 57.2957795
@@ -10,49 +23,47 @@ struct vec4;
 struct versor;
 
 struct vec2 {
-  vec2();
-  vec2( float x, float y );
+  vec2() = default;
+  constexpr vec2( float x, float y );
   float v[2];
 };
 
 struct vec3 {
-  vec3();
+  vec3() = default;
   // create from 3 scalars
-  vec3( float x, float y, float z );
+  constexpr vec3( float x, float y, float z );
   // create from vec2 and a scalar
-  vec3( const vec2& vv, float z );
+  constexpr vec3( const vec2& vv, float z );
   // create from truncated vec4
-  vec3( const vec4& vv );
+  constexpr vec3( const vec4& vv );
   // add vector to vector
-  vec3 operator+( const vec3& rhs );
+  constexpr vec3 operator+( const vec3& rhs ) const;
   // add scalar to vector
-  vec3 operator+( float rhs );
+  constexpr vec3 operator+( float rhs ) const;
   // because user's expect this too
-  vec3& operator+=( const vec3& rhs );
+  constexpr vec3& operator+=( const vec3& rhs );
   // subtract vector from vector
-  vec3 operator-( const vec3& rhs );
+  constexpr vec3 operator-( const vec3& rhs ) const;
   // add vector to vector
-  vec3 operator-( float rhs );
+  constexpr vec3 operator-( float rhs ) const;
   // because users expect this too
-  vec3& operator-=( const vec3& rhs );
+  constexpr vec3& operator-=( const vec3& rhs );
   // multiply with scalar
-  vec3 operator*( float rhs );
+  constexpr vec3 operator*( float rhs ) const;
   // because users expect this too
-  vec3& operator*=( float rhs );
+  constexpr vec3& operator*=( float rhs );
   // divide vector by scalar
-  vec3 operator/( float rhs );
-  // because users expect this too
-  vec3& operator=( const vec3& rhs );
+  constexpr vec3 operator/( float rhs ) const;
 
   // internal data
   float v[3];
 };
 
 struct vec4 {
-  vec4();
-  vec4( float x, float y, float z, float w );
-  vec4( const vec2& vv, float z, float w );
-  vec4( const vec3& vv, float w );
+  vec4() = default;
+  constexpr vec4( float x, float y, float z, float w );
+  constexpr vec4( const vec2& vv, float z, float w );
+  constexpr vec4( const vec3& vv, float w );
   float v[4];
 };
 
@@ -61,8 +72,8 @@ a d g
 b e h
 c f i */
 struct mat3 {
-  mat3();
-  mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i );
+  mat3() = default;
+  constexpr mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i );
   float m[9];
 };
 
@@ -72,12 +83,11 @@ struct mat3 {
 2 6 10 14
 3 7 11 15*/
 struct mat4 {
-  mat4();
+  mat4() = default;
   // note! this is entering components in ROW-major order
-  mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p );
-  vec4 operator*( const vec4& rhs );
-  mat4 operator*( const mat4& rhs );
-  mat4& operator=( const mat4& rhs );
+  constexpr mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p );
+  vec4 operator*( const vec4& rhs ) const;
+  mat4 operator*( const mat4& rhs ) const;
   float m[16];
 };
 
@@ -96,31 +106,41 @@ void print( const vec4& v );
 void print( const mat3& m );
 void print( const mat4& m );
 // vector functions
-float length( const vec3& v );
-float length2( const vec3& v );
-vec3 normalise( const vec3& v );
-float dot( const vec3& a, const vec3& b );
-vec3 cross( const vec3& a, const vec3& b );
-float get_squared_dist( vec3 from, vec3 to );
-float direction_to_heading( vec3 d );
+inline float length( const vec3& v );
+constexpr float length2( const vec3& v );
+inline vec3 normalise( const vec3& v );
+constexpr float dot( const vec3& a, const vec3& b );
+constexpr vec3 cross( const vec3& a, const vec3& b );
+constexpr float get_squared_dist( const vec3& from, const vec3& to );
+float direction_to_heading( const vec3& d );
 vec3 heading_to_direction( float degrees );
 // matrix functions
-mat3 zero_mat3();
-mat3 identity_mat3();
-mat4 zero_mat4();
-mat4 identity_mat4();
+constexpr mat3 zero_mat3();
+constexpr mat3 identity_mat3();
+constexpr mat4 zero_mat4();
+constexpr mat4 identity_mat4();
 float determinant( const mat4& mm );
 mat4 inverse( const mat4& mm );
 mat4 transpose( const mat4& mm );
 // affine functions
-mat4 translate( const mat4& m, const vec3& v );
-mat4 rotate_x_deg( const mat4& m, float deg );
-mat4 rotate_y_deg( const mat4& m, float deg );
-mat4 rotate_z_deg( const mat4& m, float deg );
-mat4 scale( const mat4& m, const vec3& v );
+constexpr mat4 translate( const mat4& m, const vec3& v );
+inline mat4 rotate_x_deg( const mat4& m, float deg );
+inline mat4 rotate_y_deg( const mat4& m, float deg );
+inline mat4 rotate_z_deg( const mat4& m, float deg );
+constexpr mat4 scale( const mat4& m, const vec3& v );
 // camera functions
-mat4 look_at( const vec3& cam_pos, vec3 targ_pos, const vec3& up );
-mat4 perspective( float fovy, float aspect, float near, float far );
+mat4 look_at( const vec3& cam_pos, const vec3& targ_pos, const vec3& up );
+inline mat4 perspective( float fovy, float aspect, float near, float far );
+// batch functions - one call for a whole array. outputs may alias inputs
+// out[i] = a[i] * b[i]
+void mat4_mul_batch( const mat4* a, const mat4* b, mat4* out, size_t n );
+// out[i] = a * b[i] e.g. view-projection * model
+void mat4_mul_batch( const mat4& a, const mat4* b, mat4* out, size_t n );
+void transform_vec4s( const mat4& m, const vec4* in, vec4* out, size_t n );
+// transform as ( x, y, z, 1 ), no divide by w
+void transform_points( const mat4& m, const vec3* in, vec3* out, size_t n );
+// transform as ( x, y, z, 0 ) - ignores translation
+void transform_directions( const mat4& m, const vec3* in, vec3* out, size_t n );
 // quaternion functions
 versor quat_from_axis_rad( float radians, float x, float y, float z );
 versor quat_from_axis_deg( float degrees, float x, float y, float z );
@@ -131,3 +151,170 @@ versor slerp( const versor& q, const versor& r );
 versor normalise( versor& q );
 void print( const versor& q );
 versor slerp( versor& q, versor& r, float t );
+
+/*--------------------------------CONSTRUCTORS--------------------------------*/
+constexpr vec2::vec2( float x, float y ) : v{ x, y } {}
+
+constexpr vec3::vec3( float x, float y, float z ) : v{ x, y, z } {}
+
+constexpr vec3::vec3( const vec2& vv, float z ) : v{ vv.v[0], vv.v[1], z } {}
+
+constexpr vec3::vec3( const vec4& vv ) : v{ vv.v[0], vv.v[1], vv.v[2] } {}
+
+constexpr vec4::vec4( float x, float y, float z, float w ) : v{ x, y, z, w } {}
+
+constexpr vec4::vec4( const vec2& vv, float z, float w ) : v{ vv.v[0], vv.v[1], z, w } {}
+
+constexpr vec4::vec4( const vec3& vv, float w ) : v{ vv.v[0], vv.v[1], vv.v[2], w } {}
+
+/* note: entered in COLUMNS */
+constexpr mat3::mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i ) : m{ a, b, c, d, e, f, g, h, i } {}
+
+/* note: entered in COLUMNS */
+constexpr mat4::mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p )
+  : m{ a, b, c, d, e, f, g, h, i, j, k, l, mm, n, o, p } {}
+
+/*------------------------------VECTOR FUNCTIONS------------------------------*/
+inline float length( const vec3& v ) { return sqrtf( v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2] ); }
+
+// squared length
+constexpr float length2( const vec3& v ) { return v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]; }
+
+// note: proper spelling (hehe)
+inline vec3 normalise( const vec3& v ) {
+  float l = length( v );
+  if ( 0.0f == l ) { return vec3( 0.0f, 0.0f, 0.0f ); }
+  return vec3( v.v[0] / l, v.v[1] / l, v.v[2] / l );
+}
+
+constexpr vec3 vec3::operator+( const vec3& rhs ) const { return vec3( v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2] ); }
+
+constexpr vec3& vec3::operator+=( const vec3& rhs ) {
+  v[0] += rhs.v[0];
+  v[1] += rhs.v[1];
+  v[2] += rhs.v[2];
+  return *this; // return self
+}
+
+constexpr vec3 vec3::operator-( const vec3& rhs ) const { return vec3( v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2] ); }
+
+constexpr vec3& vec3::operator-=( const vec3& rhs ) {
+  v[0] -= rhs.v[0];
+  v[1] -= rhs.v[1];
+  v[2] -= rhs.v[2];
+  return *this;
+}
+
+constexpr vec3 vec3::operator+( float rhs ) const { return vec3( v[0] + rhs, v[1] + rhs, v[2] + rhs ); }
+
+constexpr vec3 vec3::operator-( float rhs ) const { return vec3( v[0] - rhs, v[1] - rhs, v[2] - rhs ); }
+
+constexpr vec3 vec3::operator*( float rhs ) const { return vec3( v[0] * rhs, v[1] * rhs, v[2] * rhs ); }
+
+constexpr vec3 vec3::operator/( float rhs ) const { return vec3( v[0] / rhs, v[1] / rhs, v[2] / rhs ); }
+
+constexpr vec3& vec3::operator*=( float rhs ) {
+  v[0] = v[0] * rhs;
+  v[1] = v[1] * rhs;
+  v[2] = v[2] * rhs;
+  return *this;
+}
+
+constexpr float dot( const vec3& a, const vec3& b ) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+
+constexpr vec3 cross( const vec3& a, const vec3& b ) {
+  return vec3( a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0] );
+}
+
+constexpr float get_squared_dist( const vec3& from, const vec3& to ) {
+  return ( to.v[0] - from.v[0] ) * ( to.v[0] - from.v[0] ) + ( to.v[1] - from.v[1] ) * ( to.v[1] - from.v[1] ) + ( to.v[2] - from.v[2] ) * ( to.v[2] - from.v[2] );
+}
+
+/*-----------------------------MATRIX FUNCTIONS-------------------------------*/
+constexpr mat3 zero_mat3() { return mat3( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
+
+constexpr mat3 identity_mat3() { return mat3( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
+
+constexpr mat4 zero_mat4() { return mat4( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
+
+constexpr mat4 identity_mat4() { return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
+
+/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
+/* these return T * m, R * m or S * m without building the full matrix and
+multiplying - only the rows that actually change are touched */
+
+// translate a 4d matrix with xyz array
+constexpr mat4 translate( const mat4& m, const vec3& v ) {
+  mat4 r = m;
+  for ( int col = 0; col < 4; col++ ) {
+    r.m[col * 4 + 0] += v.v[0] * m.m[col * 4 + 3];
+    r.m[col * 4 + 1] += v.v[1] * m.m[col * 4 + 3];
+    r.m[col * 4 + 2] += v.v[2] * m.m[col * 4 + 3];
+  }
+  return r;
+}
+
+// rotate around x axis by an angle in degrees
+inline mat4 rotate_x_deg( const mat4& m, float deg ) {
+  // convert to radians
+  float rad = deg * ONE_DEG_IN_RAD;
+  float c   = cos( rad );
+  float s   = sin( rad );
+  mat4 r    = m;
+  for ( int col = 0; col < 4; col++ ) {
+    r.m[col * 4 + 1] = c * m.m[col * 4 + 1] - s * m.m[col * 4 + 2];
+    r.m[col * 4 + 2] = s * m.m[col * 4 + 1] + c * m.m[col * 4 + 2];
+  }
+  return r;
+}
+
+// rotate around y axis by an angle in degrees
+inline mat4 rotate_y_deg( const mat4& m, float deg ) {
+  // convert to radians
+  float rad = deg * ONE_DEG_IN_RAD;
+  float c   = cos( rad );
+  float s   = sin( rad );
+  mat4 r    = m;
+  for ( int col = 0; col < 4; col++ ) {
+    r.m[col * 4 + 0] = c * m.m[col * 4 + 0] + s * m.m[col * 4 + 2];
+    r.m[col * 4 + 2] = -s * m.m[col * 4 + 0] + c * m.m[col * 4 + 2];
+  }
+  return r;
+}
+
+// rotate around z axis by an angle in degrees
+inline mat4 rotate_z_deg( const mat4& m, float deg ) {
+  // convert to radians
+  float rad = deg * ONE_DEG_IN_RAD;
+  float c   = cos( rad );
+  float s   = sin( rad );
+  mat4 r    = m;
+  for ( int col = 0; col < 4; col++ ) {
+    r.m[col * 4 + 0] = c * m.m[col * 4 + 0] - s * m.m[col * 4 + 1];
+    r.m[col * 4 + 1] = s * m.m[col * 4 + 0] + c * m.m[col * 4 + 1];
+  }
+  return r;
+}
+
+// scale a matrix by [x, y, z]
+constexpr mat4 scale( const mat4& m, const vec3& v ) {
+  mat4 r = m;
+  for ( int col = 0; col < 4; col++ ) {
+    r.m[col * 4 + 0] *= v.v[0];
+    r.m[col * 4 + 1] *= v.v[1];
+    r.m[col * 4 + 2] *= v.v[2];
+  }
+  return r;
+}
+
+/*-----------------------VIRTUAL CAMERA MATRIX FUNCTIONS----------------------*/
+// returns a perspective function mimicking the opengl projection style.
+inline mat4 perspective( float fovy, float aspect, float near, float far ) {
+  float fov_rad       = fovy * ONE_DEG_IN_RAD;
+  float inverse_range = 1.0f / tan( fov_rad / 2.0f );
+  float sx            = inverse_range / aspect;
+  float sy            = inverse_range;
+  float sz            = -( far + near ) / ( far - near );
+  float pz            = -( 2.0f * far * near ) / ( far - near );
+  return mat4( sx, 0.0f, 0.0f, 0.0f, 0.0f, sy, 0.0f, 0.0f, 0.0f, 0.0f, sz, -1.0f, 0.0f, 0.0f, pz, 0.0f );
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+/* 4-wide float helpers used by the maths functions. the backend is picked at
+compile time:
+  MATHS_SIMD_SSE  - x86/x64 with SSE (FMA used when the compiler has it on)
+  MATHS_SIMD_NEON - ARM with NEON
+define MATHS_NO_SIMD before including (or on the command line) to force the
+plain scalar code paths in maths_funcs.cpp. */
+#if !defined( MATHS_NO_SIMD ) && ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) )
+#define MATHS_SIMD
+#define MATHS_SIMD_SSE
+#include <xmmintrin.h>
+#if defined( __FMA__ ) || defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+#elif !defined( MATHS_NO_SIMD ) && ( defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( _M_ARM64 ) )
+#define MATHS_SIMD
+#define MATHS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef MATHS_SIMD_SSE
+typedef __m128 f4;
+
+inline f4 f4_load( const float* p ) { return _mm_loadu_ps( p ); }
+inline void f4_store( float* p, f4 a ) { _mm_storeu_ps( p, a ); }
+// note: arguments in memory order, not _mm_set_ps order
+inline f4 f4_set( float x, float y, float z, float w ) { return _mm_setr_ps( x, y, z, w ); }
+inline f4 f4_splat( float s ) { return _mm_set1_ps( s ); }
+inline f4 f4_add( f4 a, f4 b ) { return _mm_add_ps( a, b ); }
+inline f4 f4_sub( f4 a, f4 b ) { return _mm_sub_ps( a, b ); }
+inline f4 f4_mul( f4 a, f4 b ) { return _mm_mul_ps( a, b ); }
+// a * b + c
+#if defined( __FMA__ ) || defined( __AVX2__ )
+inline f4 f4_madd( f4 a, f4 b, f4 c ) { return _mm_fmadd_ps( a, b, c ); }
+#else
+inline f4 f4_madd( f4 a, f4 b, f4 c ) { return _mm_add_ps( _mm_mul_ps( a, b ), c ); }
+#endif
+// transpose a 4x4 block of 16 floats from in to out
+inline void f4_transpose( const float* in, float* out ) {
+  f4 r0 = _mm_loadu_ps( in );
+  f4 r1 = _mm_loadu_ps( in + 4 );
+  f4 r2 = _mm_loadu_ps( in + 8 );
+  f4 r3 = _mm_loadu_ps( in + 12 );
+  _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+  _mm_storeu_ps( out, r0 );
+  _mm_storeu_ps( out + 4, r1 );
+  _mm_storeu_ps( out + 8, r2 );
+  _mm_storeu_ps( out + 12, r3 );
+}
+// transpose 4 registers in place
+inline void f4_transpose4( f4& a, f4& b, f4& c, f4& d ) { _MM_TRANSPOSE4_PS( a, b, c, d ); }
+// load 4 packed xyz triples (12 floats) as one register each of x, y and z
+inline void f4_load_xyz4( const float* p, f4& x, f4& y, f4& z ) {
+  f4 a = _mm_loadu_ps( p );     // x0 y0 z0 x1
+  f4 b = _mm_loadu_ps( p + 4 ); // y1 z1 x2 y2
+  f4 c = _mm_loadu_ps( p + 8 ); // z2 x3 y3 z3
+  x    = _mm_shuffle_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  y    = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  z    = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+}
+// inverse of f4_load_xyz4
+inline void f4_store_xyz4( float* p, f4 x, f4 y, f4 z ) {
+  f4 a = _mm_shuffle_ps( _mm_shuffle_ps( x, y, _MM_SHUFFLE( 0, 0, 0, 0 ) ), _mm_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  f4 b = _mm_shuffle_ps( _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) ), _mm_shuffle_ps( x, y, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  f4 c = _mm_shuffle_ps( _mm_shuffle_ps( z, x, _MM_SHUFFLE( 3, 3, 2, 2 ) ), _mm_shuffle_ps( y, z, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  _mm_storeu_ps( p, a );
+  _mm_storeu_ps( p + 4, b );
+  _mm_storeu_ps( p + 8, c );
+}
+#endif
+
+#ifdef MATHS_SIMD_NEON
+typedef float32x4_t f4;
+
+inline f4 f4_load( const float* p ) { return vld1q_f32( p ); }
+inline void f4_store( float* p, f4 a ) { vst1q_f32( p, a ); }
+inline f4 f4_set( float x, float y, float z, float w ) {
+  float tmp[4] = { x, y, z, w };
+  return vld1q_f32( tmp );
+}
+inline f4 f4_splat( float s ) { return vdupq_n_f32( s ); }
+inline f4 f4_add( f4 a, f4 b ) { return vaddq_f32( a, b ); }
+inline f4 f4_sub( f4 a, f4 b ) { return vsubq_f32( a, b ); }
+inline f4 f4_mul( f4 a, f4 b ) { return vmulq_f32( a, b ); }
+// a * b + c
+inline f4 f4_madd( f4 a, f4 b, f4 c ) { return vmlaq_f32( c, a, b ); }
+// vld4 de-interleaves on load, which is exactly a 4x4 transpose
+inline void f4_transpose( const float* in, float* out ) {
+  float32x4x4_t t = vld4q_f32( in );
+  vst1q_f32( out, t.val[0] );
+  vst1q_f32( out + 4, t.val[1] );
+  vst1q_f32( out + 8, t.val[2] );
+  vst1q_f32( out + 12, t.val[3] );
+}
+// transpose 4 registers in place
+inline void f4_transpose4( f4& a, f4& b, f4& c, f4& d ) {
+  float32x4x2_t ab = vtrnq_f32( a, b ); // a0 b0 a2 b2 | a1 b1 a3 b3
+  float32x4x2_t cd = vtrnq_f32( c, d );
+  a                = vcombine_f32( vget_low_f32( ab.val[0] ), vget_low_f32( cd.val[0] ) );
+  b                = vcombine_f32( vget_low_f32( ab.val[1] ), vget_low_f32( cd.val[1] ) );
+  c                = vcombine_f32( vget_high_f32( ab.val[0] ), vget_high_f32( cd.val[0] ) );
+  d                = vcombine_f32( vget_high_f32( ab.val[1] ), vget_high_f32( cd.val[1] ) );
+}
+// load 4 packed xyz triples (12 floats) as one register each of x, y and z
+inline void f4_load_xyz4( const float* p, f4& x, f4& y, f4& z ) {
+  float32x4x3_t t = vld3q_f32( p );
+  x               = t.val[0];
+  y               = t.val[1];
+  z               = t.val[2];
+}
+// inverse of f4_load_xyz4
+inline void f4_store_xyz4( float* p, f4 x, f4 y, f4 z ) {
+  float32x4x3_t t = { { x, y, z } };
+  vst3q_f32( p, t );
+}
+#endif
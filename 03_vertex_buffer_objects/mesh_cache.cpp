@@ -0,0 +1,245 @@
+#include "mesh_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static const char g_mesh_cache_magic[4] = { 'A', 'M', 'S', 'H' };
+
+static size_t align_up(size_t n) { return (n + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT; }
+
+/*-----------------------------CHECKSUM--------------------------------------*/
+/* 4 independent 64-bit lanes over 32-byte blocks, the same structure as
+xxHash64, so it runs at memory speed rather than a byte at a time like FNV.
+good at catching truncation and corruption, not meant to be cryptographic */
+#define HASH_P1 0x9E3779B185EBCA87ull
+#define HASH_P2 0xC2B2AE3D27D4EB4Full
+#define HASH_P3 0x165667B19E3779F9ull
+
+static inline unsigned long long rotl64(unsigned long long x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline unsigned long long read64(const unsigned char* p) {
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline unsigned long long hash_round(unsigned long long lane, unsigned long long word) { return rotl64(lane + word * HASH_P2, 31) * HASH_P1; }
+
+static unsigned long long mesh_cache_hash(const void* data, size_t size, unsigned long long seed) {
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+	unsigned long long h;
+	if (size >= 32) {
+		unsigned long long lanes[4] = { seed + HASH_P1 + HASH_P2, seed + HASH_P2, seed, seed - HASH_P1 };
+		for (; p + 32 <= end; p += 32) {
+			lanes[0] = hash_round(lanes[0], read64(p));
+			lanes[1] = hash_round(lanes[1], read64(p + 8));
+			lanes[2] = hash_round(lanes[2], read64(p + 16));
+			lanes[3] = hash_round(lanes[3], read64(p + 24));
+		}
+		h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+		for (int i = 0; i < 4; i++) {
+			h = (h ^ hash_round(0, lanes[i])) * HASH_P1 + HASH_P3;
+		}
+	} else {
+		h = seed + HASH_P3;
+	}
+	h += (unsigned long long)size;
+	for (; p + 8 <= end; p += 8) {
+		h = rotl64(h ^ hash_round(0, read64(p)), 27) * HASH_P1 + HASH_P3;
+	}
+	for (; p < end; p++) {
+		h = rotl64(h ^ (*p * HASH_P3), 11) * HASH_P1;
+	}
+	h ^= h >> 33;
+	h *= HASH_P2;
+	h ^= h >> 29;
+	h *= HASH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+static unsigned long long mesh_cache_checksum(const mesh_cache_header* header, const void* vertices, const void* indices) {
+	mesh_cache_header copy = *header;
+	copy.checksum = 0;
+	unsigned long long h = mesh_cache_hash(&copy, sizeof(copy), 0);
+	h = mesh_cache_hash(vertices, (size_t)(header->n_vertices * header->vertex_stride), h);
+	return mesh_cache_hash(indices, (size_t)(header->n_indices * sizeof(GLuint)), h);
+}
+
+/*-----------------------------WRITING---------------------------------------*/
+static bool write_padding(FILE* f, size_t from) {
+	static const char zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+	size_t n = align_up(from) - from;
+	return n == 0 || fwrite(zeros, 1, n, f) == n;
+}
+
+bool mesh_cache_write(const char* file_name, const vertex_format* format, const void* vertices, size_t n_vertices, const GLuint* indices,
+	size_t n_indices, const float* bounds_min, const float* bounds_max) {
+	mesh_cache_header header;
+	// zeroed so the unused attrs and padding hash the same every time
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_mesh_cache_magic, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.header_size = sizeof(mesh_cache_header);
+	header.vertex_stride = (unsigned int)format->stride;
+	header.n_attrs = (unsigned int)format->n_attrs;
+	for (int i = 0; i < format->n_attrs; i++) {
+		header.attrs[i].location = format->attrs[i].location;
+		header.attrs[i].components = (unsigned int)format->attrs[i].components;
+		header.attrs[i].type = (unsigned int)format->attrs[i].type;
+		header.attrs[i].offset = (unsigned int)format->attrs[i].offset;
+	}
+	memcpy(header.bounds_min, bounds_min, sizeof(header.bounds_min));
+	memcpy(header.bounds_max, bounds_max, sizeof(header.bounds_max));
+	header.n_vertices = n_vertices;
+	header.n_indices = n_indices;
+	size_t vertex_bytes = n_vertices * format->stride;
+	size_t index_bytes = n_indices * sizeof(GLuint);
+	header.vertex_offset = align_up(sizeof(header));
+	header.index_offset = align_up((size_t)header.vertex_offset + vertex_bytes);
+	header.checksum = mesh_cache_checksum(&header, vertices, indices);
+
+	// write to a temporary name then rename, so a crash never leaves half a file behind
+	std::string tmp_name = std::string(file_name) + ".tmp";
+	FILE* f = fopen(tmp_name.c_str(), "wb");
+	if (!f) {
+		gl_log_err("ERROR: could not open %s for writing\n", tmp_name.c_str());
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && write_padding(f, sizeof(header));
+	ok = ok && (vertex_bytes == 0 || fwrite(vertices, vertex_bytes, 1, f) == 1) && write_padding(f, (size_t)header.vertex_offset + vertex_bytes);
+	ok = ok && (index_bytes == 0 || fwrite(indices, index_bytes, 1, f) == 1);
+	ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+	// rename() won't replace an existing file here. POSIX rename swaps it in atomically
+	if (ok) {
+		remove(file_name);
+	}
+#endif
+	if (!ok || rename(tmp_name.c_str(), file_name) != 0) {
+		gl_log_err("ERROR: writing mesh cache %s\n", file_name);
+		remove(tmp_name.c_str());
+		return false;
+	}
+	gl_log("wrote mesh cache %s: %u vertices, %u indices\n", file_name, (unsigned int)n_vertices, (unsigned int)n_indices);
+	return true;
+}
+
+bool mesh_cache_write_obj(const char* file_name, const obj_mesh* mesh) {
+	return mesh_cache_write(file_name, &mesh->format, mesh->vertices.data(), mesh->n_vertices, mesh->indices.data(), mesh->indices.size(),
+		mesh->bounds_min, mesh->bounds_max);
+}
+
+/*-----------------------------LOADING---------------------------------------*/
+// everything that can be checked without reading the vertices and indices
+static const char* check_header(const mesh_cache_header* h, size_t file_size) {
+	if (memcmp(h->magic, g_mesh_cache_magic, 4) != 0) {
+		return "not a mesh cache file";
+	}
+	if (h->version != MESH_CACHE_VERSION || h->header_size != sizeof(mesh_cache_header)) {
+		return "wrong version - rebuild it from the source asset";
+	}
+	if (h->n_attrs == 0 || h->n_attrs > VERTEX_FORMAT_MAX_ATTRS || h->vertex_stride == 0) {
+		return "bad vertex format";
+	}
+	for (unsigned int i = 0; i < h->n_attrs; i++) {
+		const mesh_cache_attr* a = &h->attrs[i];
+		if (a->type > VA_UINT_2_10_10_10 || a->components < 1 || a->components > 4 || (a->type >= VA_INT_2_10_10_10 && a->components != 4)) {
+			return "bad vertex attribute";
+		}
+		// the whole attribute has to fit in the vertex, not just its first byte
+		if (a->offset > h->vertex_stride || vertex_attr_size((vertex_attr_type)a->type, (int)a->components) > h->vertex_stride - a->offset) {
+			return "vertex attribute runs past the end of the vertex";
+		}
+		// an attribute location the driver may not have would fail at draw time
+		if (a->location >= MESH_CACHE_MAX_LOCATIONS) {
+			return "vertex attribute location out of range";
+		}
+	}
+	// sizes are compared by division so huge counts can't overflow past the checks
+	if (h->vertex_offset < sizeof(mesh_cache_header) || h->vertex_offset > file_size ||
+		h->n_vertices > (file_size - h->vertex_offset) / h->vertex_stride) {
+		return "vertices run past the end of the file";
+	}
+	if (h->index_offset < h->vertex_offset + h->n_vertices * h->vertex_stride || h->index_offset > file_size ||
+		h->n_indices > (file_size - h->index_offset) / sizeof(GLuint)) {
+		return "indices run past the end of the file";
+	}
+	if (h->vertex_offset % MESH_CACHE_ALIGNMENT != 0 || h->index_offset % MESH_CACHE_ALIGNMENT != 0) {
+		return "misaligned sections";
+	}
+	return NULL;
+}
+
+bool mesh_cache_open(const char* file_name, mesh_cache_view* view, bool verify_checksum) {
+	memset(view, 0, sizeof(*view));
+	if (!map_file(file_name, &view->file)) {
+		return false;
+	}
+	const char* error = NULL;
+	const mesh_cache_header* header = (const mesh_cache_header*)view->file.data;
+	if (view->file.size < sizeof(mesh_cache_header)) {
+		error = "file too short";
+	} else {
+		error = check_header(header, view->file.size);
+	}
+	if (!error) {
+		view->vertices = view->file.data + header->vertex_offset;
+		view->n_vertices = (size_t)header->n_vertices;
+		view->indices = (const GLuint*)(view->file.data + header->index_offset);
+		view->n_indices = (size_t)header->n_indices;
+		if (verify_checksum) {
+			if (mesh_cache_checksum(header, view->vertices, view->indices) != header->checksum) {
+				error = "checksum mismatch";
+			} else {
+				for (size_t i = 0; i < view->n_indices; i++) {
+					if (view->indices[i] >= view->n_vertices) {
+						error = "index out of range";
+						break;
+					}
+				}
+			}
+		}
+	}
+	if (error) {
+		gl_log_err("ERROR: mesh cache %s: %s\n", file_name, error);
+		mesh_cache_close(view);
+		return false;
+	}
+
+	vertex_format_init(&view->format);
+	view->format.n_attrs = (int)header->n_attrs;
+	view->format.stride = header->vertex_stride;
+	for (unsigned int i = 0; i < header->n_attrs; i++) {
+		view->format.attrs[i].location = header->attrs[i].location;
+		view->format.attrs[i].components = (int)header->attrs[i].components;
+		view->format.attrs[i].type = (vertex_attr_type)header->attrs[i].type;
+		view->format.attrs[i].offset = header->attrs[i].offset;
+	}
+	memcpy(view->bounds_min, header->bounds_min, sizeof(view->bounds_min));
+	memcpy(view->bounds_max, header->bounds_max, sizeof(view->bounds_max));
+	return true;
+}
+
+void mesh_cache_close(mesh_cache_view* view) {
+	if (view->file.data) {
+		unmap_file(&view->file);
+	}
+	view->vertices = NULL;
+	view->indices = NULL;
+	view->n_vertices = 0;
+	view->n_indices = 0;
+}
+
+GLuint create_vao_for_mesh_cache(const mesh_cache_view* view, GLuint* vbo, GLuint* ibo) {
+	glGenBuffers(1, vbo);
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, *vbo);
+	glBufferData(GL_ARRAY_BUFFER, view->n_vertices * view->format.stride, view->vertices, GL_STATIC_DRAW);
+	GLuint vao = create_vao_for_format(&view->format, *vbo);
+	// the element buffer binding is part of the VAO, which is still bound
+	glGenBuffers(1, ibo);
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, *ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, view->n_indices * sizeof(GLuint), view->indices, GL_STATIC_DRAW);
+	return vao;
+}
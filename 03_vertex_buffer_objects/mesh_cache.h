@@ -0,0 +1,85 @@
+#pragma once
+
+#include "gl_utils.h"
+#include "obj_loader.h"
+#include "vertex_format.h"
+#include <cstddef>
+
+/* binary mesh files, written once from a source asset (see tools/mesh_convert)
+and then loaded with no parsing at all: the file is memory-mapped, the header
+is checked, and vertices and indices are used in place, so they can be handed
+straight to glBufferData() or mesh_arena_add().
+
+  mesh_cache_view view;
+  if (mesh_cache_open("bunny.mesh", &view)) {
+    GLuint vbo, ibo;
+    GLuint vao = create_vao_for_mesh_cache(&view, &vbo, &ibo);
+    mesh_cache_close(&view);
+    ...
+  }
+
+layout, in the byte order of the machine that wrote it:
+  mesh_cache_header
+  vertices - n_vertices * vertex_stride bytes, interleaved as described by attrs
+  indices  - n_indices 32-bit indices
+each section starts on a MESH_CACHE_ALIGNMENT boundary. a file written with a
+different version, or on a machine with the other byte order, fails the magic
+and version checks and should be rebuilt from the source asset. */
+
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_ALIGNMENT 16
+// the GL_MAX_VERTEX_ATTRIBS every GL 3.0+ context supports
+#define MESH_CACHE_MAX_LOCATIONS 16
+
+struct mesh_cache_attr {
+	unsigned int location;
+	unsigned int components;
+	unsigned int type; // vertex_attr_type
+	unsigned int offset;
+};
+
+struct mesh_cache_header {
+	char magic[4]; // "AMSH"
+	unsigned int version;
+	unsigned int header_size; // sizeof(mesh_cache_header)
+	unsigned int vertex_stride;
+	unsigned int n_attrs;
+	unsigned int reserved;
+	mesh_cache_attr attrs[VERTEX_FORMAT_MAX_ATTRS];
+	float bounds_min[3];
+	float bounds_max[3];
+	unsigned long long n_vertices;
+	unsigned long long n_indices;
+	unsigned long long vertex_offset; // bytes from the start of the file
+	unsigned long long index_offset;
+	/* hash of this header (with checksum as 0), the vertices and the indices.
+	keep it last */
+	unsigned long long checksum;
+};
+
+// a mapped cache file. the pointers are valid until mesh_cache_close()
+struct mesh_cache_view {
+	mapped_file file;
+	vertex_format format;
+	const void* vertices;
+	size_t n_vertices;
+	const GLuint* indices;
+	size_t n_indices;
+	float bounds_min[3];
+	float bounds_max[3];
+};
+
+bool mesh_cache_write(const char* file_name, const vertex_format* format, const void* vertices, size_t n_vertices, const GLuint* indices,
+	size_t n_indices, const float* bounds_min, const float* bounds_max);
+
+bool mesh_cache_write_obj(const char* file_name, const obj_mesh* mesh);
+
+/* maps the file and checks the header. verify_checksum also hashes every byte
+and checks every index is in range - worth it for files from elsewhere, but
+skipping it keeps the open O(1) for files this machine wrote */
+bool mesh_cache_open(const char* file_name, mesh_cache_view* view, bool verify_checksum = true);
+
+void mesh_cache_close(mesh_cache_view* view);
+
+// uploads straight from the mapping. the view can be closed afterwards
+GLuint create_vao_for_mesh_cache(const mesh_cache_view* view, GLuint* vbo, GLuint* ibo);
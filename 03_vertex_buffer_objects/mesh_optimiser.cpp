@@ -0,0 +1,396 @@
+#include "mesh_optimiser.h"
+#include "gl_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/*-----------------------------METRICS---------------------------------------*/
+vertex_cache_stats analyse_vertex_cache(const GLuint* indices, size_t n_indices, size_t n_vertices, int cache_size) {
+	/* a FIFO cache holds the last cache_size misses, so a vertex is still in it
+	if fewer than cache_size misses have happened since its own */
+	std::vector<size_t> missed_at(n_vertices, 0);
+	std::vector<char> used(n_vertices, 0);
+	size_t misses = 0, n_used = 0;
+	for (size_t i = 0; i < n_indices; i++) {
+		GLuint v = indices[i];
+		if (!used[v] || misses - missed_at[v] >= (size_t)cache_size) {
+			if (!used[v]) {
+				used[v] = 1;
+				n_used++;
+			}
+			missed_at[v] = misses++;
+		}
+	}
+	vertex_cache_stats stats;
+	stats.transforms = misses;
+	stats.acmr = n_indices ? (float)misses / (n_indices / 3) : 0.0f;
+	stats.atvr = n_used ? (float)misses / n_used : 0.0f;
+	return stats;
+}
+
+/*-----------------------------VERTEX CACHE----------------------------------*/
+/* Tom Forsyth, "Linear-Speed Vertex Cache Optimisation". each vertex scores
+higher the more recently it was used and the fewer triangles it has left, and
+the next triangle drawn is the best scoring one that touches the cache */
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 64
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+static float g_forsyth_cache_scores[FORSYTH_CACHE_SIZE];
+static float g_forsyth_valence_scores[FORSYTH_MAX_VALENCE];
+static bool g_forsyth_tables_ready = false;
+
+static void build_forsyth_tables() {
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+		if (i < 3) {
+			// the triangle just drawn. a flat score so its order doesn't matter
+			g_forsyth_cache_scores[i] = FORSYTH_LAST_TRI_SCORE;
+		} else {
+			float scaler = 1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3);
+			g_forsyth_cache_scores[i] = powf(scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	for (int i = 1; i < FORSYTH_MAX_VALENCE; i++) {
+		g_forsyth_valence_scores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+	g_forsyth_valence_scores[0] = 0.0f;
+	g_forsyth_tables_ready = true;
+}
+
+static inline float forsyth_vertex_score(int cache_position, unsigned int remaining) {
+	if (remaining == 0) {
+		// nothing left to draw with it
+		return -1.0f;
+	}
+	float score = cache_position >= 0 ? g_forsyth_cache_scores[cache_position] : 0.0f;
+	return score + g_forsyth_valence_scores[remaining < FORSYTH_MAX_VALENCE ? remaining : FORSYTH_MAX_VALENCE - 1];
+}
+
+void optimise_vertex_cache(GLuint* indices, size_t n_indices, size_t n_vertices) {
+	size_t n_triangles = n_indices / 3;
+	if (n_triangles == 0) {
+		return;
+	}
+	if (!g_forsyth_tables_ready) {
+		build_forsyth_tables();
+	}
+
+	/* triangles per vertex. the first remaining[v] entries of each vertex's list
+	are the triangles still to be drawn */
+	std::vector<unsigned int> remaining(n_vertices, 0);
+	for (size_t i = 0; i < n_triangles * 3; i++) {
+		remaining[indices[i]]++;
+	}
+	std::vector<size_t> first_triangle(n_vertices + 1, 0);
+	for (size_t v = 0; v < n_vertices; v++) {
+		first_triangle[v + 1] = first_triangle[v] + remaining[v];
+	}
+	std::vector<unsigned int> triangles(n_triangles * 3);
+	std::vector<size_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+	for (size_t t = 0; t < n_triangles; t++) {
+		for (int k = 0; k < 3; k++) {
+			triangles[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<int> cache_position(n_vertices, -1);
+	std::vector<float> vertex_score(n_vertices);
+	for (size_t v = 0; v < n_vertices; v++) {
+		vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+	}
+	std::vector<float> triangle_score(n_triangles);
+	std::vector<char> emitted(n_triangles, 0);
+	long long best = -1;
+	float best_score = -1.0f;
+	for (size_t t = 0; t < n_triangles; t++) {
+		const GLuint* tri = &indices[t * 3];
+		triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+		if (triangle_score[t] > best_score) {
+			best_score = triangle_score[t];
+			best = (long long)t;
+		}
+	}
+
+	// 3 extra slots for the vertices pushed out by the newest triangle
+	GLuint cache[FORSYTH_CACHE_SIZE + 3];
+	GLuint new_cache[FORSYTH_CACHE_SIZE + 3];
+	int cache_count = 0;
+	std::vector<GLuint> out(n_triangles * 3);
+	size_t cursor = 0;
+
+	for (size_t drawn = 0; drawn < n_triangles; drawn++) {
+		if (best < 0) {
+			// nothing in the cache has triangles left - carry on in input order
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = (long long)cursor;
+		}
+		const GLuint* tri = &indices[best * 3];
+		memcpy(&out[drawn * 3], tri, 3 * sizeof(GLuint));
+		emitted[best] = 1;
+
+		// take it off each of its vertices' lists
+		for (int k = 0; k < 3; k++) {
+			GLuint v = tri[k];
+			unsigned int* list = &triangles[first_triangle[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++) {
+				if (list[i] == (unsigned int)best) {
+					list[i] = list[remaining[v] - 1];
+					list[remaining[v] - 1] = (unsigned int)best;
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// LRU: the triangle's vertices go to the front, once each if it's degenerate
+		int new_count = 0;
+		for (int k = 0; k < 3; k++) {
+			if ((k < 1 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1])) {
+				new_cache[new_count++] = tri[k];
+			}
+		}
+		for (int i = 0; i < cache_count; i++) {
+			GLuint v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				new_cache[new_count++] = v;
+			}
+		}
+
+		// rescore everything that moved, including what fell out the end
+		for (int i = 0; i < new_count; i++) {
+			GLuint v = new_cache[i];
+			int position = i < FORSYTH_CACHE_SIZE ? i : -1;
+			cache_position[v] = position;
+			float score = forsyth_vertex_score(position, remaining[v]);
+			float delta = score - vertex_score[v];
+			vertex_score[v] = score;
+			const unsigned int* list = &triangles[first_triangle[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				triangle_score[list[j]] += delta;
+			}
+		}
+
+		/* only once every delta is in - a triangle with two cached vertices would
+		otherwise be picked on the first one's update before the second's lowers it */
+		best = -1;
+		best_score = -1.0f;
+		for (int i = 0; i < new_count && i < FORSYTH_CACHE_SIZE; i++) {
+			GLuint v = new_cache[i];
+			const unsigned int* list = &triangles[first_triangle[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				unsigned int t = list[j];
+				if (triangle_score[t] > best_score) {
+					best_score = triangle_score[t];
+					best = (long long)t;
+				}
+			}
+		}
+		cache_count = new_count < FORSYTH_CACHE_SIZE ? new_count : FORSYTH_CACHE_SIZE;
+		memcpy(cache, new_cache, cache_count * sizeof(GLuint));
+	}
+	memcpy(indices, out.data(), n_triangles * 3 * sizeof(GLuint));
+}
+
+/*-----------------------------OVERDRAW--------------------------------------*/
+struct triangle_cluster {
+	size_t first; // first triangle
+	size_t count;
+	float sort_key;
+};
+
+static inline const float* position_of(const void* positions, size_t stride, GLuint v) {
+	return (const float*)((const unsigned char*)positions + v * stride);
+}
+
+/* FIFO cache simulation for cutting clusters, as in analyse_vertex_cache().
+moving the clock on by the cache size empties it */
+struct fifo_cache {
+	std::vector<size_t> missed_at;
+	size_t clock;
+};
+
+static inline void fifo_cache_flush(fifo_cache* cache) { cache->clock += MESH_OPT_CACHE_SIZE; }
+
+static inline int fifo_cache_triangle(fifo_cache* cache, const GLuint* tri) {
+	int misses = 0;
+	for (int k = 0; k < 3; k++) {
+		GLuint v = tri[k];
+		if (cache->clock - cache->missed_at[v] >= MESH_OPT_CACHE_SIZE) {
+			cache->missed_at[v] = cache->clock++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+void optimise_overdraw(GLuint* indices, size_t n_indices, const void* positions, size_t position_stride, size_t n_vertices, float threshold) {
+	size_t n_triangles = n_indices / 3;
+	if (n_triangles < 2) {
+		return;
+	}
+	fifo_cache cache;
+	cache.missed_at.assign(n_vertices, 0);
+	cache.clock = MESH_OPT_CACHE_SIZE;
+
+	/* Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+	and Reduced Overdraw" (Tipsify). hard boundaries first, where a triangle
+	misses the cache on all 3 vertices - the vertex cache pass rarely leaves
+	those on a connected mesh, so on their own they give one cluster */
+	std::vector<size_t> hard;
+	for (size_t t = 0; t < n_triangles; t++) {
+		if (fifo_cache_triangle(&cache, &indices[t * 3]) == 3 || t == 0) {
+			hard.push_back(t);
+		}
+	}
+	hard.push_back(n_triangles);
+
+	/* then soft ones inside each: with the cache emptied at the start of a
+	cluster, cut as soon as its running ACMR is down to threshold times what the
+	whole hard cluster gets. each cluster then costs at most about threshold
+	times its share of the ACMR wherever it ends up being drawn */
+	std::vector<triangle_cluster> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t first = hard[h], end = hard[h + 1];
+		fifo_cache_flush(&cache);
+		size_t misses = 0;
+		for (size_t t = first; t < end; t++) {
+			misses += fifo_cache_triangle(&cache, &indices[t * 3]);
+		}
+		float cut_acmr = threshold * (float)misses / (float)(end - first);
+
+		size_t n_before = clusters.size();
+		triangle_cluster c = { first, 0, 0.0f };
+		clusters.push_back(c);
+		fifo_cache_flush(&cache);
+		size_t running_misses = 0, running_count = 0;
+		bool met_cut = false;
+		for (size_t t = first; t < end; t++) {
+			running_misses += fifo_cache_triangle(&cache, &indices[t * 3]);
+			running_count++;
+			clusters.back().count++;
+			met_cut = (float)running_misses <= cut_acmr * (float)running_count;
+			if (met_cut && t + 1 < end) {
+				triangle_cluster next = { t + 1, 0, 0.0f };
+				clusters.push_back(next);
+				fifo_cache_flush(&cache);
+				running_misses = running_count = 0;
+			}
+		}
+		// the tail never got down to the cut, so it's a poor cluster. join it onto the one before
+		if (!met_cut && clusters.size() > n_before + 1) {
+			size_t tail = clusters.back().count;
+			clusters.pop_back();
+			clusters.back().count += tail;
+		}
+	}
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	// area-weighted centroid of the whole mesh, then of each cluster
+	double mesh_centre[3] = { 0.0, 0.0, 0.0 };
+	double mesh_area = 0.0;
+	std::vector<float> cluster_data(clusters.size() * 7); // centre xyz, normal xyz, area
+	for (size_t c = 0; c < clusters.size(); c++) {
+		float* data = &cluster_data[c * 7];
+		memset(data, 0, 7 * sizeof(float));
+		for (size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++) {
+			const float* a = position_of(positions, position_stride, indices[t * 3]);
+			const float* b = position_of(positions, position_stride, indices[t * 3 + 1]);
+			const float* p = position_of(positions, position_stride, indices[t * 3 + 2]);
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+			// twice the area, pointing out of the counter-clockwise side
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int i = 0; i < 3; i++) {
+				data[i] += (a[i] + b[i] + p[i]) / 3.0f * area;
+				data[3 + i] += n[i];
+			}
+			data[6] += area;
+		}
+		for (int i = 0; i < 3; i++) {
+			mesh_centre[i] += data[i];
+		}
+		mesh_area += data[6];
+	}
+	if (mesh_area <= 0.0) {
+		return;
+	}
+	for (int i = 0; i < 3; i++) {
+		mesh_centre[i] /= mesh_area;
+	}
+
+	/* how far the cluster sits out along its own facing direction. clusters on
+	the outside of the mesh, facing away from the centre, are the most likely
+	to hide others, so they go first */
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const float* data = &cluster_data[c * 7];
+		float length = sqrtf(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		if (data[6] <= 0.0f || length <= 0.0f) {
+			clusters[c].sort_key = 0.0f;
+			continue;
+		}
+		float key = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			key += (float)(data[i] / data[6] - mesh_centre[i]) * data[3 + i] / length;
+		}
+		clusters[c].sort_key = key;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const triangle_cluster& a, const triangle_cluster& b) { return a.sort_key > b.sort_key; });
+
+	std::vector<GLuint> out(n_triangles * 3);
+	size_t written = 0;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		memcpy(&out[written], &indices[clusters[c].first * 3], clusters[c].count * 3 * sizeof(GLuint));
+		written += clusters[c].count * 3;
+	}
+	memcpy(indices, out.data(), n_triangles * 3 * sizeof(GLuint));
+}
+
+/*-----------------------------VERTEX FETCH----------------------------------*/
+size_t optimise_vertex_fetch(void* vertices, size_t n_vertices, size_t stride, GLuint* indices, size_t n_indices) {
+	std::vector<GLuint> remap(n_vertices, 0xFFFFFFFF);
+	std::vector<unsigned char> reordered(n_vertices * stride);
+	const unsigned char* src = (const unsigned char*)vertices;
+	GLuint next = 0;
+	for (size_t i = 0; i < n_indices; i++) {
+		GLuint v = indices[i];
+		if (remap[v] == 0xFFFFFFFF) {
+			memcpy(&reordered[(size_t)next * stride], src + (size_t)v * stride, stride);
+			remap[v] = next++;
+		}
+		indices[i] = remap[v];
+	}
+	memcpy(vertices, reordered.data(), (size_t)next * stride);
+	return next;
+}
+
+mesh_opt_stats optimise_obj_mesh(obj_mesh* mesh, bool reduce_overdraw) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLuint* indices = mesh->indices.data();
+	size_t n_indices = mesh->indices.size();
+	mesh_opt_stats stats;
+	stats.before = analyse_vertex_cache(indices, n_indices, mesh->n_vertices);
+
+	optimise_vertex_cache(indices, n_indices, mesh->n_vertices);
+	const vertex_attr* position = &mesh->format.attrs[0];
+	if (reduce_overdraw && mesh->format.n_attrs > 0 && position->type == VA_FLOAT && position->components >= 3) {
+		optimise_overdraw(indices, n_indices, mesh->vertices.data() + position->offset, mesh->format.stride, mesh->n_vertices);
+	}
+	mesh->n_vertices = optimise_vertex_fetch(mesh->vertices.data(), mesh->n_vertices, mesh->format.stride, indices, n_indices);
+	mesh->vertices.resize(mesh->n_vertices * mesh->format.stride);
+
+	stats.after = analyse_vertex_cache(indices, n_indices, mesh->n_vertices);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	gl_log("optimised %u triangles in %.1f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%i entry cache)\n", (unsigned int)(n_indices / 3), ms,
+		stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr, MESH_OPT_CACHE_SIZE);
+	return stats;
+}
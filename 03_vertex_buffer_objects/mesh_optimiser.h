@@ -0,0 +1,65 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "obj_loader.h"
+#include <cstddef>
+
+/* reorders indexed triangle meshes so the GPU does less work for the same
+picture. none of it changes what's drawn, only the order:
+  optimise_vertex_cache - Forsyth's linear-speed vertex cache optimisation.
+                          triangles sharing vertices are pulled together so
+                          the post-transform cache hits more often and the
+                          vertex shader runs fewer times
+  optimise_overdraw     - Tipsify's clustering. cuts the result into clusters
+                          that each start with a cold cache and cost little
+                          more ACMR than before, and sorts the clusters so
+                          those facing outwards from the mesh centre are
+                          drawn first
+  optimise_vertex_fetch - renumbers vertices in the order they're first used
+                          so vertex fetch walks memory forwards. drops any
+                          vertex no triangle uses
+run them in that order - the last one renumbers vertices, the first two only
+move triangles. optimise_obj_mesh() does all three, logs the metrics and returns them.
+
+the metrics are from a FIFO cache simulation:
+  ACMR - vertex shader runs per triangle. 3 = no reuse; ~0.5 is the floor for
+         a regular grid
+  ATVR - vertex shader runs per vertex. 1 = every vertex transformed once */
+
+// cache size used for the metrics. typical of hardware post-transform caches
+#define MESH_OPT_CACHE_SIZE 16
+/* optimise_overdraw() cuts a cluster once its ACMR is down to this many times
+its part of the mesh's. higher gives more, smaller clusters to sort, at the
+cost of more vertex shader runs */
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+struct vertex_cache_stats {
+	size_t transforms; // cache misses
+	float acmr;
+	float atvr;
+};
+
+vertex_cache_stats analyse_vertex_cache(const GLuint* indices, size_t n_indices, size_t n_vertices, int cache_size = MESH_OPT_CACHE_SIZE);
+
+// reorders triangles in place
+void optimise_vertex_cache(GLuint* indices, size_t n_indices, size_t n_vertices);
+
+/* reorders triangles in place. positions are float3s position_stride bytes
+apart - e.g. the interleaved vertices with the position first. expects counter
+clockwise winding, as in .obj files */
+void optimise_overdraw(GLuint* indices, size_t n_indices, const void* positions, size_t position_stride, size_t n_vertices,
+	float threshold = MESH_OPT_OVERDRAW_THRESHOLD);
+
+/* reorders vertices (stride bytes each) and rewrites the indices to match.
+returns the new vertex count */
+size_t optimise_vertex_fetch(void* vertices, size_t n_vertices, size_t stride, GLuint* indices, size_t n_indices);
+
+// the metrics on either side of optimise_obj_mesh()
+struct mesh_opt_stats {
+	vertex_cache_stats before;
+	vertex_cache_stats after;
+};
+
+/* the full pass. overdraw sorting is skipped if the first attribute isn't a
+float position */
+mesh_opt_stats optimise_obj_mesh(obj_mesh* mesh, bool reduce_overdraw = true);
@@ -0,0 +1,640 @@
+#include "obj_loader.h"
+#include "gl_utils.h"
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+// below this a file isn't worth splitting between threads
+#define OBJ_MIN_CHUNK_BYTES (1 << 20)
+// marks a v/vt/vn slot that the face didn't give
+#define OBJ_NO_INDEX INT_MIN
+// flags for indices that were negative in the file and are relative to the chunk
+#define OBJ_RELATIVE_V 1
+#define OBJ_RELATIVE_VT 2
+#define OBJ_RELATIVE_VN 4
+
+// one face corner as written in the file, resolved to 0-based indices later
+struct obj_corner {
+	int v, vt, vn;
+	unsigned int relative;
+};
+
+// everything parsed out of one run of lines
+struct obj_chunk {
+	const char* begin;
+	const char* end;
+	std::vector<float> positions; // 3 per v
+	std::vector<float> normals;   // 3 per vn
+	std::vector<float> texcoords; // 2 per vt
+	std::vector<obj_corner> corners; // 3 per triangle
+	size_t n_lines;
+	size_t error_line; // 0 if the chunk parsed, otherwise 1-based within the chunk
+	const char* error;
+	// prefix sums over the chunks before this one
+	size_t first_v, first_vt, first_vn;
+};
+
+/*-----------------------------TOKENIZER-------------------------------------*/
+static inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* skip_space(const char* p, const char* end) {
+	while (p < end && is_space(*p)) {
+		p++;
+	}
+	return p;
+}
+
+static inline const char* skip_line(const char* p, const char* end) {
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+static const double g_pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+	1e20, 1e21, 1e22 };
+
+/* [-+]digits[.digits][(e|E)[-+]digits]. the digits are gathered into a 64-bit
+integer and scaled once at the end, which is exact to well past float
+precision. returns NULL if there's no number at p */
+static const char* parse_float(const char* p, const char* end, float* out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int n_digits = 0;
+	bool any = false;
+	for (; p < end && is_digit(*p); p++) {
+		any = true;
+		// 19 digits always fit. beyond that only the magnitude matters
+		if (n_digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) {
+				n_digits++;
+			}
+		} else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		p++;
+		for (; p < end && is_digit(*p); p++) {
+			any = true;
+			if (n_digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) {
+					n_digits++;
+				}
+				exponent--;
+			}
+		}
+	}
+	if (!any) {
+		return NULL;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool exp_negative = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			exp_negative = *e == '-';
+			e++;
+		}
+		if (e < end && is_digit(*e)) {
+			int exp_value = 0;
+			for (; e < end && is_digit(*e); e++) {
+				if (exp_value < 10000) {
+					exp_value = exp_value * 10 + (*e - '0');
+				}
+			}
+			exponent += exp_negative ? -exp_value : exp_value;
+			p = e;
+		}
+	}
+	double value = (double)mantissa;
+	// floats run out at 1e38 and 1e-45, so clamping the scale there is harmless
+	if (exponent < -60) {
+		value = 0.0;
+	} else if (exponent > 60) {
+		value = 1e60;
+	} else {
+		while (exponent > 22) {
+			value *= 1e22;
+			exponent -= 22;
+		}
+		while (exponent < -22) {
+			value /= 1e22;
+			exponent += 22;
+		}
+		value = exponent >= 0 ? value * g_pow10[exponent] : value / g_pow10[-exponent];
+	}
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int* out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if (p >= end || !is_digit(*p)) {
+		return NULL;
+	}
+	long long value = 0;
+	for (; p < end && is_digit(*p); p++) {
+		if (value <= INT_MAX) {
+			value = value * 10 + (*p - '0');
+		}
+	}
+	if (value > INT_MAX) {
+		value = INT_MAX;
+	}
+	*out = (int)(negative ? -value : value);
+	return p;
+}
+
+/* reads n floats, and ignores any more on the line (v can carry a w or a
+colour, vt a w) */
+static const char* parse_floats(const char* p, const char* end, float* out, int n) {
+	for (int i = 0; i < n; i++) {
+		p = skip_space(p, end);
+		p = parse_float(p, end, &out[i]);
+		if (!p) {
+			return NULL;
+		}
+	}
+	return p;
+}
+
+/* turns a 1-based or negative index from the file into a 0-based one. negative
+indices count back from the number of elements seen so far, which at this
+point is only known within the chunk, so they're flagged and finished off in
+resolve_chunk() */
+static inline bool encode_index(int index, size_t n_so_far, unsigned int relative_flag, int* out, unsigned int* relative) {
+	if (index > 0) {
+		*out = index - 1;
+		return true;
+	}
+	if (index < 0) {
+		*out = (int)((long long)n_so_far + index);
+		*relative |= relative_flag;
+		return true;
+	}
+	return false;
+}
+
+// v, v/vt, v//vn or v/vt/vn
+static const char* parse_corner(const char* p, const char* end, const obj_chunk* chunk, obj_corner* corner) {
+	corner->v = corner->vt = corner->vn = OBJ_NO_INDEX;
+	corner->relative = 0;
+	int index;
+	p = parse_int(p, end, &index);
+	if (!p || !encode_index(index, chunk->positions.size() / 3, OBJ_RELATIVE_V, &corner->v, &corner->relative)) {
+		return NULL;
+	}
+	if (p < end && *p == '/') {
+		p++;
+		if (p < end && *p != '/') {
+			p = parse_int(p, end, &index);
+			if (!p || !encode_index(index, chunk->texcoords.size() / 2, OBJ_RELATIVE_VT, &corner->vt, &corner->relative)) {
+				return NULL;
+			}
+		}
+		if (p < end && *p == '/') {
+			p++;
+			p = parse_int(p, end, &index);
+			if (!p || !encode_index(index, chunk->normals.size() / 3, OBJ_RELATIVE_VN, &corner->vn, &corner->relative)) {
+				return NULL;
+			}
+		}
+	}
+	return p;
+}
+
+static bool at_line_end(const char* p, const char* end) { return p >= end || *p == '\n' || *p == '#'; }
+
+static void parse_chunk(obj_chunk* chunk) {
+	const char* p = chunk->begin;
+	const char* end = chunk->end;
+	chunk->n_lines = 0;
+	chunk->error_line = 0;
+	chunk->error = NULL;
+	while (p < end) {
+		chunk->n_lines++;
+		p = skip_space(p, end);
+		if (p + 1 < end && p[0] == 'v' && is_space(p[1])) {
+			float xyz[3];
+			p = parse_floats(p + 2, end, xyz, 3);
+			if (!p) {
+				chunk->error = "bad v";
+				break;
+			}
+			chunk->positions.insert(chunk->positions.end(), xyz, xyz + 3);
+		} else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+			float xyz[3];
+			p = parse_floats(p + 3, end, xyz, 3);
+			if (!p) {
+				chunk->error = "bad vn";
+				break;
+			}
+			chunk->normals.insert(chunk->normals.end(), xyz, xyz + 3);
+		} else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+			// the v is optional, so read u then take v if it's there
+			float uv[2] = { 0.0f, 0.0f };
+			p = parse_floats(p + 3, end, uv, 1);
+			if (!p) {
+				chunk->error = "bad vt";
+				break;
+			}
+			p = skip_space(p, end);
+			if (!at_line_end(p, end)) {
+				p = parse_float(p, end, &uv[1]);
+				if (!p) {
+					chunk->error = "bad vt";
+					break;
+				}
+			}
+			chunk->texcoords.insert(chunk->texcoords.end(), uv, uv + 2);
+		} else if (p + 1 < end && p[0] == 'f' && is_space(p[1])) {
+			// fan-triangulate as the corners are read
+			obj_corner first, previous, corner;
+			int n_corners = 0;
+			p = skip_space(p + 2, end);
+			while (!at_line_end(p, end)) {
+				p = parse_corner(p, end, chunk, &corner);
+				if (!p) {
+					break;
+				}
+				if (n_corners == 0) {
+					first = corner;
+				} else if (n_corners >= 2) {
+					chunk->corners.push_back(first);
+					chunk->corners.push_back(previous);
+					chunk->corners.push_back(corner);
+				}
+				previous = corner;
+				n_corners++;
+				p = skip_space(p, end);
+			}
+			if (!p) {
+				chunk->error = "bad f";
+				break;
+			}
+			if (n_corners < 3) {
+				chunk->error = "face with fewer than 3 corners";
+				break;
+			}
+		}
+		p = skip_line(p, end);
+	}
+	if (chunk->error) {
+		chunk->error_line = chunk->n_lines;
+	}
+}
+
+/*-----------------------------STITCHING-------------------------------------*/
+static inline bool resolve_index(int* index, bool relative, size_t first, size_t count) {
+	if (*index == OBJ_NO_INDEX) {
+		*index = -1;
+		return true;
+	}
+	long long global = relative ? (long long)first + *index : *index;
+	if (global < 0 || global >= (long long)count) {
+		return false;
+	}
+	*index = (int)global;
+	return true;
+}
+
+/* copies the chunk's elements into the whole-file arrays and turns its corners
+into 0-based whole-file indices, -1 where the face left vt or vn out */
+static bool resolve_chunk(obj_chunk* chunk, float* positions, float* normals, float* texcoords, size_t n_v, size_t n_vt, size_t n_vn) {
+	if (!chunk->positions.empty()) {
+		memcpy(positions + chunk->first_v * 3, chunk->positions.data(), chunk->positions.size() * sizeof(float));
+	}
+	if (!chunk->normals.empty()) {
+		memcpy(normals + chunk->first_vn * 3, chunk->normals.data(), chunk->normals.size() * sizeof(float));
+	}
+	if (!chunk->texcoords.empty()) {
+		memcpy(texcoords + chunk->first_vt * 2, chunk->texcoords.data(), chunk->texcoords.size() * sizeof(float));
+	}
+	for (size_t i = 0; i < chunk->corners.size(); i++) {
+		obj_corner* c = &chunk->corners[i];
+		if (!resolve_index(&c->v, (c->relative & OBJ_RELATIVE_V) != 0, chunk->first_v, n_v) ||
+			!resolve_index(&c->vt, (c->relative & OBJ_RELATIVE_VT) != 0, chunk->first_vt, n_vt) ||
+			!resolve_index(&c->vn, (c->relative & OBJ_RELATIVE_VN) != 0, chunk->first_vn, n_vn)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// runs job(0) to job(n - 1), one per thread, with job(0) on the calling thread
+template <typename F> static void run_jobs(int n, F job) {
+	std::vector<std::thread> workers;
+	for (int i = 1; i < n; i++) {
+		workers.push_back(std::thread(job, i));
+	}
+	job(0);
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+/*-----------------------------VERTEX DEDUPLICATION--------------------------*/
+struct corner_slot {
+	int v, vt, vn; // v -1 = empty
+	GLuint vertex;
+};
+
+static inline size_t hash_corner(int v, int vt, int vn) {
+	unsigned long long h = (unsigned int)v * 0x9E3779B97F4A7C15ull;
+	h ^= (unsigned int)vt * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+	h ^= (unsigned int)vn * 0x165667B19E3779F9ull + (h >> 32);
+	return (size_t)(h ^ (h >> 31));
+}
+
+/* open addressing with linear probing, kept at most half full. the key is the
+corner's 3 indices and the value its vertex number */
+struct corner_table {
+	std::vector<corner_slot> slots;
+	size_t mask;
+	size_t count;
+};
+
+static void corner_table_init(corner_table* table, size_t expected) {
+	size_t capacity = 16;
+	while (capacity < expected * 2) {
+		capacity *= 2;
+	}
+	corner_slot empty = { -1, -1, -1, 0 };
+	table->slots.assign(capacity, empty);
+	table->mask = capacity - 1;
+	table->count = 0;
+}
+
+static void corner_table_grow(corner_table* table) {
+	std::vector<corner_slot> old;
+	old.swap(table->slots);
+	corner_slot empty = { -1, -1, -1, 0 };
+	table->slots.assign(old.size() * 2, empty);
+	table->mask = table->slots.size() - 1;
+	for (size_t i = 0; i < old.size(); i++) {
+		if (old[i].v < 0) {
+			continue;
+		}
+		size_t s = hash_corner(old[i].v, old[i].vt, old[i].vn) & table->mask;
+		while (table->slots[s].v >= 0) {
+			s = (s + 1) & table->mask;
+		}
+		table->slots[s] = old[i];
+	}
+}
+
+// returns the vertex number for the corner, adding it as next_vertex if it's new
+static inline GLuint corner_table_insert(corner_table* table, const obj_corner* c, GLuint next_vertex, bool* added) {
+	size_t s = hash_corner(c->v, c->vt, c->vn) & table->mask;
+	for (;;) {
+		corner_slot* slot = &table->slots[s];
+		if (slot->v < 0) {
+			slot->v = c->v;
+			slot->vt = c->vt;
+			slot->vn = c->vn;
+			slot->vertex = next_vertex;
+			*added = true;
+			if (++table->count * 2 > table->slots.size()) {
+				corner_table_grow(table);
+			}
+			return next_vertex;
+		}
+		if (slot->v == c->v && slot->vt == c->vt && slot->vn == c->vn) {
+			*added = false;
+			return slot->vertex;
+		}
+		s = (s + 1) & table->mask;
+	}
+}
+
+/* walks the corners in file order, so vertices are numbered by first use.
+unique receives the first corner of each new vertex */
+static void deduplicate(const std::vector<obj_chunk>& chunks, size_t n_v, bool positions_only, std::vector<GLuint>* indices,
+	std::vector<obj_corner>* unique) {
+	if (positions_only) {
+		// the key is just v, so a flat remap table does the job of the hash table
+		std::vector<GLuint> remap(n_v, 0xFFFFFFFF);
+		for (size_t c = 0; c < chunks.size(); c++) {
+			const std::vector<obj_corner>& corners = chunks[c].corners;
+			for (size_t i = 0; i < corners.size(); i++) {
+				GLuint* vertex = &remap[corners[i].v];
+				if (*vertex == 0xFFFFFFFF) {
+					*vertex = (GLuint)unique->size();
+					unique->push_back(corners[i]);
+				}
+				indices->push_back(*vertex);
+			}
+		}
+		return;
+	}
+	corner_table table;
+	corner_table_init(&table, n_v + n_v / 2);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		const std::vector<obj_corner>& corners = chunks[c].corners;
+		for (size_t i = 0; i < corners.size(); i++) {
+			bool added;
+			GLuint vertex = corner_table_insert(&table, &corners[i], (GLuint)unique->size(), &added);
+			if (added) {
+				unique->push_back(corners[i]);
+			}
+			indices->push_back(vertex);
+		}
+	}
+}
+
+/*-----------------------------LOADER----------------------------------------*/
+bool parse_obj(const char* data, size_t size, obj_mesh* mesh, int n_threads) {
+	mesh->vertices.clear();
+	mesh->indices.clear();
+	mesh->n_vertices = 0;
+	if (n_threads <= 0) {
+		n_threads = (int)std::thread::hardware_concurrency();
+		if (n_threads <= 0) {
+			n_threads = 4;
+		}
+	}
+	size_t max_chunks = size / OBJ_MIN_CHUNK_BYTES + 1;
+	if ((size_t)n_threads > max_chunks) {
+		n_threads = (int)max_chunks;
+	}
+
+	// split at line starts, so a chunk can be empty if a line is very long
+	std::vector<obj_chunk> chunks(n_threads);
+	const char* end = data + size;
+	const char* p = data;
+	for (int i = 0; i < n_threads; i++) {
+		chunks[i].begin = p;
+		p = i == n_threads - 1 ? end : data + size / n_threads * (i + 1);
+		if (p < chunks[i].begin) {
+			p = chunks[i].begin;
+		}
+		if (p < end && p > data && p[-1] != '\n') {
+			p = skip_line(p, end);
+		}
+		chunks[i].end = p;
+	}
+
+	run_jobs(n_threads, [&](int i) { parse_chunk(&chunks[i]); });
+
+	size_t n_v = 0, n_vt = 0, n_vn = 0, n_corners = 0, first_line = 1;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		obj_chunk* c = &chunks[i];
+		if (c->error) {
+			gl_log_err("ERROR: obj line %u: %s\n", (unsigned int)(first_line + c->error_line - 1), c->error);
+			return false;
+		}
+		first_line += c->n_lines;
+		c->first_v = n_v;
+		c->first_vt = n_vt;
+		c->first_vn = n_vn;
+		n_v += c->positions.size() / 3;
+		n_vt += c->texcoords.size() / 2;
+		n_vn += c->normals.size() / 3;
+		n_corners += c->corners.size();
+	}
+	if (n_corners == 0) {
+		gl_log_err("ERROR: obj has no faces\n");
+		return false;
+	}
+
+	std::vector<float> positions(n_v * 3), normals(n_vn * 3), texcoords(n_vt * 2);
+	std::vector<char> resolved(chunks.size());
+	run_jobs(n_threads, [&](int i) {
+		resolved[i] = resolve_chunk(&chunks[i], positions.data(), normals.data(), texcoords.data(), n_v, n_vt, n_vn);
+		// the per-chunk copies aren't needed any more
+		std::vector<float>().swap(chunks[i].positions);
+		std::vector<float>().swap(chunks[i].normals);
+		std::vector<float>().swap(chunks[i].texcoords);
+	});
+	bool any_vt = false, any_vn = false;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (!resolved[i]) {
+			gl_log_err("ERROR: obj face index out of range\n");
+			return false;
+		}
+	}
+	for (size_t i = 0; i < chunks.size() && !(any_vt && any_vn); i++) {
+		const std::vector<obj_corner>& corners = chunks[i].corners;
+		for (size_t j = 0; j < corners.size(); j++) {
+			any_vt |= corners[j].vt >= 0;
+			any_vn |= corners[j].vn >= 0;
+		}
+	}
+
+	std::vector<obj_corner> unique;
+	unique.reserve(n_v);
+	mesh->indices.reserve(n_corners);
+	deduplicate(chunks, n_v, !any_vt && !any_vn, &mesh->indices, &unique);
+	std::vector<obj_chunk>().swap(chunks);
+
+	vertex_format_init(&mesh->format);
+	vertex_format_add(&mesh->format, OBJ_POSITION_LOCATION, 3, VA_FLOAT);
+	if (any_vn) {
+		vertex_format_add(&mesh->format, OBJ_NORMAL_LOCATION, 4, VA_INT_2_10_10_10);
+	}
+	if (any_vt) {
+		vertex_format_add(&mesh->format, OBJ_TEXCOORD_LOCATION, 2, VA_FLOAT);
+	}
+	mesh->has_normals = any_vn;
+	mesh->has_texcoords = any_vt;
+	mesh->n_vertices = unique.size();
+	mesh->vertices.resize(mesh->n_vertices * mesh->format.stride);
+
+	/* gather each vertex's attributes as floats, in vertex order, then pack.
+	both halves are independent per vertex so they're split across the threads */
+	size_t n_out = mesh->n_vertices;
+	std::vector<float> out_positions(n_out * 3), out_normals(any_vn ? n_out * 4 : 0), out_texcoords(any_vt ? n_out * 2 : 0);
+	size_t per_thread = (n_out + n_threads - 1) / n_threads;
+	run_jobs(n_threads, [&](int t) {
+		size_t first = per_thread * t;
+		size_t last = first + per_thread < n_out ? first + per_thread : n_out;
+		if (first >= last) {
+			return;
+		}
+		for (size_t i = first; i < last; i++) {
+			const obj_corner* c = &unique[i];
+			memcpy(&out_positions[i * 3], &positions[c->v * 3], 3 * sizeof(float));
+			if (any_vn) {
+				float* n = &out_normals[i * 4];
+				if (c->vn >= 0) {
+					memcpy(n, &normals[c->vn * 3], 3 * sizeof(float));
+				} else {
+					n[0] = n[1] = n[2] = 0.0f;
+				}
+				n[3] = 0.0f;
+			}
+			if (any_vt) {
+				float* uv = &out_texcoords[i * 2];
+				if (c->vt >= 0) {
+					memcpy(uv, &texcoords[c->vt * 2], 2 * sizeof(float));
+				} else {
+					uv[0] = uv[1] = 0.0f;
+				}
+			}
+		}
+		const float* sources[3];
+		int a = 0;
+		sources[a++] = &out_positions[first * 3];
+		if (any_vn) {
+			sources[a++] = &out_normals[first * 4];
+		}
+		if (any_vt) {
+			sources[a++] = &out_texcoords[first * 2];
+		}
+		pack_vertices(&mesh->format, sources, last - first, &mesh->vertices[first * mesh->format.stride]);
+	});
+
+	for (int i = 0; i < 3; i++) {
+		mesh->bounds_min[i] = out_positions[i];
+		mesh->bounds_max[i] = out_positions[i];
+	}
+	for (size_t v = 1; v < n_out; v++) {
+		for (int i = 0; i < 3; i++) {
+			float x = out_positions[v * 3 + i];
+			mesh->bounds_min[i] = x < mesh->bounds_min[i] ? x : mesh->bounds_min[i];
+			mesh->bounds_max[i] = x > mesh->bounds_max[i] ? x : mesh->bounds_max[i];
+		}
+	}
+	return true;
+}
+
+bool load_obj(const char* file_name, obj_mesh* mesh, int n_threads) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mapped_file mf;
+	if (!map_file(file_name, &mf)) {
+		return false;
+	}
+	bool ok = parse_obj(mf.data, mf.size, mesh, n_threads);
+	unmap_file(&mf);
+	if (!ok) {
+		gl_log_err("ERROR: could not load obj %s\n", file_name);
+		return false;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	gl_log("loaded %s: %u vertices, %u triangles, %u bytes a vertex, in %.1f ms\n", file_name, (unsigned int)mesh->n_vertices,
+		(unsigned int)(mesh->indices.size() / 3), (unsigned int)mesh->format.stride, ms);
+	return true;
+}
+
+GLuint create_vao_for_obj(const obj_mesh* mesh, GLuint* vbo, GLuint* ibo) {
+	glGenBuffers(1, vbo);
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, *vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh->vertices.size(), mesh->vertices.data(), GL_STATIC_DRAW);
+	GLuint vao = create_vao_for_format(&mesh->format, *vbo);
+	// the element buffer binding is part of the VAO, which is still bound
+	glGenBuffers(1, ibo);
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, *ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices.size() * sizeof(GLuint), mesh->indices.data(), GL_STATIC_DRAW);
+	return vao;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "vertex_format.h"
+#include <cstddef>
+#include <vector>
+
+/* Wavefront .obj loader. the file is memory-mapped and parsed in place - no
+iostreams, no strtof and no allocation per line. big files are split into
+chunks at line boundaries and the chunks are parsed on separate threads, then
+stitched together with prefix sums of the per-chunk v/vt/vn counts (which is
+also how negative, relative indices are resolved).
+
+every distinct v/vt/vn combination used by a face becomes one vertex, found
+through a hash table, and polygons are triangulated as fans. the result is one
+interleaved vertex buffer plus 32-bit indices, ready for glBufferData() or
+mesh_arena_add():
+
+  obj_mesh mesh;
+  if (load_obj("bunny.obj", &mesh)) {
+    GLuint vbo, ibo;
+    GLuint vao = create_vao_for_obj(&mesh, &vbo, &ibo);
+    ...
+    glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+  }
+
+only geometry is read - o, g, s, usemtl, mtllib, l and p lines are skipped. */
+
+#define OBJ_POSITION_LOCATION 0
+#define OBJ_NORMAL_LOCATION 1
+// after the instance matrix, which takes locations 2 to 5
+#define OBJ_TEXCOORD_LOCATION 6
+
+struct obj_mesh {
+	/* float3 position, then a 2_10_10_10 normal if the file has any, then a
+	float2 texture coordinate if it has any */
+	vertex_format format;
+	bool has_normals;
+	bool has_texcoords;
+	std::vector<unsigned char> vertices; // n_vertices * format.stride bytes
+	size_t n_vertices;
+	std::vector<GLuint> indices; // 3 per triangle
+	float bounds_min[3];
+	float bounds_max[3];
+};
+
+/* n_threads 0 means one per core. small files are always parsed on the calling
+thread. errors are written to the log */
+bool load_obj(const char* file_name, obj_mesh* mesh, int n_threads = 0);
+
+// same, from a file that's already in memory. data needn't be null-terminated
+bool parse_obj(const char* data, size_t size, obj_mesh* mesh, int n_threads = 0);
+
+// uploads the mesh and returns a VAO with its vertex and index buffers attached
+GLuint create_vao_for_obj(const obj_mesh* mesh, GLuint* vbo, GLuint* ibo);
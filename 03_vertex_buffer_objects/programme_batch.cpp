@@ -0,0 +1,179 @@
+#include "programme_batch.h"
+#include <atomic>
+#include <thread>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRY *max_shader_compiler_threads_proc)(GLuint count);
+
+static int g_parallel_compile = -1; // -1 = not checked yet
+
+// switches on driver-side parallel compiles if the context supports it
+static bool parallel_compile_supported() {
+	if (g_parallel_compile < 0) {
+		max_shader_compiler_threads_proc set_threads = NULL;
+		if (gl_extension_supported("GL_KHR_parallel_shader_compile")) {
+			set_threads = (max_shader_compiler_threads_proc)gl_proc_address("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (gl_extension_supported("GL_ARB_parallel_shader_compile")) {
+			set_threads = (max_shader_compiler_threads_proc)gl_proc_address("glMaxShaderCompilerThreadsARB");
+		}
+		g_parallel_compile = set_threads ? 1 : 0;
+		if (set_threads) {
+			// let the driver pick how many threads to use
+			set_threads(0xFFFFFFFF);
+		}
+		gl_log("parallel shader compile: %s\n", g_parallel_compile ? "yes" : "no");
+	}
+	return g_parallel_compile == 1;
+}
+
+int programme_batch_add(programme_batch* batch, const char* vert_file_name, const char* frag_file_name, const char* defines) {
+	programme_job job;
+	job.vert_file_name = vert_file_name;
+	job.frag_file_name = frag_file_name;
+	job.defines = defines ? defines : "";
+	job.vert_src.data = job.frag_src.data = NULL;
+	job.vert_src.size = job.frag_src.size = 0;
+	job.read_ok = false;
+	job.vert = job.frag = job.programme = 0;
+	job.state = PROGRAMME_QUEUED;
+	batch->jobs.push_back(job);
+	return (int)batch->jobs.size() - 1;
+}
+
+static void read_job_files(programme_job* job) {
+	job->read_ok = map_file(job->vert_file_name.c_str(), &job->vert_src);
+	if (job->read_ok) {
+		job->read_ok = map_file(job->frag_file_name.c_str(), &job->frag_src);
+		if (!job->read_ok) {
+			unmap_file(&job->vert_src);
+			return;
+		}
+		// touch every page now, on this thread, rather than inside glShaderSource
+		volatile char sum = 0;
+		for (size_t i = 0; i < job->vert_src.size; i += 4096) {
+			sum = sum + job->vert_src.data[i];
+		}
+		for (size_t i = 0; i < job->frag_src.size; i += 4096) {
+			sum = sum + job->frag_src.data[i];
+		}
+	}
+}
+
+void programme_batch_submit(programme_batch* batch) {
+	bool parallel = parallel_compile_supported();
+
+	// collect the jobs that haven't been submitted yet
+	std::vector<programme_job*> queued;
+	for (size_t i = 0; i < batch->jobs.size(); i++) {
+		if (batch->jobs[i].state == PROGRAMME_QUEUED) {
+			queued.push_back(&batch->jobs[i]);
+		}
+	}
+	if (queued.empty()) {
+		return;
+	}
+
+	// file reads on a small worker pool, each worker pulling the next job index
+	std::atomic<size_t> next(0);
+	unsigned int n_workers = std::thread::hardware_concurrency();
+	if (n_workers == 0) {
+		n_workers = 4;
+	}
+	if (n_workers > queued.size()) {
+		n_workers = (unsigned int)queued.size();
+	}
+	std::vector<std::thread> workers;
+	for (unsigned int w = 0; w < n_workers; w++) {
+		workers.push_back(std::thread([&]() {
+			for (size_t i = next++; i < queued.size(); i = next++) {
+				read_job_files(queued[i]);
+			}
+		}));
+	}
+	for (size_t w = 0; w < workers.size(); w++) {
+		workers[w].join();
+	}
+
+	// GL work has to happen on this thread. issue every compile...
+	for (size_t i = 0; i < queued.size(); i++) {
+		programme_job* job = queued[i];
+		if (!job->read_ok) {
+			job->state = PROGRAMME_FAILED;
+			continue;
+		}
+		const char* defines = job->defines.empty() ? NULL : job->defines.c_str();
+		job->vert = start_shader_compile(job->vert_src.data, job->vert_src.size, defines, GL_VERTEX_SHADER);
+		job->frag = start_shader_compile(job->frag_src.data, job->frag_src.size, defines, GL_FRAGMENT_SHADER);
+		unmap_file(&job->vert_src);
+		unmap_file(&job->frag_src);
+		job->state = PROGRAMME_BUILDING;
+	}
+	// ...then every link. linking doesn't need the compile results up front
+	for (size_t i = 0; i < queued.size(); i++) {
+		programme_job* job = queued[i];
+		if (job->state != PROGRAMME_BUILDING) {
+			continue;
+		}
+		job->programme = glCreateProgram();
+		glAttachShader(job->programme, job->vert);
+		glAttachShader(job->programme, job->frag);
+		glLinkProgram(job->programme);
+	}
+	gl_log("programme batch: issued %u programmes (%s)\n", (unsigned int)queued.size(), parallel ? "parallel" : "serial");
+}
+
+bool programme_batch_ready(programme_batch* batch, int handle) {
+	programme_job* job = &batch->jobs[handle];
+	if (job->state != PROGRAMME_BUILDING || g_parallel_compile != 1) {
+		return job->state != PROGRAMME_QUEUED;
+	}
+	GLint done = GL_FALSE;
+	glGetProgramiv(job->programme, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool programme_batch_poll(programme_batch* batch) {
+	for (size_t i = 0; i < batch->jobs.size(); i++) {
+		if (!programme_batch_ready(batch, (int)i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+GLuint programme_batch_get(programme_batch* batch, int handle) {
+	programme_job* job = &batch->jobs[handle];
+	if (job->state == PROGRAMME_BUILDING) {
+		GLint params = -1;
+		glGetProgramiv(job->programme, GL_LINK_STATUS, &params);
+		if (params == GL_TRUE) {
+			job->state = PROGRAMME_DONE;
+			gl_log("programme %u linked (%s, %s)\n", job->programme, job->vert_file_name.c_str(), job->frag_file_name.c_str());
+		}
+		else {
+			// find out which stage broke
+			GLuint shaders[2] = { job->vert, job->frag };
+			const char* names[2] = { job->vert_file_name.c_str(), job->frag_file_name.c_str() };
+			for (int i = 0; i < 2; i++) {
+				glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &params);
+				if (params != GL_TRUE) {
+					gl_log_err("ERROR: GL shader index %i (%s) did not compile\n", shaders[i], names[i]);
+					print_shader_info_log(shaders[i]);
+				}
+			}
+			gl_log_err("ERROR: could not link shader programme GL index%u\n", job->programme);
+			print_programme_info_log(job->programme);
+			glDeleteProgram(job->programme);
+			job->programme = 0;
+			job->state = PROGRAMME_FAILED;
+		}
+		glDeleteShader(job->vert);
+		glDeleteShader(job->frag);
+		job->vert = job->frag = 0;
+	}
+	return job->state == PROGRAMME_DONE ? job->programme : 0;
+}
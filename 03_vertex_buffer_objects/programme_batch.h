@@ -0,0 +1,55 @@
+#pragma once
+
+#include "gl_utils.h"
+#include <string>
+#include <vector>
+
+/* builds many programmes at once without stalling on each one. the shader
+files are read on a pool of worker threads, then every compile and every link
+is issued before any status is asked for, so a driver with parallel compilers
+can work on all of them together. with GL_KHR_parallel_shader_compile (or the
+ARB version) programme_batch_ready() can be polled without blocking; without it
+every programme reports ready and the first status query waits as usual.
+
+  programme_batch batch;
+  int a = programme_batch_add( &batch, "a_vs.glsl", "a_fs.glsl", NULL );
+  ...
+  programme_batch_submit( &batch );
+  while ( !programme_batch_poll( &batch ) ) { do other loading }
+  GLuint prog_a = programme_batch_get( &batch, a );
+*/
+
+enum programme_job_state { PROGRAMME_QUEUED, PROGRAMME_BUILDING, PROGRAMME_DONE, PROGRAMME_FAILED };
+
+struct programme_job {
+	std::string vert_file_name;
+	std::string frag_file_name;
+	std::string defines;
+	mapped_file vert_src;
+	mapped_file frag_src;
+	bool read_ok;
+	GLuint vert;
+	GLuint frag;
+	GLuint programme;
+	programme_job_state state;
+};
+
+struct programme_batch {
+	std::vector<programme_job> jobs;
+};
+
+// queue a programme. returns its handle in the batch. defines may be NULL
+int programme_batch_add(programme_batch* batch, const char* vert_file_name, const char* frag_file_name, const char* defines);
+
+// read all queued files in parallel then issue every compile and link
+void programme_batch_submit(programme_batch* batch);
+
+// true once the driver has finished the programme. never blocks
+bool programme_batch_ready(programme_batch* batch, int handle);
+
+// true once every programme in the batch is ready. never blocks
+bool programme_batch_poll(programme_batch* batch);
+
+/* checks the result, waiting if it isn't ready. returns the programme, or 0 if
+it failed to compile or link (the errors go to the log) */
+GLuint programme_batch_get(programme_batch* batch, int handle);
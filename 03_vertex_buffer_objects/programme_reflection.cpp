@@ -0,0 +1,196 @@
+#include "programme_reflection.h"
+#include "gl_utils.h"
+#include "shader_cache.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+static void insert_var(programme_reflection* refl, const std::string& name, GLint location, GLenum type, GLint size, bool is_uniform) {
+	reflected_var var;
+	var.name = name;
+	var.hash = hash_bytes(name.data(), name.size());
+	var.location = location;
+	var.type = type;
+	var.size = size;
+	var.is_uniform = is_uniform;
+	refl->vars.push_back(var);
+}
+
+// sizes the table to at most half full and re-inserts everything
+static void build_slots(programme_reflection* refl) {
+	size_t n_slots = 16;
+	while (n_slots < refl->vars.size() * 2) {
+		n_slots *= 2;
+	}
+	refl->slots.assign(n_slots, -1);
+	for (size_t i = 0; i < refl->vars.size(); i++) {
+		size_t slot = refl->vars[i].hash & (n_slots - 1);
+		while (refl->slots[slot] >= 0) {
+			slot = (slot + 1) & (n_slots - 1);
+		}
+		refl->slots[slot] = (int)i;
+	}
+}
+
+/* adds one active variable. arrays come back from GL as "name[0]"; they get an
+entry for "name" and for each "name[i]" */
+static void add_active_var(programme_reflection* refl, const char* name, GLint size, GLenum type, bool is_uniform) {
+	GLuint sp = refl->programme;
+	std::string base(name);
+	if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0) {
+		base.resize(base.size() - 3);
+	}
+	GLint location = is_uniform ? glGetUniformLocation(sp, base.c_str()) : glGetAttribLocation(sp, base.c_str());
+	insert_var(refl, base, location, type, size, is_uniform);
+	if (size > 1) {
+		for (int j = 0; j < size; j++) {
+			char index[16];
+			snprintf(index, sizeof(index), "[%i]", j);
+			std::string long_name = base + index;
+			location = is_uniform ? glGetUniformLocation(sp, long_name.c_str()) : glGetAttribLocation(sp, long_name.c_str());
+			insert_var(refl, long_name, location, type, 1, is_uniform);
+		}
+	}
+}
+
+bool build_programme_reflection(GLuint programme, programme_reflection* refl) {
+	refl->programme = programme;
+	refl->vars.clear();
+
+	GLint params = -1;
+	glGetProgramiv(programme, GL_LINK_STATUS, &params);
+	if (params != GL_TRUE) {
+		gl_log_err("ERROR: can not reflect unlinked programme %u\n", programme);
+		build_slots(refl);
+		return false;
+	}
+
+	// the name buffer is sized from the longest name, terminator included
+	GLint max_length = 0;
+	glGetProgramiv(programme, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+	std::vector<char> name(max_length > 0 ? max_length : 1);
+	glGetProgramiv(programme, GL_ACTIVE_ATTRIBUTES, &params);
+	for (int i = 0; i < params; i++) {
+		int actual_length = 0;
+		int size = 0;
+		GLenum type;
+		glGetActiveAttrib(programme, i, (GLsizei)name.size(), &actual_length, &size, &type, name.data());
+		add_active_var(refl, name.data(), size, type, false);
+	}
+
+	glGetProgramiv(programme, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	name.resize(max_length > 0 ? max_length : 1);
+	glGetProgramiv(programme, GL_ACTIVE_UNIFORMS, &params);
+	for (int i = 0; i < params; i++) {
+		int actual_length = 0;
+		int size = 0;
+		GLenum type;
+		glGetActiveUniform(programme, i, (GLsizei)name.size(), &actual_length, &size, &type, name.data());
+		add_active_var(refl, name.data(), size, type, true);
+	}
+
+	build_slots(refl);
+	gl_log("programme %u reflected: %u names\n", programme, (unsigned int)refl->vars.size());
+	return true;
+}
+
+static int find_var(const programme_reflection* refl, const char* name, bool is_uniform) {
+	if (refl->slots.empty()) {
+		return -1;
+	}
+	size_t mask = refl->slots.size() - 1;
+	unsigned long long hash = hash_bytes(name, strlen(name));
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+		int index = refl->slots[slot];
+		if (index < 0) {
+			return -1;
+		}
+		const reflected_var* var = &refl->vars[index];
+		if (var->hash == hash && var->is_uniform == is_uniform && var->name == name) {
+			return index;
+		}
+	}
+}
+
+int uniform_handle(const programme_reflection* refl, const char* name) {
+	return find_var(refl, name, true);
+}
+
+int attribute_handle(const programme_reflection* refl, const char* name) {
+	return find_var(refl, name, false);
+}
+
+GLint handle_location(const programme_reflection* refl, int handle) {
+	if (handle < 0 || handle >= (int)refl->vars.size()) {
+		return -1;
+	}
+	return refl->vars[handle].location;
+}
+
+/* the setters quietly ignore -1 handles, the same way glUniform*() ignores -1
+locations, so optional uniforms that got optimised out don't need checking */
+void set_uniform1i(const programme_reflection* refl, int handle, int i) {
+	if (handle < 0) {
+		return;
+	}
+	gl_state_uniform1i(refl->programme, refl->vars[handle].location, i);
+}
+
+void set_uniform1f(const programme_reflection* refl, int handle, float x) {
+	if (handle < 0) {
+		return;
+	}
+	assert(refl->vars[handle].type == GL_FLOAT);
+	gl_state_uniform1f(refl->programme, refl->vars[handle].location, x);
+}
+
+void set_uniform2f(const programme_reflection* refl, int handle, float x, float y) {
+	if (handle < 0) {
+		return;
+	}
+	assert(refl->vars[handle].type == GL_FLOAT_VEC2);
+	gl_state_uniform2f(refl->programme, refl->vars[handle].location, x, y);
+}
+
+void set_uniform3f(const programme_reflection* refl, int handle, float x, float y, float z) {
+	if (handle < 0) {
+		return;
+	}
+	assert(refl->vars[handle].type == GL_FLOAT_VEC3);
+	gl_state_uniform3f(refl->programme, refl->vars[handle].location, x, y, z);
+}
+
+void set_uniform4f(const programme_reflection* refl, int handle, float x, float y, float z, float w) {
+	if (handle < 0) {
+		return;
+	}
+	assert(refl->vars[handle].type == GL_FLOAT_VEC4);
+	gl_state_uniform4f(refl->programme, refl->vars[handle].location, x, y, z, w);
+}
+
+void set_uniform_mat4(const programme_reflection* refl, int handle, const float* m) {
+	if (handle < 0) {
+		return;
+	}
+	assert(refl->vars[handle].type == GL_FLOAT_MAT4);
+	gl_state_uniform_mat4(refl->programme, refl->vars[handle].location, m);
+}
+
+void print_all(GLuint sp) {
+	printf("----------------------\nshader programme %i info:\n", sp);
+	int params;
+	glGetProgramiv(sp, GL_LINK_STATUS, &params);
+	printf("GL_LINK_STATUS = %i\n", params);
+
+	glGetProgramiv(sp, GL_ATTACHED_SHADERS, &params);
+	printf("GL_ATTACHED_SHADERS = %i\n", params);
+
+	programme_reflection refl;
+	build_programme_reflection(sp, &refl);
+	for (size_t i = 0; i < refl.vars.size(); i++) {
+		const reflected_var* var = &refl.vars[i];
+		printf("%s type:%s name:%s location:%i\n", var->is_uniform ? "uniform" : "attribute", GL_type_to_string(var->type), var->name.c_str(), var->location);
+	}
+
+	print_programme_info_log(sp);
+}
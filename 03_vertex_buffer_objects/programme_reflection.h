@@ -0,0 +1,54 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <string>
+#include <vector>
+
+/* table of a programme's active attributes and uniforms, built once after
+linking from the same GL_ACTIVE_ATTRIBUTES / GL_ACTIVE_UNIFORMS walk that
+print_all() does. arrays get an entry for the bare name and for every
+"name[i]". look names up once at load time to get a handle, then the setters
+below go straight to the stored location - no strings and no
+glGetUniformLocation() in the frame loop.
+
+  programme_reflection refl;
+  build_programme_reflection( shader_programme, &refl );
+  int colour = uniform_handle( &refl, "inputColour" );
+  ...
+  set_uniform4f( &refl, colour, 1.0f, 0.0f, 0.0f, 1.0f );
+
+the setters use glProgramUniform*() so the programme doesn't need to be bound,
+and go through the gl_state cache so re-setting an unchanged value is free.
+rebuild the table whenever the programme is relinked or replaced. */
+
+struct reflected_var {
+	unsigned long long hash; // hash_bytes() of the name
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint size; // array length, 1 for non-arrays
+	bool is_uniform;
+};
+
+struct programme_reflection {
+	GLuint programme;
+	std::vector<reflected_var> vars;
+	std::vector<int> slots; // open-addressed hash table of indices into vars. -1 = empty
+};
+
+bool build_programme_reflection(GLuint programme, programme_reflection* refl);
+
+// handle for a uniform or attribute, or -1 if the programme doesn't have it
+int uniform_handle(const programme_reflection* refl, const char* name);
+int attribute_handle(const programme_reflection* refl, const char* name);
+
+// location for a handle, -1 for a bad handle
+GLint handle_location(const programme_reflection* refl, int handle);
+
+void set_uniform1i(const programme_reflection* refl, int handle, int i);
+void set_uniform1f(const programme_reflection* refl, int handle, float x);
+void set_uniform2f(const programme_reflection* refl, int handle, float x, float y);
+void set_uniform3f(const programme_reflection* refl, int handle, float x, float y, float z);
+void set_uniform4f(const programme_reflection* refl, int handle, float x, float y, float z, float w);
+// m is 16 floats in column order, like mat4::m
+void set_uniform_mat4(const programme_reflection* refl, int handle, const float* m);
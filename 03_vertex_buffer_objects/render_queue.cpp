@@ -0,0 +1,310 @@
+#include "render_queue.h"
+#include "gl_utils.h"
+#include <cstring>
+
+void render_queue_alloc(render_queue* rq, size_t max_items) {
+	rq->max_items = max_items;
+	rq->n_items = 0;
+	rq->instance_location = INSTANCE_MATRIX_LOCATION;
+	rq->items.resize(max_items);
+	rq->matrices.resize(max_items);
+	rq->keys.resize(max_items);
+	rq->sorted_keys.resize(max_items);
+	rq->keys_tmp.resize(max_items);
+	rq->order.resize(max_items);
+	rq->order_tmp.resize(max_items);
+	rq->sorted_matrices.resize(max_items);
+	rq->md_counts.resize(max_items);
+	rq->md_firsts.resize(max_items);
+	rq->md_offsets.resize(max_items);
+	rq->md_base_vertices.resize(max_items);
+	rq->runs.resize(max_items);
+	rq->commands.resize(max_items);
+	memset(&rq->stats, 0, sizeof(rq->stats));
+	memset(&rq->instances, 0, sizeof(rq->instances));
+	rq->use_indirect = false;
+	rq->indirect_buffer = 0;
+	rq->multi_draw_elements_indirect = NULL;
+}
+
+bool render_queue_create_gl(render_queue* rq) {
+	if (g_gl_caps.major == 0) {
+		detect_gl_caps();
+	}
+	rq->use_indirect = g_gl_caps.multi_draw_indirect;
+	if (rq->use_indirect) {
+		rq->multi_draw_elements_indirect = (multi_draw_elements_indirect_proc)gl_proc_address("glMultiDrawElementsIndirect");
+		// a driver can report the version or extension and still not hand out the function
+		rq->use_indirect = rq->multi_draw_elements_indirect != NULL;
+	}
+	if (rq->use_indirect) {
+		glGenBuffers(1, &rq->indirect_buffer);
+		gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, rq->indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, rq->max_items * sizeof(draw_elements_indirect_command), NULL, GL_STREAM_DRAW);
+	}
+	gl_log("render queue: %u items, %s\n", (unsigned int)rq->max_items, rq->use_indirect ? "multi draw indirect" : "multi draw");
+	return instance_stream_create(&rq->instances, rq->max_items);
+}
+
+bool render_queue_create(render_queue* rq, size_t max_items) {
+	render_queue_alloc(rq, max_items);
+	return render_queue_create_gl(rq);
+}
+
+void render_queue_destroy(render_queue* rq) {
+	if (rq->instances.vbo) {
+		instance_stream_destroy(&rq->instances);
+	}
+	if (rq->indirect_buffer) {
+		gl_state_forget_buffer(rq->indirect_buffer);
+		glDeleteBuffers(1, &rq->indirect_buffer);
+		rq->indirect_buffer = 0;
+	}
+	rq->max_items = rq->n_items = 0;
+}
+
+void render_queue_begin(render_queue* rq) {
+	rq->n_items = 0;
+	memset(&rq->stats, 0, sizeof(rq->stats));
+}
+
+// top 16 bits of the float. for non-negative floats the bit pattern sorts the same as the value
+static unsigned long long depth_bits(float depth) {
+	if (!(depth > 0.0f)) {
+		return 0;
+	}
+	unsigned int bits;
+	memcpy(&bits, &depth, 4);
+	return bits >> 16;
+}
+
+static unsigned long long mesh_bits(const render_item* item) {
+	unsigned int h = 2166136261u;
+	unsigned int parts[4] = { (unsigned int)item->index_type, (unsigned int)item->first, (unsigned int)item->count, (unsigned int)item->base_vertex };
+	for (int i = 0; i < 4; i++) {
+		h = (h ^ parts[i]) * 16777619u;
+	}
+	return (h ^ (h >> 15)) & 0x7FFF;
+}
+
+static unsigned long long make_key(const render_item* item, bool instanced) {
+	unsigned long long key = (unsigned long long)(item->programme & 0xFFF) << 52;
+	key |= (unsigned long long)(item->vao & 0x3FF) << 42;
+	key |= (unsigned long long)(item->material & 0x3FF) << 32;
+	key |= (unsigned long long)(instanced ? 1 : 0) << 31;
+	key |= mesh_bits(item) << 16;
+	key |= depth_bits(item->depth);
+	return key;
+}
+
+static bool push_item(render_queue* rq, const render_item* item, bool instanced) {
+	if (rq->n_items >= rq->max_items) {
+		rq->stats.dropped++;
+		return false;
+	}
+	size_t i = rq->n_items++;
+	rq->items[i] = *item;
+	rq->keys[i] = make_key(item, instanced);
+	rq->stats.items++;
+	return true;
+}
+
+bool render_queue_submit(render_queue* rq, const render_item* item) { return push_item(rq, item, false); }
+
+bool render_queue_submit_instance(render_queue* rq, const render_item* item, const mat4& model) {
+	if (!push_item(rq, item, true)) {
+		return false;
+	}
+	rq->matrices[rq->n_items - 1] = model;
+	return true;
+}
+
+/* LSD radix sort, 8 bits a pass. all 8 histograms are built in one read of
+the keys, and a pass is skipped when every key has the same byte there - which
+is most of them, e.g. with only a few programmes and VAOs. stable, so equal
+keys keep submission order */
+void render_queue_sort(render_queue* rq) {
+	size_t n = rq->n_items;
+	unsigned int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < n; i++) {
+		unsigned long long key = rq->keys[i];
+		for (int d = 0; d < 8; d++) {
+			counts[d][(key >> (d * 8)) & 0xFF]++;
+		}
+		rq->order[i] = (unsigned int)i;
+	}
+	// sorted on a copy, so rq->keys stays lined up with rq->items
+	if (n > 0) {
+		memcpy(rq->sorted_keys.data(), rq->keys.data(), n * sizeof(unsigned long long));
+	}
+	unsigned long long* keys = rq->sorted_keys.data();
+	unsigned long long* keys_tmp = rq->keys_tmp.data();
+	unsigned int* order = rq->order.data();
+	unsigned int* order_tmp = rq->order_tmp.data();
+	for (int d = 0; d < 8; d++) {
+		int shift = d * 8;
+		if (n == 0 || counts[d][(keys[0] >> shift) & 0xFF] == n) {
+			continue;
+		}
+		unsigned int offsets[256];
+		unsigned int total = 0;
+		for (int b = 0; b < 256; b++) {
+			offsets[b] = total;
+			total += counts[d][b];
+		}
+		for (size_t i = 0; i < n; i++) {
+			unsigned int slot = offsets[(keys[i] >> shift) & 0xFF]++;
+			keys_tmp[slot] = keys[i];
+			order_tmp[slot] = order[i];
+		}
+		unsigned long long* k = keys;
+		keys = keys_tmp;
+		keys_tmp = k;
+		unsigned int* o = order;
+		order = order_tmp;
+		order_tmp = o;
+	}
+	// an odd number of passes leaves the result in the scratch arrays
+	if (keys != rq->sorted_keys.data()) {
+		rq->sorted_keys.swap(rq->keys_tmp);
+		rq->order.swap(rq->order_tmp);
+	}
+}
+
+static bool same_state(const render_item* a, const render_item* b) {
+	return a->programme == b->programme && a->vao == b->vao && a->material == b->material;
+}
+
+static bool same_mesh(const render_item* a, const render_item* b) {
+	return a->index_type == b->index_type && a->first == b->first && a->count == b->count && a->base_vertex == b->base_vertex;
+}
+
+static bool is_instanced(const render_queue* rq, unsigned int sorted_index) { return (rq->sorted_keys[sorted_index] >> 31) & 1; }
+
+static void draw_single(const render_item* item) {
+	if (item->index_type) {
+		glDrawElementsBaseVertex(GL_TRIANGLES, item->count, item->index_type, (const GLvoid*)(size_t)item->first, item->base_vertex);
+	} else {
+		glDrawArrays(GL_TRIANGLES, item->first, item->count);
+	}
+}
+
+static GLuint index_size(GLenum index_type) {
+	switch (index_type) {
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT: return 2;
+	default: break;
+	}
+	return 4;
+}
+
+static void draw_multi(render_queue* rq, const render_run* run) {
+	const unsigned int* order = rq->order.data();
+	const render_item* first = &rq->items[order[run->start]];
+	GLsizei n = (GLsizei)run->length;
+	if (first->index_type && rq->use_indirect) {
+		// the commands went up with the rest of the frame's. the 'pointer' is a byte offset into the indirect buffer
+		const GLvoid* offset = (const GLvoid*)(run->first_command * sizeof(draw_elements_indirect_command));
+		gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, rq->indirect_buffer);
+		rq->multi_draw_elements_indirect(GL_TRIANGLES, first->index_type, offset, n, 0);
+		rq->stats.indirect_draws++;
+		return;
+	}
+	/* without indirect draws the driver still takes the whole run in one call.
+	glMultiDrawElementsBaseVertex() is core since 3.2 */
+	for (GLsizei k = 0; k < n; k++) {
+		const render_item* item = &rq->items[order[run->start + k]];
+		rq->md_counts[k] = item->count;
+		rq->md_firsts[k] = item->first;
+		rq->md_offsets[k] = (const GLvoid*)(size_t)item->first;
+		rq->md_base_vertices[k] = item->base_vertex;
+	}
+	if (first->index_type) {
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, rq->md_counts.data(), first->index_type, rq->md_offsets.data(), n, rq->md_base_vertices.data());
+	} else {
+		glMultiDrawArrays(GL_TRIANGLES, rq->md_firsts.data(), rq->md_counts.data(), n);
+	}
+	rq->stats.multi_draws++;
+}
+
+/* two passes: the first splits the sorted items into runs and builds all the
+instance matrices and indirect commands so that each goes to GL in a single
+upload, the second issues the draws */
+void render_queue_execute(render_queue* rq) {
+	render_queue_sort(rq);
+	size_t n = rq->n_items;
+	const unsigned int* order = rq->order.data();
+
+	size_t n_runs = 0;
+	unsigned int n_matrices = 0;
+	unsigned int n_commands = 0;
+	size_t i = 0;
+	while (i < n) {
+		const render_item* first = &rq->items[order[i]];
+		bool instanced = is_instanced(rq, (unsigned int)i);
+		size_t j = i + 1;
+		while (j < n && is_instanced(rq, (unsigned int)j) == instanced) {
+			const render_item* item = &rq->items[order[j]];
+			if (!same_state(first, item) || item->index_type != first->index_type || (instanced && !same_mesh(first, item))) {
+				break;
+			}
+			j++;
+		}
+		render_run* run = &rq->runs[n_runs++];
+		run->start = (unsigned int)i;
+		run->length = (unsigned int)(j - i);
+		run->instanced = instanced;
+		run->first_matrix = n_matrices;
+		run->first_command = n_commands;
+		if (instanced) {
+			for (size_t k = i; k < j; k++) {
+				rq->sorted_matrices[n_matrices++] = rq->matrices[order[k]];
+			}
+		} else if (rq->use_indirect && first->index_type && run->length > 1) {
+			for (size_t k = i; k < j; k++) {
+				const render_item* item = &rq->items[order[k]];
+				draw_elements_indirect_command* cmd = &rq->commands[n_commands++];
+				cmd->count = (GLuint)item->count;
+				cmd->instance_count = 1;
+				cmd->first_index = (GLuint)item->first / index_size(item->index_type);
+				cmd->base_vertex = item->base_vertex;
+				cmd->base_instance = 0;
+			}
+		}
+		i = j;
+	}
+	if (n_matrices > 0) {
+		instance_stream_upload(&rq->instances, rq->sorted_matrices.data(), n_matrices);
+	}
+	if (n_commands > 0) {
+		gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, rq->indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, rq->max_items * sizeof(draw_elements_indirect_command), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, n_commands * sizeof(draw_elements_indirect_command), rq->commands.data());
+	}
+
+	for (size_t r = 0; r < n_runs; r++) {
+		const render_run* run = &rq->runs[r];
+		const render_item* first = &rq->items[order[run->start]];
+		gl_state_use_programme(first->programme);
+		gl_state_bind_vao(first->vao);
+		gl_state_bind_texture(0, first->material);
+
+		if (run->instanced) {
+			GLsizei count = (GLsizei)run->length;
+			instance_stream_point(&rq->instances, rq->instance_location, run->first_matrix);
+			if (first->index_type) {
+				glDrawElementsInstancedBaseVertex(
+					GL_TRIANGLES, first->count, first->index_type, (const GLvoid*)(size_t)first->first, count, first->base_vertex);
+			} else {
+				glDrawArraysInstanced(GL_TRIANGLES, first->first, first->count, count);
+			}
+			rq->stats.instanced_draws++;
+		} else if (run->length == 1) {
+			draw_single(first);
+		} else {
+			draw_multi(rq, run);
+		}
+		rq->stats.draw_calls++;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "instancing.h"
+#include "maths_funcs.h"
+#include <vector>
+
+/* collects a frame's draws, sorts them to cut state changes and merges what
+it can before anything reaches GL.
+
+  render_queue rq;
+  render_queue_create( &rq, 100000 );
+  each frame:
+    render_queue_begin( &rq );
+    render_queue_submit( &rq, &item );                 // plain draw
+    render_queue_submit_instance( &rq, &item, model ); // draw with a model matrix
+    render_queue_execute( &rq );
+
+items are sorted on a 64-bit key, most significant first:
+  programme 12 bits | vao 10 | material 10 | instanced 1 | mesh range 15 | depth 16
+so programme changes are the rarest, then VAO, then texture, and within a
+state group equal meshes end up next to each other, nearest first. the key
+fields are GL names and hashes cut down to size, so two different values can
+share a key field - that only costs a merge opportunity, never correctness,
+because execution compares the real values.
+
+after sorting, a run of items with the same state and the same mesh range that
+were submitted with a model matrix becomes one instanced draw. those matrices
+are gathered into a single instance buffer upload per frame and the VAO is
+expected to read them at INSTANCE_MATRIX_LOCATION (see
+test_instanced_vs.glsl). a run of plain items with the same state becomes one
+glMultiDrawElementsBaseVertex() or glMultiDrawArrays(). when the context has
+multi draw indirect (see g_gl_caps) indexed runs are written out as
+draw_elements_indirect_command structs instead, all of the frame's commands go
+up in one upload, and each run is one glMultiDrawElementsIndirect() call.
+
+every array is allocated by render_queue_create(). a frame never allocates:
+submissions past max_items are dropped and counted. render_queue_create() is
+render_queue_alloc() then render_queue_create_gl(); the first on its own is
+enough to submit and sort without a context */
+
+struct render_item {
+	GLuint programme;
+	GLuint vao;
+	GLuint material;   // GL_TEXTURE_2D for texture unit 0, or 0
+	float depth;       // distance from the camera, >= 0
+	GLenum index_type; // GL_UNSIGNED_INT, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE, or 0 for glDrawArrays
+	GLint first;       // first vertex, or byte offset into the element buffer for indexed draws
+	GLsizei count;     // vertices or indices
+	GLint base_vertex; // indexed draws only
+};
+
+// the layout glMultiDrawElementsIndirect() reads
+struct draw_elements_indirect_command {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+// a sorted stretch of items that becomes one draw call
+struct render_run {
+	unsigned int start;
+	unsigned int length;
+	bool instanced;
+	unsigned int first_matrix;  // instanced runs
+	unsigned int first_command; // indirect runs
+};
+
+typedef void (APIENTRY *multi_draw_elements_indirect_proc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+struct render_queue_stats {
+	unsigned int items;
+	unsigned int dropped;
+	unsigned int draw_calls;
+	unsigned int instanced_draws;
+	unsigned int multi_draws;
+	unsigned int indirect_draws;
+};
+
+struct render_queue {
+	size_t max_items;
+	size_t n_items;
+	GLuint instance_location;
+	instance_stream instances;
+	// multi draw indirect path. off if the context doesn't have it
+	bool use_indirect;
+	GLuint indirect_buffer;
+	multi_draw_elements_indirect_proc multi_draw_elements_indirect;
+	// all sized to max_items up front
+	std::vector<render_item> items;
+	std::vector<mat4> matrices; // by item, instanced items only
+	std::vector<unsigned long long> keys; // by item, in submission order
+	std::vector<unsigned long long> sorted_keys; // sorted_keys[i] belongs to item order[i]
+	std::vector<unsigned long long> keys_tmp;
+	std::vector<unsigned int> order; // item indices in sorted order
+	std::vector<unsigned int> order_tmp;
+	std::vector<mat4> sorted_matrices;
+	std::vector<GLsizei> md_counts;
+	std::vector<GLint> md_firsts;
+	std::vector<const GLvoid*> md_offsets;
+	std::vector<GLint> md_base_vertices;
+	std::vector<render_run> runs;
+	std::vector<draw_elements_indirect_command> commands;
+	render_queue_stats stats;
+};
+
+bool render_queue_create(render_queue* rq, size_t max_items);
+
+// sizes every array and clears the stats. no GL calls
+void render_queue_alloc(render_queue* rq, size_t max_items);
+
+/* picks the multi draw path and makes the instance buffer and indirect buffer,
+after render_queue_alloc() */
+bool render_queue_create_gl(render_queue* rq);
+
+void render_queue_destroy(render_queue* rq);
+
+void render_queue_begin(render_queue* rq);
+
+bool render_queue_submit(render_queue* rq, const render_item* item);
+
+bool render_queue_submit_instance(render_queue* rq, const render_item* item, const mat4& model);
+
+/* sorts into rq->order and rq->sorted_keys, leaving the submitted items and
+keys alone, so it can be called any number of times. done by
+render_queue_execute(), exposed for inspection */
+void render_queue_sort(render_queue* rq);
+
+// sorts, merges and issues the frame's draws through the gl_state cache
+void render_queue_execute(render_queue* rq);
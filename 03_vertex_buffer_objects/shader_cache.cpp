@@ -0,0 +1,212 @@
+#include "shader_cache.h"
+#include "gl_utils.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define FNV_PRIME 1099511628211ULL
+#define SHADER_CACHE_MAGIC 0x42505347 // "GSPB"
+#define SHADER_CACHE_VERSION 1
+
+// header at the front of every cache file, followed by binary_length bytes
+struct shader_cache_header {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int binary_format;
+	unsigned int binary_length;
+	unsigned long long key; // guards against hash file name collisions
+};
+
+static std::atomic<unsigned long long> g_cache_hits(0);
+static std::atomic<unsigned long long> g_cache_misses(0);
+static std::atomic<unsigned long long> g_cache_rejected(0);
+
+void shader_cache_get_stats(shader_cache_stats* stats) {
+	stats->hits = g_cache_hits.load();
+	stats->misses = g_cache_misses.load();
+	stats->rejected = g_cache_rejected.load();
+}
+
+unsigned long long hash_bytes(const void* data, size_t length, unsigned long long hash) {
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static unsigned long long hash_string(const char* str, unsigned long long hash) {
+	if (!str) {
+		str = "";
+	}
+	// include the terminator so "ab" + "c" and "a" + "bc" differ
+	return hash_bytes(str, strlen(str) + 1, hash);
+}
+
+static void cache_file_name(unsigned long long key, char* file_name, size_t max_len) {
+	snprintf(file_name, max_len, "%s/%016llx.bin", SHADER_CACHE_DIR, key);
+}
+
+/* creates a programme from a cache file. 0 if there is no usable entry. rejected
+is set if there was a file but it was corrupt or the driver turned it down */
+static GLuint load_cached_programme(unsigned long long key, bool* rejected) {
+	char file_name[256];
+	cache_file_name(key, file_name, sizeof(file_name));
+	FILE* file = fopen(file_name, "rb");
+	if (!file) {
+		return 0;
+	}
+	*rejected = true;
+
+	// the length in the header is only trusted as far as the file actually goes
+	long file_size = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		file_size = ftell(file);
+	}
+	rewind(file);
+
+	shader_cache_header header;
+	GLuint programme = 0;
+	if (file_size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC &&
+		header.version == SHADER_CACHE_VERSION && header.key == key && header.binary_length > 0 &&
+		header.binary_length <= (unsigned long)(file_size - (long)sizeof(header))) {
+		void* binary = malloc(header.binary_length);
+		if (binary && fread(binary, 1, header.binary_length, file) == header.binary_length) {
+			programme = glCreateProgram();
+			glProgramBinary(programme, (GLenum)header.binary_format, binary, (GLsizei)header.binary_length);
+			GLint params = -1;
+			glGetProgramiv(programme, GL_LINK_STATUS, &params);
+			if (params != GL_TRUE) {
+				gl_log("programme binary %s rejected by driver. rebuilding\n", file_name);
+				glDeleteProgram(programme);
+				programme = 0;
+			}
+		}
+		free(binary);
+	}
+	fclose(file);
+	return programme;
+}
+
+static void store_cached_programme(unsigned long long key, GLuint programme) {
+	GLint length = 0;
+	glGetProgramiv(programme, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	void* binary = malloc(length);
+	if (!binary) {
+		return;
+	}
+	GLenum format = 0;
+	GLsizei actual_length = 0;
+	glGetProgramBinary(programme, length, &actual_length, &format, binary);
+
+#ifdef _WIN32
+	_mkdir(SHADER_CACHE_DIR);
+#else
+	mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+	// write to a temporary name then rename, so a crash never leaves half a file behind
+	char file_name[256], tmp_name[260];
+	cache_file_name(key, file_name, sizeof(file_name));
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", file_name);
+	FILE* file = fopen(tmp_name, "wb");
+	if (!file) {
+		gl_log_err("ERROR: could not open %s for writing\n", tmp_name);
+		free(binary);
+		return;
+	}
+	shader_cache_header header;
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.binary_format = format;
+	header.binary_length = (unsigned int)actual_length;
+	header.key = key;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, actual_length, file) == (size_t)actual_length;
+	ok = (fclose(file) == 0) && ok;
+	free(binary);
+#ifdef _WIN32
+	// rename() won't replace an existing file here. POSIX rename swaps it in atomically
+	remove(file_name);
+#endif
+	if (!ok || rename(tmp_name, file_name) != 0) {
+		gl_log_err("ERROR: could not write programme cache file %s\n", file_name);
+		remove(tmp_name);
+		return;
+	}
+	gl_log("wrote programme binary %s (%i bytes)\n", file_name, actual_length);
+}
+
+GLuint create_programme_from_files_cached(const char* vert_file_name, const char* frag_file_name, const char* defines) {
+	mapped_file vert_src, frag_src;
+	if (!map_file(vert_file_name, &vert_src)) {
+		return 0;
+	}
+	if (!map_file(frag_file_name, &frag_src)) {
+		unmap_file(&vert_src);
+		return 0;
+	}
+
+	GLint n_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+	bool use_cache = n_formats > 0;
+
+	unsigned long long key = FNV_OFFSET_BASIS;
+	key = hash_string((const char*)glGetString(GL_VENDOR), key);
+	key = hash_string((const char*)glGetString(GL_RENDERER), key);
+	key = hash_string((const char*)glGetString(GL_VERSION), key);
+	key = hash_string(defines, key);
+	key = hash_bytes(vert_src.data, vert_src.size, key);
+	key = hash_string("", key);
+	key = hash_bytes(frag_src.data, frag_src.size, key);
+
+	bool rejected = false;
+	GLuint programme = use_cache ? load_cached_programme(key, &rejected) : 0;
+	if (programme) {
+		g_cache_hits++;
+		gl_log("programme %u loaded from cache %016llx (%s, %s)\n", programme, key, vert_file_name, frag_file_name);
+		unmap_file(&vert_src);
+		unmap_file(&frag_src);
+		return programme;
+	}
+
+	g_cache_misses++;
+	if (rejected) {
+		g_cache_rejected++;
+	}
+
+	GLuint vert, frag;
+	bool ok = create_shader_from_source(vert_file_name, vert_src.data, vert_src.size, defines, &vert, GL_VERTEX_SHADER);
+	ok = create_shader_from_source(frag_file_name, frag_src.data, frag_src.size, defines, &frag, GL_FRAGMENT_SHADER) && ok;
+	unmap_file(&vert_src);
+	unmap_file(&frag_src);
+	if (!ok) {
+		glDeleteShader(vert);
+		glDeleteShader(frag);
+		return 0;
+	}
+
+	programme = glCreateProgram();
+	// has to be set before linking or the driver may not keep a binary around
+	if (use_cache) {
+		glProgramParameteri(programme, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	if (!link_programme(programme, vert, frag)) {
+		glDeleteShader(vert);
+		glDeleteShader(frag);
+		glDeleteProgram(programme);
+		return 0;
+	}
+	if (use_cache) {
+		store_cached_programme(key, programme);
+	}
+	return programme;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <cstddef>
+
+/* on-disk cache of linked programme binaries. a programme is keyed on a hash of
+its shader sources, the defines, and the GL vendor/renderer/version strings, so
+a driver update or a shader edit simply misses the cache. on a hit the binary
+goes straight back in with glProgramBinary(); if the driver rejects it the
+programme is compiled and linked from source as normal and the entry is
+rewritten. */
+#define SHADER_CACHE_DIR "shader_cache"
+
+/* same as create_programme_from_files() but tries the cache first. defines may
+be NULL. returns 0 if the programme could not be built */
+GLuint create_programme_from_files_cached(const char* vert_file_name, const char* frag_file_name, const char* defines);
+
+// counts since the program started, across all threads' calls
+struct shader_cache_stats {
+	unsigned long long hits;     // programmes restored with glProgramBinary()
+	unsigned long long misses;   // compiled and linked from source
+	unsigned long long rejected; // of the misses, entries that were there but unusable
+};
+
+void shader_cache_get_stats(shader_cache_stats* stats);
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
+// 64-bit FNV-1a, chained by passing the previous result as hash
+unsigned long long hash_bytes(const void* data, size_t length, unsigned long long hash = FNV_OFFSET_BASIS);
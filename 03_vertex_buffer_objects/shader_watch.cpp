@@ -0,0 +1,214 @@
+#include "shader_watch.h"
+#include <chrono>
+#include <cstring>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
+#define SHADER_WATCH_POLL_MS 250
+
+// splits "dir/name.glsl" into "dir" and "name.glsl". no directory gives "."
+static void split_path(const std::string& path, std::string* dir, std::string* name) {
+	size_t slash = path.find_last_of("/\\");
+	if (slash == std::string::npos) {
+		*dir = ".";
+		*name = path;
+	}
+	else {
+		*dir = path.substr(0, slash);
+		*name = path.substr(slash + 1);
+	}
+}
+
+// marks every programme using dir/name. caller holds the mutex
+static void mark_dirty(shader_watcher* watcher, const std::string& dir, const std::string& name) {
+	for (size_t i = 0; i < watcher->programmes.size(); i++) {
+		watched_programme* wp = &watcher->programmes[i];
+		const std::string* files[2] = { &wp->vert_file_name, &wp->frag_file_name };
+		for (int f = 0; f < 2; f++) {
+			std::string file_dir, file_name;
+			split_path(*files[f], &file_dir, &file_name);
+			if (file_dir == dir && file_name == name) {
+				wp->dirty = true;
+			}
+		}
+	}
+}
+
+#ifdef __linux__
+/* directories are watched rather than the files themselves because most editors
+save by writing a new file and renaming it over the old one, which would
+silently drop a watch on the file */
+static void watch_thread_main(shader_watcher* watcher) {
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (watcher->running.load()) {
+		struct pollfd pfd;
+		pfd.fd = watcher->inotify_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, SHADER_WATCH_POLL_MS) <= 0) {
+			continue;
+		}
+		ssize_t len = read(watcher->inotify_fd, buffer, sizeof(buffer));
+		if (len <= 0) {
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(watcher->mutex);
+		for (char* p = buffer; p < buffer + len;) {
+			struct inotify_event* event = (struct inotify_event*)p;
+			if (event->len > 0) {
+				for (size_t i = 0; i < watcher->dirs.size(); i++) {
+					if (watcher->dirs[i].wd == event->wd) {
+						mark_dirty(watcher, watcher->dirs[i].path, event->name);
+					}
+				}
+			}
+			p += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+#else
+static long long file_time(const std::string& path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return 0;
+	}
+	return (long long)st.st_mtime;
+}
+
+// no inotify - compare modification times a few times a second
+static void watch_thread_main(shader_watcher* watcher) {
+	std::vector<long long> times;
+	while (watcher->running.load()) {
+		{
+			std::lock_guard<std::mutex> lock(watcher->mutex);
+			size_t n = watcher->programmes.size();
+			times.resize(n * 2, -1);
+			for (size_t i = 0; i < n; i++) {
+				watched_programme* wp = &watcher->programmes[i];
+				long long t[2] = { file_time(wp->vert_file_name), file_time(wp->frag_file_name) };
+				for (int f = 0; f < 2; f++) {
+					if (times[i * 2 + f] >= 0 && t[f] != times[i * 2 + f]) {
+						wp->dirty = true;
+					}
+					times[i * 2 + f] = t[f];
+				}
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_POLL_MS));
+	}
+}
+#endif
+
+bool shader_watch_start(shader_watcher* watcher) {
+	watcher->inotify_fd = -1;
+#ifdef __linux__
+	watcher->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher->inotify_fd < 0) {
+		gl_log_err("ERROR: could not start inotify for shader watching\n");
+		return false;
+	}
+#endif
+	watcher->running.store(true);
+	watcher->thread = std::thread(watch_thread_main, watcher);
+	gl_log("shader watcher started\n");
+	return true;
+}
+
+void shader_watch_stop(shader_watcher* watcher) {
+	if (!watcher->running.exchange(false)) {
+		return;
+	}
+	if (watcher->thread.joinable()) {
+		watcher->thread.join();
+	}
+#ifdef __linux__
+	if (watcher->inotify_fd >= 0) {
+		close(watcher->inotify_fd);
+		watcher->inotify_fd = -1;
+	}
+#endif
+	watcher->dirs.clear();
+}
+
+int shader_watch_add(shader_watcher* watcher, const char* vert_file_name, const char* frag_file_name, GLuint programme) {
+	std::lock_guard<std::mutex> lock(watcher->mutex);
+	watched_programme wp;
+	wp.vert_file_name = vert_file_name;
+	wp.frag_file_name = frag_file_name;
+	wp.programme = programme;
+	wp.dirty = false;
+	watcher->programmes.push_back(wp);
+
+#ifdef __linux__
+	const std::string* files[2] = { &wp.vert_file_name, &wp.frag_file_name };
+	for (int f = 0; f < 2; f++) {
+		std::string dir, name;
+		split_path(*files[f], &dir, &name);
+		bool found = false;
+		for (size_t i = 0; i < watcher->dirs.size(); i++) {
+			found = found || watcher->dirs[i].path == dir;
+		}
+		if (found) {
+			continue;
+		}
+		watched_dir wd;
+		wd.path = dir;
+		wd.wd = inotify_add_watch(watcher->inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd.wd < 0) {
+			gl_log_err("ERROR: could not watch directory %s\n", dir.c_str());
+			continue;
+		}
+		watcher->dirs.push_back(wd);
+	}
+#endif
+	return (int)watcher->programmes.size() - 1;
+}
+
+GLuint shader_watch_programme(shader_watcher* watcher, int handle) {
+	std::lock_guard<std::mutex> lock(watcher->mutex);
+	return watcher->programmes[handle].programme;
+}
+
+int shader_watch_update(shader_watcher* watcher) {
+	// take the list of changed programmes first so the file thread isn't held up by compiling
+	std::vector<int> changed;
+	std::vector<watched_programme> sources;
+	{
+		std::lock_guard<std::mutex> lock(watcher->mutex);
+		for (size_t i = 0; i < watcher->programmes.size(); i++) {
+			if (watcher->programmes[i].dirty) {
+				watcher->programmes[i].dirty = false;
+				changed.push_back((int)i);
+				sources.push_back(watcher->programmes[i]);
+			}
+		}
+	}
+
+	int n_swapped = 0;
+	for (size_t i = 0; i < changed.size(); i++) {
+		const watched_programme* wp = &sources[i];
+		gl_log("reloading programme from %s and %s\n", wp->vert_file_name.c_str(), wp->frag_file_name.c_str());
+		GLuint vert = 0, frag = 0, programme = 0;
+		bool ok = create_shader(wp->vert_file_name.c_str(), &vert, GL_VERTEX_SHADER);
+		ok = ok && create_shader(wp->frag_file_name.c_str(), &frag, GL_FRAGMENT_SHADER);
+		ok = ok && create_programme(vert, frag, &programme);
+		if (!ok) {
+			gl_log_err("ERROR: reload failed - keeping programme %u\n", wp->programme);
+			glDeleteShader(vert);
+			glDeleteShader(frag);
+			glDeleteProgram(programme);
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(watcher->mutex);
+		GLuint old_programme = watcher->programmes[changed[i]].programme;
+		watcher->programmes[changed[i]].programme = programme;
+		// the old one may still be bound. GL defers the delete until it isn't
+		gl_state_forget_programme(old_programme);
+		glDeleteProgram(old_programme);
+		n_swapped++;
+	}
+	return n_swapped;
+}
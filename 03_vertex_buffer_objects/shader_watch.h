@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gl_utils.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* reloads shader programmes when their source files change on disk. a
+background thread waits for file changes (inotify on linux, polling file times
+elsewhere) and marks the affected programmes. call shader_watch_update() once
+per frame, between frames, on the GL thread: it rebuilds just the marked
+programmes with create_shader() / create_programme() and swaps each one in only
+if it built - a broken edit keeps the old programme running.
+
+  shader_watcher watcher;
+  shader_watch_start( &watcher );
+  int h = shader_watch_add( &watcher, "test_vs.glsl", "test_fs.glsl", shader_programme );
+  while ( ... ) {
+    shader_watch_update( &watcher );
+    gl_state_use_programme( shader_watch_programme( &watcher, h ) );
+    ...
+  }
+  shader_watch_stop( &watcher );
+*/
+
+struct watched_programme {
+	std::string vert_file_name;
+	std::string frag_file_name;
+	GLuint programme;
+	bool dirty; // guarded by shader_watcher::mutex
+};
+
+struct watched_dir {
+	std::string path;
+	int wd; // inotify watch descriptor
+};
+
+struct shader_watcher {
+	std::vector<watched_programme> programmes;
+	std::vector<watched_dir> dirs;
+	std::mutex mutex;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	int inotify_fd = -1;
+};
+
+// starts the background thread
+bool shader_watch_start(shader_watcher* watcher);
+
+// stops the background thread. the programmes are left alone
+void shader_watch_stop(shader_watcher* watcher);
+
+// watch the two files behind an already built programme. returns a handle
+int shader_watch_add(shader_watcher* watcher, const char* vert_file_name, const char* frag_file_name, GLuint programme);
+
+// the current programme for a handle. changes after a successful reload
+GLuint shader_watch_programme(shader_watcher* watcher, int handle);
+
+// rebuild anything that changed. GL thread only. returns the number swapped in
+int shader_watch_update(shader_watcher* watcher);
@@ -0,0 +1,172 @@
+#include "stream_buffer.h"
+#include "gl_utils.h"
+#include <chrono>
+#include <cstring>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRY *buffer_storage_proc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// GL 4.1 loaders don't have glBufferStorage(), so it's looked up by name the first time it's needed
+static buffer_storage_proc g_buffer_storage = NULL;
+
+bool stream_buffer_create(stream_buffer* sb, size_t region_size, bool allow_persistent) {
+	memset(sb, 0, sizeof(stream_buffer));
+	// keep every region start aligned for any attribute type
+	sb->region_size = (region_size + 255) & ~(size_t)255;
+	sb->region = STREAM_BUFFER_REGIONS - 1;
+
+	// so the glGetError() at the end only sees this function's errors
+	gl_clear_errors();
+	glGenBuffers(1, &sb->buffer);
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+	if (g_gl_caps.major == 0) {
+		detect_gl_caps();
+	}
+	if (allow_persistent && g_gl_caps.buffer_storage && !g_buffer_storage) {
+		g_buffer_storage = (buffer_storage_proc)gl_proc_address("glBufferStorage");
+	}
+	if (allow_persistent && g_gl_caps.buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		size_t total = sb->region_size * STREAM_BUFFER_REGIONS;
+		g_buffer_storage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+		sb->mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+		sb->persistent = sb->mapped != NULL;
+		if (!sb->persistent) {
+			// storage is immutable now, so start again with a new name
+			gl_log_err("ERROR: persistent map of stream buffer failed. falling back to orphaning\n");
+			gl_state_forget_buffer(sb->buffer);
+			glDeleteBuffers(1, &sb->buffer);
+			glGenBuffers(1, &sb->buffer);
+			gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+		}
+	}
+	if (!sb->persistent) {
+		glBufferData(GL_COPY_WRITE_BUFFER, sb->region_size, NULL, GL_STREAM_DRAW);
+	}
+	gl_log("stream buffer %u: %u bytes a frame, %s\n", sb->buffer, (unsigned int)sb->region_size,
+		sb->persistent ? "persistent mapped ring" : "orphaning");
+	return glGetError() == GL_NO_ERROR;
+}
+
+void stream_buffer_destroy(stream_buffer* sb) {
+	for (int i = 0; i < STREAM_BUFFER_REGIONS; i++) {
+		if (sb->fences[i]) {
+			glDeleteSync(sb->fences[i]);
+			sb->fences[i] = 0;
+		}
+	}
+	if (sb->mapped) {
+		gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		sb->mapped = NULL;
+	}
+	gl_state_forget_buffer(sb->buffer);
+	glDeleteBuffers(1, &sb->buffer);
+	sb->buffer = 0;
+}
+
+static void wait_for_region(stream_buffer* sb, int region) {
+	GLsync fence = sb->fences[region];
+	if (!fence) {
+		return;
+	}
+	// zero timeout first: in the common case the GPU is long done and there's nothing to count
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+		} while (result == GL_TIMEOUT_EXPIRED);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		sb->stats.fence_waits++;
+		sb->stats.wait_ms_total += ms;
+		if (ms > sb->stats.wait_ms_max) {
+			sb->stats.wait_ms_max = ms;
+		}
+		if (result == GL_WAIT_FAILED) {
+			gl_log_err("ERROR: glClientWaitSync failed on stream buffer %u\n", sb->buffer);
+		}
+	}
+	glDeleteSync(fence);
+	sb->fences[region] = 0;
+}
+
+void stream_buffer_begin_frame(stream_buffer* sb) {
+	sb->region = (sb->region + 1) % STREAM_BUFFER_REGIONS;
+	sb->head = 0;
+	sb->mapped_from = 0;
+	sb->stats.frames++;
+	if (sb->persistent) {
+		wait_for_region(sb, sb->region);
+		return;
+	}
+	/* orphan: the driver gives the buffer name new storage and frees the old
+	block when the GPU is done, so there's never anything to wait on here */
+	gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, sb->region_size, NULL, GL_STREAM_DRAW);
+	sb->mapped = (unsigned char*)glMapBufferRange(
+		GL_COPY_WRITE_BUFFER, 0, sb->region_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	sb->stats.orphans++;
+	if (!sb->mapped) {
+		gl_log_err("ERROR: could not map stream buffer %u\n", sb->buffer);
+	}
+}
+
+void* stream_buffer_alloc(stream_buffer* sb, size_t size, size_t alignment, size_t* offset) {
+	if (alignment == 0) {
+		alignment = 1;
+	}
+	size_t start = (sb->head + alignment - 1) / alignment * alignment;
+	if (start + size > sb->region_size) {
+		sb->stats.overflows++;
+		return NULL;
+	}
+	if (sb->persistent) {
+		sb->head = start + size;
+		*offset = sb->region * sb->region_size + start;
+		return sb->mapped + *offset;
+	}
+	if (!sb->mapped) {
+		/* flushed earlier this frame. nothing drawn so far reads past head, so the
+		rest of the region can be mapped again without waiting */
+		gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+		sb->mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, start, sb->region_size - start,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!sb->mapped) {
+			gl_log_err("ERROR: could not map stream buffer %u\n", sb->buffer);
+			return NULL;
+		}
+		sb->mapped_from = start;
+	}
+	sb->head = start + size;
+	*offset = start;
+	return sb->mapped + (start - sb->mapped_from);
+}
+
+void stream_buffer_flush(stream_buffer* sb) {
+	// coherent mappings need nothing. the GL can't read a buffer while it's mapped the ordinary way
+	if (!sb->persistent && sb->mapped) {
+		gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, sb->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		sb->mapped = NULL;
+	}
+}
+
+void stream_buffer_end_frame(stream_buffer* sb) {
+	stream_buffer_flush(sb);
+	if (sb->persistent) {
+		sb->fences[sb->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void stream_buffer_log_stats(const stream_buffer* sb) {
+	const stream_buffer_stats* s = &sb->stats;
+	gl_log("stream buffer %u: %llu frames, %llu fence waits (%.3f ms total, %.3f ms max), %llu orphans, %llu overflows\n", sb->buffer, s->frames,
+		s->fence_waits, s->wait_ms_total, s->wait_ms_max, s->orphans, s->overflows);
+}
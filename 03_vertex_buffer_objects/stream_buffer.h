@@ -0,0 +1,73 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <cstddef>
+
+/* ring buffer for geometry that's rebuilt every frame. the buffer is split into
+STREAM_BUFFER_REGIONS regions and each frame writes into the next one, straight
+into mapped memory - no glBufferSubData() copy. a fence after each frame's
+draws stops the CPU from overwriting a region the GPU hasn't finished reading.
+
+  stream_buffer sb;
+  stream_buffer_create( &sb, 1 << 20 );
+  each frame:
+    stream_buffer_begin_frame( &sb );
+    size_t offset;
+    float* v = (float*)stream_buffer_alloc( &sb, n * 12, 4, &offset );
+    ...write n vertices to v...
+    stream_buffer_flush( &sb );
+    draw from sb.buffer at offset
+    stream_buffer_end_frame( &sb );
+
+with GL 4.4 or GL_ARB_buffer_storage the whole buffer is mapped once with
+glBufferStorage() and GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT. on plain
+GL 4.1 (what start_gl() asks for) it falls back to orphaning: each frame
+glBufferData( NULL ) hands the driver a fresh block and the old one is
+released once the GPU is done with it. the call sequence is the same either
+way, but offsets always need to come from stream_buffer_alloc(). allocs can
+follow a flush and draw in the same frame: on the orphaning path the rest of
+the region is mapped again */
+
+#define STREAM_BUFFER_REGIONS 3
+
+struct stream_buffer_stats {
+	unsigned long long frames;
+	unsigned long long fence_waits; // frames where the region's fence hadn't signalled yet
+	double wait_ms_total;           // time blocked on those fences
+	double wait_ms_max;
+	unsigned long long orphans;   // fallback path only
+	unsigned long long overflows; // allocs that didn't fit in what was left of the region
+};
+
+struct stream_buffer {
+	GLuint buffer;
+	size_t region_size;
+	bool persistent;
+	unsigned char* mapped; // whole buffer when persistent, current region from mapped_from when orphaning
+	size_t mapped_from;
+	GLsync fences[STREAM_BUFFER_REGIONS];
+	int region;
+	size_t head; // bytes used in the current region
+	stream_buffer_stats stats;
+};
+
+/* region_size is the most that can be written in one frame. set
+allow_persistent to false to force the orphaning path */
+bool stream_buffer_create(stream_buffer* sb, size_t region_size, bool allow_persistent = true);
+
+void stream_buffer_destroy(stream_buffer* sb);
+
+// moves to the next region, waiting on its fence if the GPU is still using it
+void stream_buffer_begin_frame(stream_buffer* sb);
+
+/* returns somewhere to write size bytes, or NULL if the region is full.
+*offset is the matching byte offset into sb->buffer for the draw calls */
+void* stream_buffer_alloc(stream_buffer* sb, size_t size, size_t alignment, size_t* offset);
+
+// call after writing and before drawing. unmaps on the orphaning path
+void stream_buffer_flush(stream_buffer* sb);
+
+// call after the draws that read this frame's data
+void stream_buffer_end_frame(stream_buffer* sb);
+
+void stream_buffer_log_stats(const stream_buffer* sb);
@@ -0,0 +1,13 @@
+#version 410
+
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec3 vertex_colour;
+// per-instance model matrix. a mat4 attribute takes locations 2 to 5
+layout(location = 2) in mat4 instance_matrix;
+
+out vec3 colour;
+
+void main() {
+	colour = vertex_colour;
+	gl_Position = instance_matrix * vec4(vertex_position, 1.0);
+}
\ No newline at end of file
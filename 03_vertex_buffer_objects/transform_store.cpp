@@ -0,0 +1,123 @@
+#include "transform_store.h"
+#include "maths_simd.h"
+#include <assert.h>
+
+void transform_store::reserve( size_t n ) {
+  positions.reserve( n );
+  rotations.reserve( n );
+  scales.reserve( n );
+  world.reserve( n );
+}
+
+void transform_store::clear() {
+  positions.clear();
+  rotations.clear();
+  scales.clear();
+  world.clear();
+}
+
+size_t transform_store::add( const vec3& pos, const versor& rot, const vec3& scl ) {
+  positions.push_back( pos );
+  rotations.push_back( rot );
+  scales.push_back( scl );
+  world.push_back( identity_mat4() );
+  return positions.size() - 1;
+}
+
+void transform_store::remove( size_t index ) {
+  size_t last = positions.size() - 1;
+  if ( index != last ) {
+    positions[index] = positions[last];
+    rotations[index] = rotations[last];
+    scales[index]    = scales[last];
+    world[index]     = world[last];
+  }
+  positions.pop_back();
+  rotations.pop_back();
+  scales.pop_back();
+  world.pop_back();
+}
+
+/* same as translate( identity_mat4(), p ) * quat_to_mat4( q ) * scale( identity_mat4(), s )
+but written straight into the result */
+static inline void compose_one( const vec3& p, const versor& q, const vec3& s, mat4& out ) {
+  float w = q.q[0];
+  float x = q.q[1];
+  float y = q.q[2];
+  float z = q.q[3];
+  out.m[0]  = ( 1.0f - 2.0f * y * y - 2.0f * z * z ) * s.v[0];
+  out.m[1]  = ( 2.0f * x * y + 2.0f * w * z ) * s.v[0];
+  out.m[2]  = ( 2.0f * x * z - 2.0f * w * y ) * s.v[0];
+  out.m[3]  = 0.0f;
+  out.m[4]  = ( 2.0f * x * y - 2.0f * w * z ) * s.v[1];
+  out.m[5]  = ( 1.0f - 2.0f * x * x - 2.0f * z * z ) * s.v[1];
+  out.m[6]  = ( 2.0f * y * z + 2.0f * w * x ) * s.v[1];
+  out.m[7]  = 0.0f;
+  out.m[8]  = ( 2.0f * x * z + 2.0f * w * y ) * s.v[2];
+  out.m[9]  = ( 2.0f * y * z - 2.0f * w * x ) * s.v[2];
+  out.m[10] = ( 1.0f - 2.0f * x * x - 2.0f * y * y ) * s.v[2];
+  out.m[11] = 0.0f;
+  out.m[12] = p.v[0];
+  out.m[13] = p.v[1];
+  out.m[14] = p.v[2];
+  out.m[15] = 1.0f;
+}
+
+void transform_store::compose_world_matrices() { compose_world_matrices( 0, positions.size() ); }
+
+void transform_store::compose_world_matrices( size_t first, size_t count ) {
+  // written so first + count can't wrap round
+  assert( first <= positions.size() && count <= positions.size() - first );
+  const vec3* p   = positions.data() + first;
+  const versor* q = rotations.data() + first;
+  const vec3* s   = scales.data() + first;
+  mat4* out       = world.data() + first;
+  size_t i        = 0;
+#ifdef MATHS_SIMD
+  /* 4 transforms per iteration. the inputs are transposed so that each register
+  holds the same component of 4 different transforms, e.g. w = ( w0, w1, w2, w3 ),
+  then every matrix element is computed for all 4 at once and transposed back
+  into columns on the way out. */
+  f4 one  = f4_splat( 1.0f );
+  f4 two  = f4_splat( 2.0f );
+  f4 zero = f4_splat( 0.0f );
+  for ( ; i + 4 <= count; i += 4 ) {
+    f4 w = f4_load( q[i].q );
+    f4 x = f4_load( q[i + 1].q );
+    f4 y = f4_load( q[i + 2].q );
+    f4 z = f4_load( q[i + 3].q );
+    f4_transpose4( w, x, y, z );
+    f4 px, py, pz, sx, sy, sz;
+    f4_load_xyz4( p[i].v, px, py, pz );
+    f4_load_xyz4( s[i].v, sx, sy, sz );
+
+    f4 xx = f4_mul( x, x ), yy = f4_mul( y, y ), zz = f4_mul( z, z );
+    f4 xy = f4_mul( x, y ), xz = f4_mul( x, z ), yz = f4_mul( y, z );
+    f4 wx = f4_mul( w, x ), wy = f4_mul( w, y ), wz = f4_mul( w, z );
+
+    f4 c0x = f4_mul( f4_sub( one, f4_mul( two, f4_add( yy, zz ) ) ), sx );
+    f4 c0y = f4_mul( f4_mul( two, f4_add( xy, wz ) ), sx );
+    f4 c0z = f4_mul( f4_mul( two, f4_sub( xz, wy ) ), sx );
+    f4 c1x = f4_mul( f4_mul( two, f4_sub( xy, wz ) ), sy );
+    f4 c1y = f4_mul( f4_sub( one, f4_mul( two, f4_add( xx, zz ) ) ), sy );
+    f4 c1z = f4_mul( f4_mul( two, f4_add( yz, wx ) ), sy );
+    f4 c2x = f4_mul( f4_mul( two, f4_add( xz, wy ) ), sz );
+    f4 c2y = f4_mul( f4_mul( two, f4_sub( yz, wx ) ), sz );
+    f4 c2z = f4_mul( f4_sub( one, f4_mul( two, f4_add( xx, yy ) ) ), sz );
+    f4 c0w = zero, c1w = zero, c2w = zero, pw = one;
+
+    f4_transpose4( c0x, c0y, c0z, c0w );
+    f4_transpose4( c1x, c1y, c1z, c1w );
+    f4_transpose4( c2x, c2y, c2z, c2w );
+    f4_transpose4( px, py, pz, pw );
+    f4 cols[4][4] = { { c0x, c1x, c2x, px }, { c0y, c1y, c2y, py }, { c0z, c1z, c2z, pz }, { c0w, c1w, c2w, pw } };
+    for ( int k = 0; k < 4; k++ ) {
+      f4_store( &out[i + k].m[0], cols[k][0] );
+      f4_store( &out[i + k].m[4], cols[k][1] );
+      f4_store( &out[i + k].m[8], cols[k][2] );
+      f4_store( &out[i + k].m[12], cols[k][3] );
+    }
+  }
+#endif
+  for ( ; i < count; i++ ) { compose_one( p[i], q[i], s[i], out[i] ); }
+}
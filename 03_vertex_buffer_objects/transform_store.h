@@ -0,0 +1,31 @@
+#pragma once
+
+#include "maths_funcs.h"
+#include <vector>
+
+/* structure-of-arrays store for object transforms. instead of every object
+owning a mat4 built up with translate() / rotate_*_deg() / scale(), the parts
+of all the transforms are kept in separate contiguous arrays and
+compose_world_matrices() builds every world matrix in one pass:
+  world[i] = T( positions[i] ) * R( rotations[i] ) * S( scales[i] )
+objects are referred to by index. remove() moves the last object into the
+hole, so indices are not stable across removals. */
+struct transform_store {
+  std::vector<vec3> positions;
+  std::vector<versor> rotations; // assumed normalised
+  std::vector<vec3> scales;
+  // output of compose_world_matrices()
+  std::vector<mat4> world;
+
+  size_t size() const { return positions.size(); }
+  void reserve( size_t n );
+  void clear();
+  // returns the index of the new transform
+  size_t add( const vec3& pos, const versor& rot, const vec3& scl );
+  // swaps the last transform into index
+  void remove( size_t index );
+  // rebuild world matrices for every transform
+  void compose_world_matrices();
+  // rebuild a sub-range, e.g. to split the work between threads. first + count must be <= size()
+  void compose_world_matrices( size_t first, size_t count );
+};
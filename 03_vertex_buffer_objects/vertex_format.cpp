@@ -0,0 +1,203 @@
+#include "vertex_format.h"
+#include "gl_utils.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static size_t component_size(vertex_attr_type type) {
+	switch (type) {
+	case VA_FLOAT: return 4;
+	case VA_HALF: return 2;
+	case VA_SNORM8: return 1;
+	case VA_UNORM8: return 1;
+	case VA_SNORM16: return 2;
+	case VA_UNORM16: return 2;
+	default: break;
+	}
+	return 0;
+}
+
+static bool is_packed_type(vertex_attr_type type) { return type == VA_INT_2_10_10_10 || type == VA_UINT_2_10_10_10; }
+
+size_t vertex_attr_size(vertex_attr_type type, int components) {
+	if (is_packed_type(type)) {
+		return 4;
+	}
+	return component_size(type) * components;
+}
+
+static size_t align4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+void vertex_format_init(vertex_format* fmt) {
+	fmt->n_attrs = 0;
+	fmt->stride = 0;
+}
+
+bool vertex_format_add(vertex_format* fmt, GLuint location, int components, vertex_attr_type type) {
+	if (fmt->n_attrs >= VERTEX_FORMAT_MAX_ATTRS) {
+		gl_log_err("ERROR: vertex format is full (%i attributes)\n", VERTEX_FORMAT_MAX_ATTRS);
+		return false;
+	}
+	if (components < 1 || components > 4 || (is_packed_type(type) && components != 4)) {
+		gl_log_err("ERROR: bad component count %i for vertex attribute %u\n", components, location);
+		return false;
+	}
+	vertex_attr* attr = &fmt->attrs[fmt->n_attrs++];
+	attr->location = location;
+	attr->components = components;
+	attr->type = type;
+	attr->offset = fmt->stride;
+	// GL wants each attribute 4-byte aligned, or some drivers fall back to a slow path
+	fmt->stride = align4(fmt->stride + vertex_attr_size(type, components));
+	return true;
+}
+
+unsigned short float_to_half(float f) {
+	unsigned int bits;
+	memcpy(&bits, &f, 4);
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int exponent = (bits >> 23) & 0xFF;
+	unsigned int mantissa = bits & 0x7FFFFF;
+	if (exponent == 0xFF) { // inf or nan
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	int e = (int)exponent - 127 + 15;
+	if (e >= 31) { // too big - inf
+		return (unsigned short)(sign | 0x7C00);
+	}
+	if (e <= 0) { // subnormal half, or zero
+		if (e < -10) {
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - e;
+		unsigned int half_mantissa = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half_mantissa & 1))) {
+			half_mantissa++;
+		}
+		return (unsigned short)(sign | half_mantissa);
+	}
+	unsigned int half = sign | ((unsigned int)e << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1FFF;
+	// a carry out of the mantissa rolls into the exponent, which is correct
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return (unsigned short)half;
+}
+
+static float clampf(float v, float lo, float hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// round-to-nearest normalised int. snorm maps -1..1 to -max..max as GL 4.2+ does
+static int to_snorm(float v, int max) { return (int)lroundf(clampf(v, -1.0f, 1.0f) * max); }
+
+static unsigned int to_unorm(float v, unsigned int max) { return (unsigned int)lroundf(clampf(v, 0.0f, 1.0f) * max); }
+
+static void pack_attr(const vertex_attr* attr, const float* in, unsigned char* out) {
+	int n = attr->components;
+	switch (attr->type) {
+	case VA_FLOAT: memcpy(out, in, n * sizeof(float)); break;
+	case VA_HALF:
+		for (int i = 0; i < n; i++) {
+			unsigned short h = float_to_half(in[i]);
+			memcpy(out + i * 2, &h, 2);
+		}
+		break;
+	case VA_SNORM8:
+		for (int i = 0; i < n; i++) {
+			out[i] = (unsigned char)(signed char)to_snorm(in[i], 127);
+		}
+		break;
+	case VA_UNORM8:
+		for (int i = 0; i < n; i++) {
+			out[i] = (unsigned char)to_unorm(in[i], 255);
+		}
+		break;
+	case VA_SNORM16:
+		for (int i = 0; i < n; i++) {
+			short s = (short)to_snorm(in[i], 32767);
+			memcpy(out + i * 2, &s, 2);
+		}
+		break;
+	case VA_UNORM16:
+		for (int i = 0; i < n; i++) {
+			unsigned short u = (unsigned short)to_unorm(in[i], 65535);
+			memcpy(out + i * 2, &u, 2);
+		}
+		break;
+	case VA_INT_2_10_10_10: {
+		// x in the low bits, w in the top 2
+		unsigned int p = to_snorm(in[0], 511) & 0x3FF;
+		p |= (to_snorm(in[1], 511) & 0x3FF) << 10;
+		p |= (to_snorm(in[2], 511) & 0x3FF) << 20;
+		p |= (unsigned int)(to_snorm(in[3], 1) & 0x3) << 30;
+		memcpy(out, &p, 4);
+	} break;
+	case VA_UINT_2_10_10_10: {
+		unsigned int p = to_unorm(in[0], 1023) | (to_unorm(in[1], 1023) << 10) | (to_unorm(in[2], 1023) << 20) | (to_unorm(in[3], 3) << 30);
+		memcpy(out, &p, 4);
+	} break;
+	}
+}
+
+void pack_vertices(const vertex_format* fmt, const float* const* sources, size_t n_vertices, void* out) {
+	unsigned char* dst = (unsigned char*)out;
+	// zero first so the alignment padding is deterministic
+	memset(dst, 0, n_vertices * fmt->stride);
+	for (size_t v = 0; v < n_vertices; v++) {
+		unsigned char* vertex = dst + v * fmt->stride;
+		for (int a = 0; a < fmt->n_attrs; a++) {
+			const vertex_attr* attr = &fmt->attrs[a];
+			pack_attr(attr, sources[a] + v * attr->components, vertex + attr->offset);
+		}
+	}
+}
+
+GLuint create_interleaved_vbo(const vertex_format* fmt, const float* const* sources, size_t n_vertices) {
+	std::vector<unsigned char> packed(n_vertices * fmt->stride);
+	pack_vertices(fmt, sources, n_vertices, packed.data());
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+	gl_log("interleaved vbo %u: %u vertices, %u bytes each\n", vbo, (unsigned int)n_vertices, (unsigned int)fmt->stride);
+	return vbo;
+}
+
+static void gl_type_of(vertex_attr_type type, GLenum* gl_type, GLboolean* normalised) {
+	*normalised = GL_TRUE;
+	switch (type) {
+	case VA_FLOAT: *gl_type = GL_FLOAT; *normalised = GL_FALSE; break;
+	case VA_HALF: *gl_type = GL_HALF_FLOAT; *normalised = GL_FALSE; break;
+	case VA_SNORM8: *gl_type = GL_BYTE; break;
+	case VA_UNORM8: *gl_type = GL_UNSIGNED_BYTE; break;
+	case VA_SNORM16: *gl_type = GL_SHORT; break;
+	case VA_UNORM16: *gl_type = GL_UNSIGNED_SHORT; break;
+	case VA_INT_2_10_10_10: *gl_type = GL_INT_2_10_10_10_REV; break;
+	case VA_UINT_2_10_10_10: *gl_type = GL_UNSIGNED_INT_2_10_10_10_REV; break;
+	// not a vertex_attr_type - e.g. a bad value read from a file
+	default: *gl_type = GL_FLOAT; *normalised = GL_FALSE; break;
+	}
+}
+
+void apply_vertex_format(const vertex_format* fmt, GLuint vbo) {
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, vbo);
+	for (int a = 0; a < fmt->n_attrs; a++) {
+		const vertex_attr* attr = &fmt->attrs[a];
+		GLenum gl_type;
+		GLboolean normalised;
+		gl_type_of(attr->type, &gl_type, &normalised);
+		glVertexAttribPointer(attr->location, attr->components, gl_type, normalised, (GLsizei)fmt->stride, (const GLvoid*)attr->offset);
+		glEnableVertexAttribArray(attr->location);
+	}
+}
+
+GLuint create_vao_for_format(const vertex_format* fmt, GLuint vbo) {
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	gl_state_bind_vao(vao);
+	apply_vertex_format(fmt, vbo);
+	return vao;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <cstddef>
+
+/* describes one interleaved vertex layout. attributes are added in order and
+each one is packed at a 4-byte aligned offset, so e.g. a float3 position plus a
+unorm8 colour is 16 bytes a vertex instead of 24 in two float buffers:
+
+  vertex_format fmt;
+  vertex_format_init(&fmt);
+  vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+  vertex_format_add(&fmt, 1, 3, VA_UNORM8);
+  const float* sources[] = { points, colours };
+  GLuint vbo = create_interleaved_vbo(&fmt, sources, 3);
+  GLuint vao = create_vao_for_format(&fmt, vbo);
+
+the compact types are filled in from float input and read back as floats in
+the shader (half floats and normalised ints) - the shaders don't change.
+VA_INT_2_10_10_10 and VA_UINT_2_10_10_10 always take 4 components, with the
+4th kept to 2 bits, so they suit normals and tangents. */
+
+#define VERTEX_FORMAT_MAX_ATTRS 16
+
+enum vertex_attr_type {
+	VA_FLOAT,           // 4 bytes a component
+	VA_HALF,            // 2 bytes, 16-bit float
+	VA_SNORM8,          // 1 byte, -1 to 1
+	VA_UNORM8,          // 1 byte, 0 to 1
+	VA_SNORM16,         // 2 bytes, -1 to 1
+	VA_UNORM16,         // 2 bytes, 0 to 1
+	VA_INT_2_10_10_10,  // 4 bytes for all 4 components, -1 to 1
+	VA_UINT_2_10_10_10, // 4 bytes for all 4 components, 0 to 1
+};
+
+struct vertex_attr {
+	GLuint location;
+	int components;
+	vertex_attr_type type;
+	size_t offset; // bytes from the start of the vertex
+};
+
+struct vertex_format {
+	vertex_attr attrs[VERTEX_FORMAT_MAX_ATTRS];
+	int n_attrs;
+	size_t stride; // bytes per vertex, a multiple of 4
+};
+
+void vertex_format_init(vertex_format* fmt);
+
+// bytes one attribute takes up in a vertex, before alignment
+size_t vertex_attr_size(vertex_attr_type type, int components);
+
+// appends an attribute. returns false if the format is full or the type doesn't take that many components
+bool vertex_format_add(vertex_format* fmt, GLuint location, int components, vertex_attr_type type);
+
+/* packs n_vertices into out, which must hold n_vertices * fmt->stride bytes.
+sources[i] is tightly packed floats for attribute i, attrs[i].components per
+vertex */
+void pack_vertices(const vertex_format* fmt, const float* const* sources, size_t n_vertices, void* out);
+
+// packs the sources into a new GL_STATIC_DRAW buffer
+GLuint create_interleaved_vbo(const vertex_format* fmt, const float* const* sources, size_t n_vertices);
+
+/* points every attribute of the bound VAO at vbo with the format's stride and
+offsets, and enables them */
+void apply_vertex_format(const vertex_format* fmt, GLuint vbo);
+
+GLuint create_vao_for_format(const vertex_format* fmt, GLuint vbo);
+
+// IEEE 754 binary32 to binary16, round to nearest even
+unsigned short float_to_half(float f);
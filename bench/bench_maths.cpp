@@ -0,0 +1,238 @@
+/* maths_funcs benchmarks. each one runs over a batch of inputs, sized by the
+benchmark argument, so the numbers reflect streaming through real arrays
+rather than one value sitting in registers. items_per_second is per element.
+
+  bench_maths --benchmark_out=bench_maths.json --benchmark_out_format=json
+
+and compare two json files with Google Benchmark's tools/compare.py */
+
+#include "maths_funcs.h"
+#include "transform_store.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+// small enough for L1, a typical scene, and bigger than L2
+#define BATCH_SIZES Arg( 64 )->Arg( 4096 )->Arg( 65536 )
+
+static float rand_float( std::mt19937& rng, float lo, float hi ) {
+  std::uniform_real_distribution<float> dist( lo, hi );
+  return dist( rng );
+}
+
+static vec3 rand_vec3( std::mt19937& rng ) { return vec3( rand_float( rng, -10.0f, 10.0f ), rand_float( rng, -10.0f, 10.0f ), rand_float( rng, -10.0f, 10.0f ) ); }
+
+static versor rand_versor( std::mt19937& rng ) {
+  vec3 axis = normalise( rand_vec3( rng ) );
+  return quat_from_axis_deg( rand_float( rng, 0.0f, 360.0f ), axis.v[0], axis.v[1], axis.v[2] );
+}
+
+// invertible, non-trivial matrices: rotation * translation * non-uniform scale
+static std::vector<mat4> rand_mat4s( size_t n, unsigned int seed ) {
+  std::mt19937 rng( seed );
+  std::vector<mat4> out( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    vec3 s( rand_float( rng, 0.5f, 2.0f ), rand_float( rng, 0.5f, 2.0f ), rand_float( rng, 0.5f, 2.0f ) );
+    out[i] = translate( quat_to_mat4( rand_versor( rng ) ), rand_vec3( rng ) ) * scale( identity_mat4(), s );
+  }
+  return out;
+}
+
+static void set_items( benchmark::State& state ) { state.SetItemsProcessed( state.iterations() * state.range( 0 ) ); }
+
+static void BM_mat4_mul( benchmark::State& state ) {
+  size_t n               = (size_t)state.range( 0 );
+  std::vector<mat4> a    = rand_mat4s( n, 1 );
+  std::vector<mat4> b    = rand_mat4s( n, 2 );
+  std::vector<mat4> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = a[i] * b[i]; }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_mat4_mul )->BATCH_SIZES;
+
+static void BM_mat4_mul_batch( benchmark::State& state ) {
+  size_t n            = (size_t)state.range( 0 );
+  std::vector<mat4> a = rand_mat4s( n, 1 );
+  std::vector<mat4> b = rand_mat4s( n, 2 );
+  std::vector<mat4> out( n );
+  for ( auto _ : state ) {
+    mat4_mul_batch( a.data(), b.data(), out.data(), n );
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_mat4_mul_batch )->BATCH_SIZES;
+
+static void BM_inverse( benchmark::State& state ) {
+  size_t n            = (size_t)state.range( 0 );
+  std::vector<mat4> a = rand_mat4s( n, 3 );
+  std::vector<mat4> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = inverse( a[i] ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_inverse )->BATCH_SIZES;
+
+static void BM_determinant( benchmark::State& state ) {
+  size_t n            = (size_t)state.range( 0 );
+  std::vector<mat4> a = rand_mat4s( n, 4 );
+  std::vector<float> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = determinant( a[i] ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_determinant )->BATCH_SIZES;
+
+static void BM_look_at( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 5 );
+  std::vector<vec3> cams( n ), targets( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    cams[i]    = rand_vec3( rng );
+    targets[i] = rand_vec3( rng );
+  }
+  std::vector<mat4> out( n );
+  vec3 up( 0.0f, 1.0f, 0.0f );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = look_at( cams[i], targets[i], up ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_look_at )->BATCH_SIZES;
+
+static void BM_perspective( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 6 );
+  std::vector<float> fovs( n ), aspects( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    fovs[i]    = rand_float( rng, 30.0f, 90.0f );
+    aspects[i] = rand_float( rng, 0.5f, 2.5f );
+  }
+  std::vector<mat4> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = perspective( fovs[i], aspects[i], 0.1f, 100.0f ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_perspective )->BATCH_SIZES;
+
+static void BM_slerp( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 7 );
+  std::vector<versor> q( n ), r( n );
+  std::vector<float> t( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    q[i] = rand_versor( rng );
+    r[i] = rand_versor( rng );
+    t[i] = rand_float( rng, 0.0f, 1.0f );
+  }
+  std::vector<versor> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) {
+      // slerp() flips q in place when the dot product is negative, so every pass starts from the same inputs
+      versor a = q[i], b = r[i];
+      out[i]   = slerp( a, b, t[i] );
+    }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_slerp )->BATCH_SIZES;
+
+static void BM_normalise_vec3( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 8 );
+  std::vector<vec3> in( n ), out( n );
+  for ( size_t i = 0; i < n; i++ ) { in[i] = rand_vec3( rng ); }
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = normalise( in[i] ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_normalise_vec3 )->BATCH_SIZES;
+
+static void BM_normalise_versor( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 9 );
+  std::vector<versor> in( n ), out( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    in[i] = rand_versor( rng );
+    // knock it off unit length so there's work to do
+    for ( int j = 0; j < 4; j++ ) { in[i].q[j] *= 1.5f; }
+  }
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) {
+      versor q = in[i];
+      out[i]   = normalise( q );
+    }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_normalise_versor )->BATCH_SIZES;
+
+static void BM_quat_to_mat4( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 10 );
+  std::vector<versor> in( n );
+  for ( size_t i = 0; i < n; i++ ) { in[i] = rand_versor( rng ); }
+  std::vector<mat4> out( n );
+  for ( auto _ : state ) {
+    for ( size_t i = 0; i < n; i++ ) { out[i] = quat_to_mat4( in[i] ); }
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_quat_to_mat4 )->BATCH_SIZES;
+
+static void BM_transform_points( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 11 );
+  std::vector<vec3> in( n ), out( n );
+  for ( size_t i = 0; i < n; i++ ) { in[i] = rand_vec3( rng ); }
+  mat4 m = rand_mat4s( 1, 12 )[0];
+  for ( auto _ : state ) {
+    transform_points( m, in.data(), out.data(), n );
+    benchmark::DoNotOptimize( out.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_transform_points )->BATCH_SIZES;
+
+static void BM_compose_world_matrices( benchmark::State& state ) {
+  size_t n = (size_t)state.range( 0 );
+  std::mt19937 rng( 13 );
+  transform_store ts;
+  ts.reserve( n );
+  for ( size_t i = 0; i < n; i++ ) { ts.add( rand_vec3( rng ), rand_versor( rng ), vec3( 1.0f, 2.0f, 0.5f ) ); }
+  for ( auto _ : state ) {
+    ts.compose_world_matrices();
+    benchmark::DoNotOptimize( ts.world.data() );
+    benchmark::ClobberMemory();
+  }
+  set_items( state );
+}
+BENCHMARK( BM_compose_world_matrices )->BATCH_SIZES;
+
+BENCHMARK_MAIN();
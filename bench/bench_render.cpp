@@ -0,0 +1,251 @@
+/* render-loop benchmark on the headless context. sets up the same interleaved
+VAO and test shaders as 03_vertex_buffer_objects/main.cpp then steps through a
+grid of scene sizes: 1 to 1M triangles, split over 1 to 100k draw calls. for
+every step it records
+  submit - CPU time from the clear to the last draw call returning
+  frame  - the same start to glFinish() returning, so GPU work is included
+  memory - resident set size of the process and bytes of vertex data drawn
+and writes one row per step as CSV and as JSON.
+
+  bench_render [--frames n] [--csv file] [--json file]
+
+must be run from a directory containing test_vs.glsl and test_fs.glsl */
+
+#include "frame_profiler.h"
+#include "gl_utils.h"
+#include "vertex_format.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifndef GL_UTILS_HEADLESS
+#error bench_render needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define MAX_TRIANGLES 1000000
+#define MAX_DRAWS 100000
+#define WARMUP_FRAMES 3
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+struct bench_step {
+	int triangles;
+	int draws;
+	int frames;
+	double submit_mean_ms, submit_p50_ms, submit_max_ms;
+	double frame_mean_ms, frame_p50_ms, frame_max_ms;
+	long long rss_kb;
+	long long vertex_bytes;
+};
+
+static double now_ms() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// resident set size, or -1 where we don't know how to ask
+static long long resident_kb() {
+#if defined(__linux__)
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f) {
+		return -1;
+	}
+	long long size_pages = 0, resident_pages = 0;
+	int n = fscanf(f, "%lld %lld", &size_pages, &resident_pages);
+	fclose(f);
+	if (n != 2) {
+		return -1;
+	}
+	return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return -1;
+#endif
+}
+
+/* MAX_TRIANGLES small triangles scattered over the viewport, each with its own
+colour. they're kept small so the fill cost stays low and the numbers are
+dominated by submission and vertex work */
+static GLuint create_scene_vbo(const vertex_format* fmt) {
+	std::vector<float> points((size_t)MAX_TRIANGLES * 9);
+	std::vector<float> colours((size_t)MAX_TRIANGLES * 9);
+	srand(1);
+	for (size_t t = 0; t < MAX_TRIANGLES; t++) {
+		float x = (float)rand() / RAND_MAX * 1.9f - 0.95f;
+		float y = (float)rand() / RAND_MAX * 1.9f - 0.95f;
+		float z = (float)rand() / RAND_MAX;
+		// clockwise, to match the cull settings in main.cpp
+		float corners[] = { 0.0f, 0.02f, 0.02f, -0.02f, -0.02f, -0.02f };
+		float rgb[] = { (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX };
+		for (int v = 0; v < 3; v++) {
+			float* p = &points[t * 9 + v * 3];
+			p[0] = x + corners[v * 2];
+			p[1] = y + corners[v * 2 + 1];
+			p[2] = z;
+			memcpy(&colours[t * 9 + v * 3], rgb, sizeof(rgb));
+		}
+	}
+	const float* sources[] = { points.data(), colours.data() };
+	return create_interleaved_vbo(fmt, sources, (size_t)MAX_TRIANGLES * 3);
+}
+
+static void summarise(std::vector<double>& ms, double* mean, double* p50, double* max) {
+	double total = 0.0;
+	for (size_t i = 0; i < ms.size(); i++) {
+		total += ms[i];
+	}
+	std::sort(ms.begin(), ms.end());
+	*mean = total / ms.size();
+	*p50 = ms[ms.size() / 2];
+	*max = ms.back();
+}
+
+/* draws triangles as draws glDrawArrays calls of roughly equal size, frames
+times over */
+static void run_step(GLuint programme, GLuint vao, const vertex_format* fmt, int triangles, int draws, int frames, bench_step* step) {
+	std::vector<double> submit_ms, frame_ms;
+	int per_draw = triangles / draws;
+	for (int frame = -WARMUP_FRAMES; frame < frames; frame++) {
+		double start = now_ms();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gl_state_use_programme(programme);
+		gl_state_bind_vao(vao);
+		for (int d = 0; d < draws; d++) {
+			// the last draw picks up the remainder
+			int count = d == draws - 1 ? triangles - per_draw * d : per_draw;
+			glDrawArrays(GL_TRIANGLES, d * per_draw * 3, count * 3);
+		}
+		double submitted = now_ms();
+		glFinish();
+		double finished = now_ms();
+		if (frame >= 0) {
+			submit_ms.push_back(submitted - start);
+			frame_ms.push_back(finished - start);
+		}
+	}
+	step->triangles = triangles;
+	step->draws = draws;
+	step->frames = frames;
+	summarise(submit_ms, &step->submit_mean_ms, &step->submit_p50_ms, &step->submit_max_ms);
+	summarise(frame_ms, &step->frame_mean_ms, &step->frame_p50_ms, &step->frame_max_ms);
+	step->rss_kb = resident_kb();
+	step->vertex_bytes = (long long)triangles * 3 * fmt->stride;
+}
+
+static bool write_csv(const char* file_name, const std::vector<bench_step>& steps) {
+	FILE* f = fopen(file_name, "w");
+	if (!f) {
+		gl_log_err("ERROR: could not open %s for writing\n", file_name);
+		return false;
+	}
+	fprintf(f, "triangles,draws,frames,submit_mean_ms,submit_p50_ms,submit_max_ms,frame_mean_ms,frame_p50_ms,frame_max_ms,rss_kb,vertex_bytes\n");
+	for (size_t i = 0; i < steps.size(); i++) {
+		const bench_step& s = steps[i];
+		fprintf(f, "%i,%i,%i,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%lld\n", s.triangles, s.draws, s.frames, s.submit_mean_ms, s.submit_p50_ms,
+			s.submit_max_ms, s.frame_mean_ms, s.frame_p50_ms, s.frame_max_ms, s.rss_kb, s.vertex_bytes);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool write_json(const char* file_name, const std::vector<bench_step>& steps) {
+	FILE* f = fopen(file_name, "w");
+	if (!f) {
+		gl_log_err("ERROR: could not open %s for writing\n", file_name);
+		return false;
+	}
+	// driver strings are free text, so they're escaped
+	fprintf(f, "{\n\"renderer\": ");
+	write_json_string(f, (const char*)glGetString(GL_RENDERER));
+	fprintf(f, ",\n\"version\": ");
+	write_json_string(f, (const char*)glGetString(GL_VERSION));
+	fprintf(f, ",\n\"width\": %i,\n\"height\": %i,\n\"steps\": [\n", g_gl_width, g_gl_height);
+	for (size_t i = 0; i < steps.size(); i++) {
+		const bench_step& s = steps[i];
+		fprintf(f,
+			"{\"triangles\": %i, \"draws\": %i, \"frames\": %i, \"submit_mean_ms\": %.4f, \"submit_p50_ms\": %.4f, \"submit_max_ms\": %.4f, "
+			"\"frame_mean_ms\": %.4f, \"frame_p50_ms\": %.4f, \"frame_max_ms\": %.4f, \"rss_kb\": %lld, \"vertex_bytes\": %lld}%s\n",
+			s.triangles, s.draws, s.frames, s.submit_mean_ms, s.submit_p50_ms, s.submit_max_ms, s.frame_mean_ms, s.frame_p50_ms, s.frame_max_ms, s.rss_kb,
+			s.vertex_bytes, i + 1 < steps.size() ? "," : "");
+	}
+	fprintf(f, "]\n}\n");
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int frames = 20;
+	const char* csv_file = "bench_render.csv";
+	const char* json_file = "bench_render.json";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+			csv_file = argv[++i];
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_file = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--frames n] [--csv file] [--json file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (frames < 1) {
+		frames = 1;
+	}
+
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		return 1;
+	}
+	gl_state_enable(GL_DEPTH_TEST, true);
+	gl_state_depth_func(GL_LESS);
+	gl_state_enable(GL_CULL_FACE, true);
+	gl_state_cull_face(GL_BACK);
+	gl_state_front_face(GL_CW);
+	gl_state_viewport(0, 0, g_gl_width, g_gl_height);
+
+	// same layout as main.cpp
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	vertex_format_add(&fmt, 1, 3, VA_UNORM8);
+	GLuint vbo = create_scene_vbo(&fmt);
+	GLuint vao = create_vao_for_format(&fmt, vbo);
+
+	GLuint vs, fs, programme;
+	if (!create_shader("test_vs.glsl", &vs, GL_VERTEX_SHADER)) {
+		return 1;
+	}
+	if (!create_shader("test_fs.glsl", &fs, GL_FRAGMENT_SHADER)) {
+		return 1;
+	}
+	if (!create_programme(vs, fs, &programme)) {
+		return 1;
+	}
+
+	std::vector<bench_step> steps;
+	printf("%10s %8s %12s %12s %10s\n", "triangles", "draws", "submit ms", "frame ms", "rss KB");
+	for (int triangles = 1; triangles <= MAX_TRIANGLES; triangles *= 10) {
+		for (int draws = 1; draws <= MAX_DRAWS && draws <= triangles; draws *= 10) {
+			bench_step step;
+			run_step(programme, vao, &fmt, triangles, draws, frames, &step);
+			steps.push_back(step);
+			printf("%10i %8i %12.3f %12.3f %10lld\n", triangles, draws, step.submit_p50_ms, step.frame_p50_ms, step.rss_kb);
+			gl_log("%i triangles in %i draws: submit p50 %.3f ms, frame p50 %.3f ms\n", triangles, draws, step.submit_p50_ms, step.frame_p50_ms);
+		}
+	}
+
+	bool ok = write_csv(csv_file, steps) && write_json(json_file, steps);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	stop_gl_headless();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+/* the buffer arena on the headless context:
+  - first fit, rounding to the alignment, handle reuse and running out of room
+  - freeing merges with the free range after, before, and both at once
+  - buffer_arena_defragment() packs the live blocks in offset order and their
+    contents survive, read back with glGetBufferSubData()
+  - an alloc that only fits once the free space is joined up defragments
+  - a mesh arena with the first mesh removed and the vertices defragmented
+    gives the new base vertex, and still draws the right triangle
+exits 77 (skipped) if there is no headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "buffer_arena.h"
+#include "test_common.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_buffer_arena needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define ALIGNMENT 16
+
+int g_gl_width = 64;
+int g_gl_height = 64;
+GLFWwindow* g_window = NULL;
+
+// the free list as "offset+size" pairs, for comparing and printing
+static std::string free_list(const buffer_arena* arena) {
+	std::string text;
+	for (size_t i = 0; i < arena->free_ranges.size(); i++) {
+		char range[48];
+		snprintf(range, sizeof(range), "%s%u+%u", i ? " " : "", (unsigned int)arena->free_ranges[i].offset, (unsigned int)arena->free_ranges[i].size);
+		text += range;
+	}
+	return text;
+}
+
+static void check_free_list(const char* what, const buffer_arena* arena, const char* want) {
+	std::string got = free_list(arena);
+	if (got != want) {
+		printf("FAIL %s: free list \"%s\", want \"%s\"\n", what, got.c_str(), want);
+		g_failures++;
+	} else {
+		printf("ok   %s\n", what);
+	}
+}
+
+static void check_offset(const char* what, const buffer_arena* arena, int handle, size_t offset, size_t size) {
+	if (handle < 0 || buffer_arena_offset(arena, handle) != offset || buffer_arena_size(arena, handle) != size) {
+		printf("FAIL %s: handle %i at %u+%u, want %u+%u\n", what, handle, handle < 0 ? 0 : (unsigned int)buffer_arena_offset(arena, handle),
+			handle < 0 ? 0 : (unsigned int)buffer_arena_size(arena, handle), (unsigned int)offset, (unsigned int)size);
+		g_failures++;
+	}
+}
+
+// fills a block with bytes made from its handle, so each block's contents differ
+static void fill_block(buffer_arena* arena, int handle) {
+	std::vector<unsigned char> data(buffer_arena_size(arena, handle));
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (unsigned char)(handle * 37 + i);
+	}
+	buffer_arena_upload(arena, handle, data.data(), data.size());
+}
+
+static bool block_intact(buffer_arena* arena, int handle) {
+	std::vector<unsigned char> data(buffer_arena_size(arena, handle));
+	gl_state_bind_buffer(GL_COPY_READ_BUFFER, arena->buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, buffer_arena_offset(arena, handle), data.size(), data.data());
+	for (size_t i = 0; i < data.size(); i++) {
+		if (data[i] != (unsigned char)(handle * 37 + i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void check_blocks_intact(const char* what, buffer_arena* arena, const int* handles, int n) {
+	for (int i = 0; i < n; i++) {
+		if (!block_intact(arena, handles[i])) {
+			printf("FAIL %s: handle %i's contents changed\n", what, handles[i]);
+			g_failures++;
+			return;
+		}
+	}
+	printf("ok   %s\n", what);
+}
+
+static void test_alloc_and_free() {
+	buffer_arena arena;
+	if (!buffer_arena_create(&arena, 1000, ALIGNMENT)) {
+		fail("create", "could not create the arena");
+		return;
+	}
+	if (arena.capacity != 1008) {
+		fail("create", "capacity not rounded up to the alignment");
+	}
+	// 100 rounds up to 112, 1 to 16
+	int a = buffer_arena_alloc(&arena, 100);
+	int b = buffer_arena_alloc(&arena, 200);
+	int c = buffer_arena_alloc(&arena, 1);
+	int d = buffer_arena_alloc(&arena, 64);
+	check_offset("alloc a", &arena, a, 0, 112);
+	check_offset("alloc b", &arena, b, 112, 208);
+	check_offset("alloc c", &arena, c, 320, 16);
+	check_offset("alloc d", &arena, d, 336, 64);
+	check_free_list("four blocks allocated", &arena, "400+608");
+	if (arena.used != 400) {
+		fail("used", "doesn't add up the allocations");
+	}
+
+	buffer_arena_free(&arena, b);
+	check_free_list("free with no free neighbour", &arena, "112+208 400+608");
+	buffer_arena_free(&arena, a);
+	check_free_list("free merging with the range after", &arena, "0+320 400+608");
+	buffer_arena_free(&arena, d);
+	check_free_list("free merging with the range before", &arena, "0+320 336+672");
+	buffer_arena_free(&arena, c);
+	check_free_list("free merging on both sides", &arena, "0+1008");
+	buffer_arena_free(&arena, c);
+	check_free_list("freeing twice is harmless", &arena, "0+1008");
+
+	// freed handles are reused, and the first hole big enough is taken
+	a = buffer_arena_alloc(&arena, 64);
+	b = buffer_arena_alloc(&arena, 64);
+	c = buffer_arena_alloc(&arena, 64);
+	buffer_arena_free(&arena, a);
+	int e = buffer_arena_alloc(&arena, 96);
+	check_offset("first fit skips a hole too small", &arena, e, 192, 96);
+	int f = buffer_arena_alloc(&arena, 32);
+	check_offset("first fit takes the first hole that fits", &arena, f, 0, 32);
+	// never more than 4 blocks live at once
+	if (arena.blocks.size() != 4) {
+		printf("FAIL handle reuse: %u handles, want 4\n", (unsigned int)arena.blocks.size());
+		g_failures++;
+	}
+	if (buffer_arena_alloc(&arena, 2000) != -1) {
+		fail("alloc bigger than the arena", "succeeded");
+	}
+	buffer_arena_destroy(&arena);
+}
+
+static void test_defragment() {
+	buffer_arena arena;
+	if (!buffer_arena_create(&arena, 16 * 64, ALIGNMENT)) {
+		fail("create", "could not create the arena");
+		return;
+	}
+	// 16 blocks of 64 bytes, every other one freed
+	int handles[16];
+	for (int i = 0; i < 16; i++) {
+		handles[i] = buffer_arena_alloc(&arena, 64);
+		fill_block(&arena, handles[i]);
+	}
+	int live[8];
+	for (int i = 0; i < 16; i++) {
+		if (i % 2) {
+			buffer_arena_free(&arena, handles[i]);
+		} else {
+			live[i / 2] = handles[i];
+		}
+	}
+	buffer_arena_defragment(&arena);
+	for (int i = 0; i < 8; i++) {
+		char what[64];
+		snprintf(what, sizeof(what), "defragment keeps block %i in order", i);
+		check_offset(what, &arena, live[i], (size_t)i * 64, 64);
+	}
+	check_free_list("defragment leaves one free range at the end", &arena, "512+512");
+	check_blocks_intact("defragment keeps the contents", &arena, live, 8);
+
+	// 512 bytes free in one range. fill it with 64s, free every other, then ask for 256
+	int more[8];
+	for (int i = 0; i < 8; i++) {
+		more[i] = buffer_arena_alloc(&arena, 64);
+		fill_block(&arena, more[i]);
+	}
+	int kept[12];
+	int n_kept = 0;
+	for (int i = 0; i < 8; i++) {
+		kept[n_kept++] = live[i];
+	}
+	for (int i = 0; i < 8; i++) {
+		if (i % 2) {
+			buffer_arena_free(&arena, more[i]);
+		} else {
+			kept[n_kept++] = more[i];
+		}
+	}
+	int big = buffer_arena_alloc(&arena, 256);
+	check_offset("alloc that only fits once defragmented", &arena, big, 768, 256);
+	check_free_list("no room left", &arena, "");
+	check_blocks_intact("the alloc's defragment keeps the contents", &arena, kept, n_kept);
+	buffer_arena_destroy(&arena);
+}
+
+static GLuint build_programme() {
+	const char* vert_src = "#version 410\nlayout(location = 0) in vec3 vp;\nvoid main() { gl_Position = vec4(vp, 1.0); }\n";
+	const char* frag_src = "#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = vec4(1.0); }\n";
+	GLuint vs, fs, programme;
+	if (!create_shader_from_source("arena test vs", vert_src, strlen(vert_src), NULL, &vs, GL_VERTEX_SHADER) ||
+		!create_shader_from_source("arena test fs", frag_src, strlen(frag_src), NULL, &fs, GL_FRAGMENT_SHADER) ||
+		!create_programme(vs, fs, &programme)) {
+		return 0;
+	}
+	return programme;
+}
+
+// red channel at a pixel of the headless framebuffer
+static unsigned char red_at(int x, int y) {
+	unsigned char pixel[4];
+	glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	return pixel[0];
+}
+
+static void test_mesh_arena() {
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	mesh_arena ma;
+	if (!mesh_arena_create(&ma, &fmt, 64, 64)) {
+		fail("mesh arena", "could not create it");
+		return;
+	}
+	// three triangles, each a vertex short of a quad: in the middle, on the left, on the right
+	float middle[] = { -0.1f, -0.1f, 0.0f, 0.1f, -0.1f, 0.0f, 0.0f, 0.1f, 0.0f, 0.0f, 0.0f, 0.0f };
+	float left[] = { -1.0f, -1.0f, 0.0f, -0.2f, -1.0f, 0.0f, -0.6f, 1.0f, 0.0f };
+	float right[] = { 0.2f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.6f, 1.0f, 0.0f };
+	GLuint indices[] = { 0, 1, 2 };
+	arena_mesh first, left_mesh, right_mesh;
+	if (!mesh_arena_add(&ma, middle, 4, indices, 3, &first) || !mesh_arena_add(&ma, left, 3, indices, 3, &left_mesh) ||
+		!mesh_arena_add(&ma, right, 3, indices, 3, &right_mesh)) {
+		fail("mesh arena", "could not add the meshes");
+		mesh_arena_destroy(&ma);
+		return;
+	}
+	if (mesh_arena_base_vertex(&ma, &left_mesh) != 4 || mesh_arena_base_vertex(&ma, &right_mesh) != 7) {
+		printf("FAIL base vertex before defragmenting: %i and %i, want 4 and 7\n", mesh_arena_base_vertex(&ma, &left_mesh),
+			mesh_arena_base_vertex(&ma, &right_mesh));
+		g_failures++;
+	}
+	mesh_arena_remove(&ma, &first);
+	buffer_arena_defragment(&ma.vertices);
+	buffer_arena_defragment(&ma.indices);
+	if (mesh_arena_base_vertex(&ma, &left_mesh) != 0 || mesh_arena_base_vertex(&ma, &right_mesh) != 3 ||
+		mesh_arena_index_offset(&ma, &right_mesh) != 3 * sizeof(GLuint)) {
+		printf("FAIL base vertex after defragmenting: %i and %i, want 0 and 3; index offset %u, want %u\n", mesh_arena_base_vertex(&ma, &left_mesh),
+			mesh_arena_base_vertex(&ma, &right_mesh), (unsigned int)mesh_arena_index_offset(&ma, &right_mesh), (unsigned int)(3 * sizeof(GLuint)));
+		g_failures++;
+	} else {
+		printf("ok   base vertex after defragmenting\n");
+	}
+
+	// only the left triangle, from its new place in the buffer
+	GLuint programme = build_programme();
+	if (!programme) {
+		fail("mesh arena draw", "could not build the programme");
+		mesh_arena_destroy(&ma);
+		return;
+	}
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	gl_state_use_programme(programme);
+	mesh_arena_draw(&ma, &left_mesh);
+	int y = g_gl_height / 4;
+	if (red_at(g_gl_width * 3 / 10, y) != 255 || red_at(g_gl_width / 2, y) != 0 || red_at(g_gl_width * 7 / 10, y) != 0) {
+		fail("mesh arena draw after defragmenting", "didn't draw just the left triangle");
+	} else {
+		printf("ok   mesh arena draw after defragmenting\n");
+	}
+	gl_state_forget_programme(programme);
+	glDeleteProgram(programme);
+	mesh_arena_destroy(&ma);
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	test_alloc_and_free();
+	test_defragment();
+	test_mesh_arena();
+
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/* failure counting and gl.log reading shared by the tests. each test includes
+this once, from its only source file */
+
+#include "gl_utils.h"
+#include <cstdio>
+#include <string>
+
+static int g_failures = 0;
+
+static inline void fail(const char* what, const char* why) {
+	printf("FAIL %s: %s\n", what, why);
+	g_failures++;
+}
+
+static inline size_t log_size() {
+	gl_log_flush();
+	FILE* f = fopen("gl.log", "rb");
+	if (!f) {
+		return 0;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	return size > 0 ? (size_t)size : 0;
+}
+
+// everything logged since log_size() returned from
+static inline std::string log_since(size_t from) {
+	gl_log_flush();
+	std::string text;
+	FILE* f = fopen("gl.log", "rb");
+	if (!f) {
+		return text;
+	}
+	fseek(f, (long)from, SEEK_SET);
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		text.append(buffer, n);
+	}
+	fclose(f);
+	return text;
+}
+
+// fails what unless want was logged since log_size() returned from
+static inline bool check_logged(const char* what, size_t from, const char* want) {
+	std::string logged = log_since(from);
+	if (logged.find(want) == std::string::npos) {
+		printf("FAIL %s: wanted \"%s\" in the log, got \"%s\"\n", what, want, logged.c_str());
+		g_failures++;
+		return false;
+	}
+	return true;
+}
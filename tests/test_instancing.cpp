@@ -0,0 +1,142 @@
+/* draws INSTANCE_COUNT copies of a one-pixel triangle in one
+draw_arrays_instanced() call, through test_instanced_vs.glsl and an instance
+stream created with room for only INITIAL_CAPACITY matrices, so the upload has
+to grow it. only the last GRID_SIDE * GRID_SIDE instances are on screen, one
+per pixel of the framebuffer, so every pixel lit shows an instance well past
+the initial capacity was drawn with its own matrix. then a smaller upload
+checks only that many copies are drawn. run from a directory holding
+test_instanced_vs.glsl and test_fs.glsl. exits 77 (skipped) if there is no
+headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "instancing.h"
+#include "maths_funcs.h"
+#include "test_common.h"
+#include "vertex_format.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <vector>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_instancing needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define GRID_SIDE 64
+#define INSTANCE_COUNT 100000
+#define INITIAL_CAPACITY 1000
+#define SMALL_COUNT 10
+
+int g_gl_width = GRID_SIDE;
+int g_gl_height = GRID_SIDE;
+GLFWwindow* g_window = NULL;
+
+// instance i's matrix: the last GRID_SIDE^2 cover one pixel each, the rest are off screen
+static void make_matrices(std::vector<mat4>* matrices, size_t count) {
+	matrices->resize(count);
+	size_t first_visible = count > GRID_SIDE * GRID_SIDE ? count - GRID_SIDE * GRID_SIDE : 0;
+	for (size_t i = 0; i < count; i++) {
+		vec3 position(4.0f, 4.0f, 0.0f);
+		if (i >= first_visible) {
+			size_t cell = i - first_visible;
+			// the centre of pixel cell in clip space
+			position = vec3(((cell % GRID_SIDE) + 0.5f) * 2.0f / GRID_SIDE - 1.0f, ((cell / GRID_SIDE) + 0.5f) * 2.0f / GRID_SIDE - 1.0f, 0.0f);
+		}
+		(*matrices)[i] = translate(identity_mat4(), position);
+	}
+}
+
+static int count_lit_pixels() {
+	std::vector<unsigned char> pixels(GRID_SIDE * GRID_SIDE * 4);
+	glReadPixels(0, 0, GRID_SIDE, GRID_SIDE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	int lit = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		// the triangle is white
+		if (pixels[i] == 255 && pixels[i + 1] == 255 && pixels[i + 2] == 255) {
+			lit++;
+		}
+	}
+	return lit;
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	GLuint programme = create_programme_from_files("test_instanced_vs.glsl", "test_fs.glsl");
+	if (!programme) {
+		printf("FAIL could not build the instanced programme\n");
+		return 1;
+	}
+
+	/* smaller than a pixel is wide (2 / GRID_SIDE in clip space) so it covers its
+	own pixel centre and none of its neighbours'. clockwise, as in main.cpp */
+	const float size = 0.9f / GRID_SIDE;
+	GLfloat points[] = { 0.0f, size, 0.0f, size, -size, 0.0f, -size, -size, 0.0f };
+	GLfloat colours[] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	vertex_format_add(&fmt, 1, 3, VA_UNORM8);
+	const float* sources[] = { points, colours };
+	GLuint vbo = create_interleaved_vbo(&fmt, sources, 3);
+	GLuint vao = create_vao_for_format(&fmt, vbo);
+
+	instance_stream is;
+	if (!instance_stream_create(&is, INITIAL_CAPACITY)) {
+		printf("FAIL could not create the instance stream\n");
+		return 1;
+	}
+	instance_stream_attach(&is, vao, INSTANCE_MATRIX_LOCATION);
+	GLuint first_vbo = is.vbo;
+
+	std::vector<mat4> matrices;
+	make_matrices(&matrices, INSTANCE_COUNT);
+	instance_stream_upload(&is, matrices.data(), matrices.size());
+	if (is.count != INSTANCE_COUNT || is.capacity < INSTANCE_COUNT || is.vbo != first_vbo) {
+		printf("FAIL growing: count %u, capacity %u, buffer %u (was %u)\n", (unsigned int)is.count, (unsigned int)is.capacity, is.vbo, first_vbo);
+		g_failures++;
+	}
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	gl_state_use_programme(programme);
+	draw_arrays_instanced(vao, 0, 3, &is);
+	int lit = count_lit_pixels();
+	if (lit != GRID_SIDE * GRID_SIDE) {
+		printf("FAIL %i instances in one call: %i of %i pixels lit\n", INSTANCE_COUNT, lit, GRID_SIDE * GRID_SIDE);
+		g_failures++;
+	} else {
+		printf("ok   %i instances in one call, grown from %i: every pixel lit\n", INSTANCE_COUNT, INITIAL_CAPACITY);
+	}
+
+	// fewer than last time. the buffer keeps its size but only these are drawn
+	make_matrices(&matrices, SMALL_COUNT);
+	instance_stream_upload(&is, matrices.data(), matrices.size());
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	draw_arrays_instanced(vao, 0, 3, &is);
+	lit = count_lit_pixels();
+	if (lit != SMALL_COUNT || is.capacity < INSTANCE_COUNT) {
+		printf("FAIL %i instances after %i: %i pixels lit, capacity %u\n", SMALL_COUNT, INSTANCE_COUNT, lit, (unsigned int)is.capacity);
+		g_failures++;
+	} else {
+		printf("ok   %i instances after %i: %i pixels lit\n", SMALL_COUNT, INSTANCE_COUNT, lit);
+	}
+
+	instance_stream_destroy(&is);
+	gl_state_forget_vao(vao);
+	glDeleteVertexArrays(1, &vao);
+	gl_state_forget_buffer(vbo);
+	glDeleteBuffers(1, &vbo);
+	gl_state_forget_programme(programme);
+	glDeleteProgram(programme);
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
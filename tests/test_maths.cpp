@@ -0,0 +1,289 @@
+/* checks the mat4 / quaternion functions against straightforward double
+precision versions written out here. CMake builds it twice, as test_maths
+(SSE or NEON when the compiler has them) and test_maths_scalar (MATHS_NO_SIMD),
+so both backends are held to the same reference. exits non-zero on any
+mismatch */
+
+#include "maths_funcs.h"
+#include "maths_simd.h"
+#include "transform_store.h"
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#define N_CASES 10000
+// relative, with an absolute floor of the same size for values near 0
+#define EPSILON 1e-4
+
+static int g_failures = 0;
+
+static bool close_enough( double got, double want ) { return fabs( got - want ) <= EPSILON * ( fabs( want ) > 1.0 ? fabs( want ) : 1.0 ); }
+
+static void check( const char* what, int test_case, const float* got, const double* want, int n ) {
+  for ( int i = 0; i < n; i++ ) {
+    if ( !close_enough( got[i], want[i] ) ) {
+      if ( g_failures < 10 ) { printf( "FAIL %s case %i element %i: got %.9g, want %.9g\n", what, test_case, i, got[i], want[i] ); }
+      g_failures++;
+      return;
+    }
+  }
+}
+
+// got against a float result from the single-object functions
+static void check_same( const char* what, int test_case, const float* got, const float* want, int n ) {
+  double want_d[16];
+  for ( int i = 0; i < n; i++ ) { want_d[i] = want[i]; }
+  check( what, test_case, got, want_d, n );
+}
+
+/*------------------------------REFERENCE-------------------------------------*/
+// all column-major, like mat4::m
+
+static void ref_mul( const mat4& a, const mat4& b, double* out ) {
+  for ( int col = 0; col < 4; col++ ) {
+    for ( int row = 0; row < 4; row++ ) {
+      double sum = 0.0;
+      for ( int i = 0; i < 4; i++ ) { sum += (double)a.m[i * 4 + row] * b.m[col * 4 + i]; }
+      out[col * 4 + row] = sum;
+    }
+  }
+}
+
+static void ref_mul_vec4( const mat4& a, const vec4& v, double* out ) {
+  for ( int row = 0; row < 4; row++ ) {
+    double sum = 0.0;
+    for ( int i = 0; i < 4; i++ ) { sum += (double)a.m[i * 4 + row] * v.v[i]; }
+    out[row] = sum;
+  }
+}
+
+static void ref_transpose( const mat4& a, double* out ) {
+  for ( int col = 0; col < 4; col++ ) {
+    for ( int row = 0; row < 4; row++ ) { out[col * 4 + row] = a.m[row * 4 + col]; }
+  }
+}
+
+// Gauss-Jordan with partial pivoting. returns the determinant as a by-product
+static double ref_inverse( const mat4& a, double* out ) {
+  double m[4][8];
+  for ( int row = 0; row < 4; row++ ) {
+    for ( int col = 0; col < 4; col++ ) {
+      m[row][col]     = a.m[col * 4 + row];
+      m[row][col + 4] = row == col ? 1.0 : 0.0;
+    }
+  }
+  double det = 1.0;
+  for ( int col = 0; col < 4; col++ ) {
+    int pivot = col;
+    for ( int row = col + 1; row < 4; row++ ) {
+      if ( fabs( m[row][col] ) > fabs( m[pivot][col] ) ) { pivot = row; }
+    }
+    if ( pivot != col ) {
+      for ( int i = 0; i < 8; i++ ) {
+        double t    = m[col][i];
+        m[col][i]   = m[pivot][i];
+        m[pivot][i] = t;
+      }
+      det = -det;
+    }
+    double p = m[col][col];
+    det *= p;
+    for ( int i = 0; i < 8; i++ ) { m[col][i] /= p; }
+    for ( int row = 0; row < 4; row++ ) {
+      if ( row == col ) { continue; }
+      double f = m[row][col];
+      for ( int i = 0; i < 8; i++ ) { m[row][i] -= f * m[col][i]; }
+    }
+  }
+  for ( int row = 0; row < 4; row++ ) {
+    for ( int col = 0; col < 4; col++ ) { out[col * 4 + row] = m[row][col + 4]; }
+  }
+  return det;
+}
+
+static void ref_quat_to_mat4( const versor& q, double* out ) {
+  double w = q.q[0], x = q.q[1], y = q.q[2], z = q.q[3];
+  double r[16] = { 1.0 - 2.0 * ( y * y + z * z ), 2.0 * ( x * y + w * z ), 2.0 * ( x * z - w * y ), 0.0, 2.0 * ( x * y - w * z ), 1.0 - 2.0 * ( x * x + z * z ),
+    2.0 * ( y * z + w * x ), 0.0, 2.0 * ( x * z + w * y ), 2.0 * ( y * z - w * x ), 1.0 - 2.0 * ( x * x + y * y ), 0.0, 0.0, 0.0, 0.0, 1.0 };
+  for ( int i = 0; i < 16; i++ ) { out[i] = r[i]; }
+}
+
+/*------------------------------INPUTS----------------------------------------*/
+static float rand_float( std::mt19937& rng, float lo, float hi ) {
+  std::uniform_real_distribution<float> dist( lo, hi );
+  return dist( rng );
+}
+
+static versor rand_versor( std::mt19937& rng ) {
+  vec3 axis = normalise( vec3( rand_float( rng, -1.0f, 1.0f ), rand_float( rng, -1.0f, 1.0f ), rand_float( rng, -1.0f, 1.0f ) + 2.0f ) );
+  return quat_from_axis_deg( rand_float( rng, 0.0f, 360.0f ), axis.v[0], axis.v[1], axis.v[2] );
+}
+
+// rotation * translation * scale, so always comfortably invertible
+static mat4 rand_transform( std::mt19937& rng ) {
+  vec3 t( rand_float( rng, -10.0f, 10.0f ), rand_float( rng, -10.0f, 10.0f ), rand_float( rng, -10.0f, 10.0f ) );
+  vec3 s( rand_float( rng, 0.5f, 2.0f ), rand_float( rng, 0.5f, 2.0f ), rand_float( rng, 0.5f, 2.0f ) );
+  return translate( quat_to_mat4( rand_versor( rng ) ), t ) * scale( identity_mat4(), s );
+}
+
+static mat4 rand_mat4( std::mt19937& rng ) {
+  mat4 m;
+  for ( int i = 0; i < 16; i++ ) { m.m[i] = rand_float( rng, -5.0f, 5.0f ); }
+  return m;
+}
+
+/*------------------------------BATCHES---------------------------------------*/
+/* the batch functions against a loop of the single-object operators. the
+sizes cover the SIMD loop, its remainder, and both together; every function is
+also run in place, with out the same array as an input */
+static const int g_batch_sizes[] = { 1, 3, 4, 5, 8, 13, 67 };
+
+static void check_batches( std::mt19937& rng ) {
+  char what[64];
+  for ( int s = 0; s < (int)( sizeof( g_batch_sizes ) / sizeof( g_batch_sizes[0] ) ); s++ ) {
+    int n = g_batch_sizes[s];
+    std::vector<mat4> a( n ), b( n ), out( n );
+    std::vector<vec4> v( n ), v_out( n );
+    std::vector<vec3> p( n ), p_out( n );
+    for ( int i = 0; i < n; i++ ) {
+      a[i] = rand_mat4( rng );
+      b[i] = rand_mat4( rng );
+      v[i] = vec4( rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ) );
+      p[i] = vec3( rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ) );
+    }
+    mat4 m = rand_transform( rng );
+
+    mat4_mul_batch( a.data(), b.data(), out.data(), n );
+    snprintf( what, sizeof( what ), "mat4_mul_batch pairwise, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, out[i].m, ( a[i] * b[i] ).m, 16 ); }
+    out = a;
+    mat4_mul_batch( out.data(), b.data(), out.data(), n );
+    snprintf( what, sizeof( what ), "mat4_mul_batch pairwise in place, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, out[i].m, ( a[i] * b[i] ).m, 16 ); }
+
+    mat4_mul_batch( m, b.data(), out.data(), n );
+    snprintf( what, sizeof( what ), "mat4_mul_batch shared, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, out[i].m, ( m * b[i] ).m, 16 ); }
+    out = b;
+    mat4_mul_batch( m, out.data(), out.data(), n );
+    snprintf( what, sizeof( what ), "mat4_mul_batch shared in place, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, out[i].m, ( m * b[i] ).m, 16 ); }
+
+    transform_vec4s( m, v.data(), v_out.data(), n );
+    snprintf( what, sizeof( what ), "transform_vec4s, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, v_out[i].v, ( m * v[i] ).v, 4 ); }
+    v_out = v;
+    transform_vec4s( m, v_out.data(), v_out.data(), n );
+    snprintf( what, sizeof( what ), "transform_vec4s in place, n %i", n );
+    for ( int i = 0; i < n; i++ ) { check_same( what, i, v_out[i].v, ( m * v[i] ).v, 4 ); }
+
+    for ( int in_place = 0; in_place < 2; in_place++ ) {
+      for ( int w = 0; w < 2; w++ ) {
+        if ( in_place ) {
+          p_out = p;
+        }
+        const vec3* in = in_place ? p_out.data() : p.data();
+        if ( w ) {
+          transform_points( m, in, p_out.data(), n );
+        } else {
+          transform_directions( m, in, p_out.data(), n );
+        }
+        snprintf( what, sizeof( what ), "%s%s, n %i", w ? "transform_points" : "transform_directions", in_place ? " in place" : "", n );
+        for ( int i = 0; i < n; i++ ) {
+          vec4 want = m * vec4( p[i], (float)w );
+          check_same( what, i, p_out[i].v, want.v, 3 );
+        }
+      }
+    }
+  }
+}
+
+/*------------------------------TRANSFORM STORE-------------------------------*/
+// world matrices against translate( identity ) * quat_to_mat4( q ) * scale( identity )
+static void check_world( const char* what, const transform_store& ts, size_t first, size_t count ) {
+  for ( size_t i = first; i < first + count; i++ ) {
+    mat4 want = translate( identity_mat4(), ts.positions[i] ) * quat_to_mat4( ts.rotations[i] ) * scale( identity_mat4(), ts.scales[i] );
+    check_same( what, (int)i, ts.world[i].m, want.m, 16 );
+  }
+}
+
+static void check_transform_store( std::mt19937& rng ) {
+  static const size_t counts[] = { 1, 4, 5, 100000 };
+  char what[64];
+  for ( size_t c = 0; c < sizeof( counts ) / sizeof( counts[0] ); c++ ) {
+    transform_store ts;
+    for ( size_t i = 0; i < counts[c]; i++ ) {
+      vec3 pos( rand_float( rng, -100.0f, 100.0f ), rand_float( rng, -100.0f, 100.0f ), rand_float( rng, -100.0f, 100.0f ) );
+      vec3 scl( rand_float( rng, 0.1f, 4.0f ), rand_float( rng, 0.1f, 4.0f ), rand_float( rng, 0.1f, 4.0f ) );
+      ts.add( pos, rand_versor( rng ), scl );
+    }
+    ts.compose_world_matrices();
+    snprintf( what, sizeof( what ), "compose_world_matrices, %u transforms", (unsigned int)counts[c] );
+    check_world( what, ts, 0, ts.size() );
+  }
+
+  /* a sub-range starting off a multiple of 4 and ending part way through a
+  group of 4. everything outside it has to be left alone */
+  transform_store ts;
+  for ( int i = 0; i < 40; i++ ) { ts.add( vec3( (float)i, 0.0f, 0.0f ), rand_versor( rng ), vec3( 1.0f, 2.0f, 3.0f ) ); }
+  ts.compose_world_matrices();
+  mat4 marker = zero_mat4();
+  marker.m[0] = 12345.0f;
+  for ( size_t i = 0; i < ts.size(); i++ ) { ts.world[i] = marker; }
+  ts.compose_world_matrices( 3, 30 );
+  check_world( "compose_world_matrices, sub-range", ts, 3, 30 );
+  for ( size_t i = 0; i < ts.size(); i++ ) {
+    if ( ( i < 3 || i >= 33 ) && ts.world[i].m[0] != marker.m[0] ) {
+      printf( "FAIL compose_world_matrices, sub-range: wrote transform %u outside the range\n", (unsigned int)i );
+      g_failures++;
+      break;
+    }
+  }
+}
+
+int main() {
+#ifdef MATHS_SIMD_SSE
+  printf( "backend: SSE\n" );
+#elif defined( MATHS_SIMD_NEON )
+  printf( "backend: NEON\n" );
+#else
+  printf( "backend: scalar\n" );
+#endif
+  std::mt19937 rng( 1 );
+  double want[16];
+  for ( int c = 0; c < N_CASES; c++ ) {
+    mat4 a = rand_mat4( rng );
+    mat4 b = rand_mat4( rng );
+    vec4 v( rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ), rand_float( rng, -5.0f, 5.0f ) );
+
+    ref_mul( a, b, want );
+    check( "mat4 * mat4", c, ( a * b ).m, want, 16 );
+    ref_mul_vec4( a, v, want );
+    check( "mat4 * vec4", c, ( a * v ).v, want, 4 );
+    ref_transpose( a, want );
+    check( "transpose", c, transpose( a ).m, want, 16 );
+
+    mat4 t        = rand_transform( rng );
+    double det[1] = { ref_inverse( t, want ) };
+    check( "inverse", c, inverse( t ).m, want, 16 );
+    float got_det = determinant( t );
+    check( "determinant", c, &got_det, det, 1 );
+    // general matrices too, for the determinant, which doesn't care about conditioning
+    det[0]  = ref_inverse( a, want );
+    got_det = determinant( a );
+    check( "determinant (general)", c, &got_det, det, 1 );
+
+    versor q = rand_versor( rng );
+    ref_quat_to_mat4( q, want );
+    check( "quat_to_mat4", c, quat_to_mat4( q ).m, want, 16 );
+  }
+  check_batches( rng );
+  check_transform_store( rng );
+  if ( g_failures > 0 ) {
+    printf( "%i failures\n", g_failures );
+    return 1;
+  }
+  printf( "all %i cases agree with the reference\n", N_CASES );
+  return 0;
+}
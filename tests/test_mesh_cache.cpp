@@ -0,0 +1,207 @@
+/* writes a small mesh to the binary cache and opens it again, then damages
+the file in each way mesh_cache_open() should catch: a flipped byte in the
+vertices or indices, a file cut short inside the indices or the header, an
+empty file, an index past the last vertex, and attributes that run past the
+end of the vertex or use a location out of range. each rejection is checked
+against the reason logged to gl.log. writes its .mesh files to the working
+directory and removes them. exits non-zero on any failure */
+
+#include "mesh_cache.h"
+#include "gl_utils.h"
+#include "test_common.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define CACHE_FILE "test_mesh_cache.mesh"
+#define DAMAGED_FILE "test_mesh_cache_damaged.mesh"
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+static bool read_file(const char* file_name, std::vector<char>* data) {
+	FILE* f = fopen(file_name, "rb");
+	if (!f) {
+		return false;
+	}
+	char buffer[4096];
+	size_t n;
+	data->clear();
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		data->insert(data->end(), buffer, buffer + n);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool write_file(const char* file_name, const char* data, size_t size) {
+	FILE* f = fopen(file_name, "wb");
+	if (!f) {
+		return false;
+	}
+	bool ok = size == 0 || fwrite(data, 1, size, f) == size;
+	return fclose(f) == 0 && ok;
+}
+
+// must fail to open, and log want_message
+static void check_rejected(const char* what, const char* want_message) {
+	mesh_cache_view view;
+	size_t from = log_size();
+	if (mesh_cache_open(DAMAGED_FILE, &view)) {
+		fail(what, "opened");
+		mesh_cache_close(&view);
+		return;
+	}
+	check_logged(what, from, want_message);
+}
+
+// a copy of the good file with one byte flipped
+static void check_flipped_byte(const char* what, const std::vector<char>& good, size_t at) {
+	std::vector<char> damaged = good;
+	damaged[at] = (char)(damaged[at] ^ 0x01);
+	write_file(DAMAGED_FILE, damaged.data(), damaged.size());
+	check_rejected(what, "checksum mismatch");
+}
+
+// a copy of the good file with its header swapped for header
+static void check_header_rejected(const char* what, const std::vector<char>& good, const mesh_cache_header& header, const char* want_message) {
+	std::vector<char> damaged = good;
+	memcpy(damaged.data(), &header, sizeof(header));
+	write_file(DAMAGED_FILE, damaged.data(), damaged.size());
+	check_rejected(what, want_message);
+}
+
+int main() {
+	restart_gl_log();
+
+	// a 4 by 4 grid of points, float3 position and a packed normal, 9 quads
+	const int n_side = 4;
+	std::vector<float> points, normals;
+	for (int y = 0; y < n_side; y++) {
+		for (int x = 0; x < n_side; x++) {
+			points.push_back((float)x);
+			points.push_back((float)y);
+			points.push_back(0.25f * (float)(x * y));
+			normals.push_back(0.0f);
+			normals.push_back(0.0f);
+			normals.push_back(1.0f);
+			normals.push_back(0.0f);
+		}
+	}
+	std::vector<GLuint> indices;
+	for (int y = 0; y + 1 < n_side; y++) {
+		for (int x = 0; x + 1 < n_side; x++) {
+			GLuint i = (GLuint)(y * n_side + x);
+			GLuint quad[] = { i, i + 1, i + n_side + 1, i, i + n_side + 1, i + n_side };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	size_t n_vertices = n_side * n_side;
+	vertex_format format;
+	vertex_format_init(&format);
+	vertex_format_add(&format, 0, 3, VA_FLOAT);
+	vertex_format_add(&format, 1, 4, VA_INT_2_10_10_10);
+	std::vector<unsigned char> vertices(n_vertices * format.stride);
+	const float* sources[] = { points.data(), normals.data() };
+	pack_vertices(&format, sources, n_vertices, vertices.data());
+	const float bounds_min[3] = { 0.0f, 0.0f, 0.0f };
+	const float bounds_max[3] = { 3.0f, 3.0f, 2.25f };
+
+	if (!mesh_cache_write(CACHE_FILE, &format, vertices.data(), n_vertices, indices.data(), indices.size(), bounds_min, bounds_max)) {
+		printf("FAIL could not write %s\n", CACHE_FILE);
+		return 1;
+	}
+
+	// written under a temporary name and renamed, so none should be left over
+	FILE* tmp = fopen(CACHE_FILE ".tmp", "rb");
+	if (tmp) {
+		fclose(tmp);
+		fail("write", "left " CACHE_FILE ".tmp behind");
+	}
+
+	// round trip, with and without the checksum
+	for (int verify = 1; verify >= 0; verify--) {
+		const char* what = verify ? "round trip, verified" : "round trip, unverified";
+		mesh_cache_view view;
+		if (!mesh_cache_open(CACHE_FILE, &view, verify != 0)) {
+			fail(what, "didn't open");
+			continue;
+		}
+		bool same_format = view.format.n_attrs == format.n_attrs && view.format.stride == format.stride;
+		for (int i = 0; same_format && i < format.n_attrs; i++) {
+			const vertex_attr* a = &view.format.attrs[i];
+			const vertex_attr* b = &format.attrs[i];
+			same_format = a->location == b->location && a->components == b->components && a->type == b->type && a->offset == b->offset;
+		}
+		if (!same_format) {
+			fail(what, "different vertex format");
+		}
+		if (view.n_vertices != n_vertices || memcmp(view.vertices, vertices.data(), vertices.size()) != 0) {
+			fail(what, "different vertices");
+		}
+		if (view.n_indices != indices.size() || memcmp(view.indices, indices.data(), indices.size() * sizeof(GLuint)) != 0) {
+			fail(what, "different indices");
+		}
+		if (memcmp(view.bounds_min, bounds_min, sizeof(bounds_min)) != 0 || memcmp(view.bounds_max, bounds_max, sizeof(bounds_max)) != 0) {
+			fail(what, "different bounds");
+		}
+		if ((size_t)view.indices % MESH_CACHE_ALIGNMENT != 0 || (size_t)view.vertices % MESH_CACHE_ALIGNMENT != 0) {
+			fail(what, "sections not aligned in the mapping");
+		}
+		mesh_cache_close(&view);
+	}
+
+	std::vector<char> good;
+	if (!read_file(CACHE_FILE, &good)) {
+		printf("FAIL could not read %s\n", CACHE_FILE);
+		return 1;
+	}
+	mesh_cache_header header;
+	memcpy(&header, good.data(), sizeof(header));
+
+	// one bit anywhere the header checks don't look
+	check_flipped_byte("flipped byte in the bounds", good, offsetof(mesh_cache_header, bounds_max));
+	check_flipped_byte("flipped byte in a vertex", good, (size_t)header.vertex_offset + format.stride * 5 + 2);
+	check_flipped_byte("flipped byte in the last index", good, good.size() - sizeof(GLuint));
+
+	// the header still claims all the indices
+	write_file(DAMAGED_FILE, good.data(), good.size() - 1);
+	check_rejected("last byte cut off", "indices run past the end of the file");
+	write_file(DAMAGED_FILE, good.data(), (size_t)header.vertex_offset + 10);
+	check_rejected("cut off in the vertices", "vertices run past the end of the file");
+	write_file(DAMAGED_FILE, good.data(), sizeof(mesh_cache_header) / 2);
+	check_rejected("cut off in the header", "file too short");
+	write_file(DAMAGED_FILE, good.data(), 0);
+	check_rejected("empty file", "file too short");
+
+	/* attributes the header checks turn down before the checksum is looked at.
+	the normal is 4 bytes at offset 12 of a 16 byte vertex */
+	mesh_cache_header bad_header = header;
+	bad_header.attrs[1].offset = bad_header.vertex_stride + 4;
+	check_header_rejected("attribute offset past the stride", good, bad_header, "vertex attribute runs past the end of the vertex");
+	bad_header = header;
+	bad_header.attrs[1].offset = bad_header.vertex_stride - 2;
+	check_header_rejected("attribute straddling the end of the vertex", good, bad_header, "vertex attribute runs past the end of the vertex");
+	bad_header = header;
+	bad_header.attrs[0].location = MESH_CACHE_MAX_LOCATIONS;
+	check_header_rejected("attribute location out of range", good, bad_header, "vertex attribute location out of range");
+
+	// a bad index with a good checksum is caught by the range check
+	std::vector<GLuint> bad_indices = indices;
+	bad_indices[7] = (GLuint)n_vertices;
+	mesh_cache_write(DAMAGED_FILE, &format, vertices.data(), n_vertices, bad_indices.data(), bad_indices.size(), bounds_min, bounds_max);
+	check_rejected("index past the last vertex", "index out of range");
+
+	remove(CACHE_FILE);
+	remove(DAMAGED_FILE);
+
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
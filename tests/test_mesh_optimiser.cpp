@@ -0,0 +1,307 @@
+/* runs the mesh optimiser passes on a grid whose triangles and vertices have
+been shuffled, and checks after each pass that
+  - the same triangles are drawn, each with its winding - corners may rotate
+    but never swap
+  - ACMR is under GOOD_ACMR once the vertex cache pass has run, and the
+    overdraw pass moves triangles around while costing no more than
+    MESH_OPT_OVERDRAW_THRESHOLD times that
+and that optimise_vertex_fetch() numbers vertices in first-use order and drops
+the unused ones. each vertex carries its grid id as a 4th float, so triangles
+can still be compared once the fetch pass has renumbered the vertices.
+then the overdraw pass on a closed mesh, a torus, which must put the triangles
+on the outside of the ring ahead of those facing into the hole. exits non-zero
+on any failure */
+
+#include "mesh_optimiser.h"
+#include "test_common.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define GRID_SIDE 64
+#define VERTEX_FLOATS 4 // x, y, z, grid id
+#define TORUS_RINGS 48
+#define TORUS_SIDES 24
+// a 64x64 grid gets ~0.72. 0.5 is the floor, 3 no reuse at all
+#define GOOD_ACMR 0.8f
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+struct triangle {
+	unsigned int a, b, c;
+	bool operator<(const triangle& t) const { return a != t.a ? a < t.a : b != t.b ? b < t.b : c < t.c; }
+	bool operator==(const triangle& t) const { return a == t.a && b == t.b && c == t.c; }
+};
+
+// rotated so the smallest id comes first. keeps the winding
+static triangle canonical(unsigned int a, unsigned int b, unsigned int c) {
+	triangle t = { a, b, c };
+	if (b < a && b < c) {
+		t.a = b;
+		t.b = c;
+		t.c = a;
+	} else if (c < a && c < b) {
+		t.a = c;
+		t.b = a;
+		t.c = b;
+	}
+	return t;
+}
+
+// the triangles as sorted grid ids, whatever the vertex numbering
+static std::vector<triangle> triangle_set(const std::vector<GLuint>& indices, const std::vector<float>& vertices) {
+	std::vector<triangle> set;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		unsigned int ids[3];
+		for (int j = 0; j < 3; j++) {
+			ids[j] = (unsigned int)vertices[indices[i + j] * VERTEX_FLOATS + 3];
+		}
+		set.push_back(canonical(ids[0], ids[1], ids[2]));
+	}
+	std::sort(set.begin(), set.end());
+	return set;
+}
+
+static float acmr(const std::vector<GLuint>& indices, size_t n_vertices) { return analyse_vertex_cache(indices.data(), indices.size(), n_vertices).acmr; }
+
+static void check_pass(const char* what, const std::vector<triangle>& want, const std::vector<GLuint>& indices, const std::vector<float>& vertices,
+	size_t n_vertices, float max_acmr) {
+	if (triangle_set(indices, vertices) != want) {
+		fail(what, "the triangles or their winding changed");
+	}
+	float got = acmr(indices, n_vertices);
+	if (got > max_acmr) {
+		printf("FAIL %s: ACMR %.3f, over %.3f\n", what, got, max_acmr);
+		g_failures++;
+	} else {
+		printf("ok   %s: ACMR %.3f, limit %.3f\n", what, got, max_acmr);
+	}
+}
+
+// how many triangles are no longer in the same place
+static size_t triangles_moved(const std::vector<GLuint>& a, const std::vector<GLuint>& b) {
+	size_t moved = 0;
+	for (size_t i = 0; i + 2 < a.size(); i += 3) {
+		if (a[i] != b[i] || a[i + 1] != b[i + 1] || a[i + 2] != b[i + 2]) {
+			moved++;
+		}
+	}
+	return moved;
+}
+
+/* a GRID_SIDE square grid of vertices, two counter clockwise triangles a cell,
+with a gentle bump so overdraw sorting has something to work on. the vertex
+numbering, the triangle order and each triangle's first corner are all
+shuffled. one extra vertex is left unused */
+static void make_shuffled_grid(std::mt19937* rng, std::vector<float>* vertices, std::vector<GLuint>* indices) {
+	size_t n_grid = GRID_SIDE * GRID_SIDE;
+	std::vector<GLuint> slot(n_grid + 1);
+	for (size_t i = 0; i < slot.size(); i++) {
+		slot[i] = (GLuint)i;
+	}
+	std::shuffle(slot.begin(), slot.end(), *rng);
+
+	vertices->assign(slot.size() * VERTEX_FLOATS, 0.0f);
+	for (size_t id = 0; id < slot.size(); id++) {
+		float x = (float)(id % GRID_SIDE), y = (float)(id / GRID_SIDE);
+		float* v = &(*vertices)[slot[id] * VERTEX_FLOATS];
+		v[0] = x;
+		v[1] = y;
+		v[2] = 4.0f * sinf(x * 0.1f) * cosf(y * 0.1f);
+		v[3] = (float)id;
+	}
+
+	std::vector<triangle> triangles;
+	for (GLuint y = 0; y + 1 < GRID_SIDE; y++) {
+		for (GLuint x = 0; x + 1 < GRID_SIDE; x++) {
+			GLuint i = y * GRID_SIDE + x;
+			triangle lower = { slot[i], slot[i + 1], slot[i + GRID_SIDE + 1] };
+			triangle upper = { slot[i], slot[i + GRID_SIDE + 1], slot[i + GRID_SIDE] };
+			triangles.push_back(lower);
+			triangles.push_back(upper);
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), *rng);
+	indices->clear();
+	for (size_t i = 0; i < triangles.size(); i++) {
+		GLuint corners[3] = { triangles[i].a, triangles[i].b, triangles[i].c };
+		int first = (int)((*rng)() % 3);
+		for (int j = 0; j < 3; j++) {
+			indices->push_back(corners[(first + j) % 3]);
+		}
+	}
+}
+
+/* a torus around the z axis, centred on the origin, TORUS_RINGS around the
+ring by TORUS_SIDES around the tube, with counter clockwise triangles seen from
+outside. the triangle order is shuffled */
+static void make_shuffled_torus(std::mt19937* rng, std::vector<float>* vertices, std::vector<GLuint>* indices) {
+	const float pi = 3.14159265f;
+	vertices->clear();
+	for (int r = 0; r < TORUS_RINGS; r++) {
+		float u = 2.0f * pi * r / TORUS_RINGS;
+		for (int s = 0; s < TORUS_SIDES; s++) {
+			float v = 2.0f * pi * s / TORUS_SIDES;
+			float radius = 4.0f + cosf(v);
+			vertices->push_back(radius * cosf(u));
+			vertices->push_back(radius * sinf(u));
+			vertices->push_back(sinf(v));
+			vertices->push_back((float)(r * TORUS_SIDES + s));
+		}
+	}
+	std::vector<triangle> triangles;
+	for (GLuint r = 0; r < TORUS_RINGS; r++) {
+		for (GLuint s = 0; s < TORUS_SIDES; s++) {
+			GLuint a = r * TORUS_SIDES + s;
+			GLuint b = ((r + 1) % TORUS_RINGS) * TORUS_SIDES + s;
+			GLuint c = ((r + 1) % TORUS_RINGS) * TORUS_SIDES + (s + 1) % TORUS_SIDES;
+			GLuint d = r * TORUS_SIDES + (s + 1) % TORUS_SIDES;
+			triangle lower = { a, b, c };
+			triangle upper = { a, c, d };
+			triangles.push_back(lower);
+			triangles.push_back(upper);
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), *rng);
+	indices->clear();
+	for (size_t i = 0; i < triangles.size(); i++) {
+		indices->push_back(triangles[i].a);
+		indices->push_back(triangles[i].b);
+		indices->push_back(triangles[i].c);
+	}
+}
+
+/* how far out from the origin a run of triangles faces, on average: the dot of
+each centroid with its unit normal. > 0 facing out, < 0 into the hole */
+static float facing_out(const std::vector<GLuint>& indices, const std::vector<float>& vertices, size_t first, size_t count) {
+	float sum = 0.0f;
+	for (size_t t = first; t < first + count; t++) {
+		const float* a = &vertices[indices[t * 3] * VERTEX_FLOATS];
+		const float* b = &vertices[indices[t * 3 + 1] * VERTEX_FLOATS];
+		const float* c = &vertices[indices[t * 3 + 2] * VERTEX_FLOATS];
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int i = 0; i < 3; i++) {
+			sum += (a[i] + b[i] + c[i]) / 3.0f * n[i] / length;
+		}
+	}
+	return sum / count;
+}
+
+int main() {
+	std::mt19937 rng(1234);
+	std::vector<float> vertices;
+	std::vector<GLuint> indices;
+	make_shuffled_grid(&rng, &vertices, &indices);
+	size_t n_vertices = vertices.size() / VERTEX_FLOATS;
+	size_t stride = VERTEX_FLOATS * sizeof(float);
+	std::vector<triangle> want = triangle_set(indices, vertices);
+
+	// each pass in turn, in the order optimise_obj_mesh() runs them
+	optimise_vertex_cache(indices.data(), indices.size(), n_vertices);
+	check_pass("optimise_vertex_cache", want, indices, vertices, n_vertices, GOOD_ACMR);
+	float cache_acmr = acmr(indices, n_vertices);
+	std::vector<GLuint> cache_order = indices;
+	optimise_overdraw(indices.data(), indices.size(), vertices.data(), stride, n_vertices);
+	check_pass("optimise_overdraw", want, indices, vertices, n_vertices, cache_acmr * MESH_OPT_OVERDRAW_THRESHOLD);
+	size_t moved = triangles_moved(cache_order, indices);
+	if (moved < indices.size() / 3 / 4) {
+		printf("FAIL optimise_overdraw: moved %u of %u triangles\n", (unsigned int)moved, (unsigned int)(indices.size() / 3));
+		g_failures++;
+	}
+	float before_fetch_acmr = acmr(indices, n_vertices);
+	size_t n_used = optimise_vertex_fetch(vertices.data(), n_vertices, stride, indices.data(), indices.size());
+	check_pass("optimise_vertex_fetch", want, indices, vertices, n_used, before_fetch_acmr);
+
+	// renumbering can't change which vertices are in the cache
+	if (n_used != n_vertices - 1 || acmr(indices, n_used) != before_fetch_acmr) {
+		printf("FAIL optimise_vertex_fetch: %u of %u vertices kept, ACMR %.3f -> %.3f\n", (unsigned int)n_used, (unsigned int)n_vertices, before_fetch_acmr,
+			acmr(indices, n_used));
+		g_failures++;
+	}
+	GLuint next = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] > next) {
+			printf("FAIL optimise_vertex_fetch: index %u is vertex %u before vertex %u has been used\n", (unsigned int)i, indices[i], next);
+			g_failures++;
+			break;
+		}
+		if (indices[i] == next) {
+			next++;
+		}
+	}
+
+	// the whole pass on an obj_mesh, float3 position then the grid id
+	obj_mesh mesh;
+	vertex_format_init(&mesh.format);
+	vertex_format_add(&mesh.format, 0, 3, VA_FLOAT);
+	vertex_format_add(&mesh.format, 1, 1, VA_FLOAT);
+	make_shuffled_grid(&rng, &vertices, &indices);
+	mesh.n_vertices = vertices.size() / VERTEX_FLOATS;
+	mesh.vertices.resize(vertices.size() * sizeof(float));
+	memcpy(mesh.vertices.data(), vertices.data(), mesh.vertices.size());
+	mesh.indices = indices;
+	want = triangle_set(indices, vertices);
+	float shuffled_acmr = acmr(indices, mesh.n_vertices);
+	mesh_opt_stats stats = optimise_obj_mesh(&mesh);
+	vertices.resize(mesh.vertices.size() / sizeof(float));
+	memcpy(vertices.data(), mesh.vertices.data(), mesh.vertices.size());
+	check_pass("optimise_obj_mesh", want, mesh.indices, vertices, mesh.n_vertices, GOOD_ACMR);
+	if (stats.before.acmr != shuffled_acmr || stats.after.acmr != acmr(mesh.indices, mesh.n_vertices)) {
+		printf("FAIL optimise_obj_mesh: returned ACMR %.3f -> %.3f, measured %.3f -> %.3f\n", stats.before.acmr, stats.after.acmr, shuffled_acmr,
+			acmr(mesh.indices, mesh.n_vertices));
+		g_failures++;
+	}
+
+	/* a closed mesh. the outside of the ring hides the inside from most angles,
+	so the overdraw pass should draw it first: the first quarter of the
+	triangles must face out more than the last quarter */
+	make_shuffled_torus(&rng, &vertices, &indices);
+	n_vertices = vertices.size() / VERTEX_FLOATS;
+	want = triangle_set(indices, vertices);
+	optimise_vertex_cache(indices.data(), indices.size(), n_vertices);
+	cache_acmr = acmr(indices, n_vertices);
+	cache_order = indices;
+	optimise_overdraw(indices.data(), indices.size(), vertices.data(), stride, n_vertices);
+	check_pass("optimise_overdraw on a torus", want, indices, vertices, n_vertices, cache_acmr * MESH_OPT_OVERDRAW_THRESHOLD);
+	size_t n_triangles = indices.size() / 3;
+	moved = triangles_moved(cache_order, indices);
+	float first_out = facing_out(indices, vertices, 0, n_triangles / 4);
+	float last_out = facing_out(indices, vertices, n_triangles - n_triangles / 4, n_triangles / 4);
+	if (moved < n_triangles / 4 || first_out <= last_out) {
+		printf("FAIL optimise_overdraw on a torus, order: moved %u of %u triangles, facing out %.3f first, %.3f last\n", (unsigned int)moved,
+			(unsigned int)n_triangles, first_out, last_out);
+		g_failures++;
+	} else {
+		printf("ok   optimise_overdraw on a torus, order: moved %u of %u triangles, facing out %.3f first, %.3f last\n", (unsigned int)moved,
+			(unsigned int)n_triangles, first_out, last_out);
+	}
+
+	/* degenerate triangles, as fan triangulation can leave: a repeated vertex
+	goes into the cache once, and the triangles all still come out */
+	make_shuffled_grid(&rng, &vertices, &indices);
+	n_vertices = vertices.size() / VERTEX_FLOATS;
+	size_t n_grid_triangles = indices.size() / 3;
+	for (size_t i = 0; i < n_grid_triangles; i += 8) {
+		GLuint degenerate[3] = { indices[i * 3], indices[i * 3], indices[i * 3 + 1] };
+		indices.insert(indices.end(), degenerate, degenerate + 3);
+	}
+	want = triangle_set(indices, vertices);
+	optimise_vertex_cache(indices.data(), indices.size(), n_vertices);
+	check_pass("optimise_vertex_cache with degenerate triangles", want, indices, vertices, n_vertices, GOOD_ACMR);
+
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,209 @@
+/* parse_obj() on in-memory files. small hand-written files check each face
+form, fan triangulation, negative indices and vertex sharing; a generated file
+of a few MB, big enough to be split into chunks, checks that 1 and 4 threads
+give the same mesh, that relative and absolute indices give the same mesh, and
+that a bad line is reported with its line number in the whole file. error
+messages are read back from gl.log in the working directory. exits non-zero on
+any failure */
+
+#include "obj_loader.h"
+#include "gl_utils.h"
+#include "test_common.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+static bool parse(const std::string& text, obj_mesh* mesh, int n_threads) { return parse_obj(text.data(), text.size(), mesh, n_threads); }
+
+static void position(const obj_mesh* mesh, size_t vertex, float* xyz) { memcpy(xyz, &mesh->vertices[vertex * mesh->format.stride], 3 * sizeof(float)); }
+
+static void check_indices(const char* what, const obj_mesh* mesh, const GLuint* want, size_t n_want, size_t n_vertices) {
+	if (mesh->indices.size() != n_want || mesh->n_vertices != n_vertices) {
+		char why[128];
+		snprintf(why, sizeof(why), "%u indices and %u vertices, want %u and %u", (unsigned int)mesh->indices.size(), (unsigned int)mesh->n_vertices,
+			(unsigned int)n_want, (unsigned int)n_vertices);
+		fail(what, why);
+		return;
+	}
+	for (size_t i = 0; i < n_want; i++) {
+		if (mesh->indices[i] != want[i]) {
+			fail(what, "wrong indices");
+			return;
+		}
+	}
+}
+
+// must fail, and log want_message (e.g. "obj line 3: bad f")
+static void check_rejected(const char* what, const std::string& text, const char* want_message, int n_threads = 1) {
+	obj_mesh mesh;
+	size_t from = log_size();
+	if (parse(text, &mesh, n_threads)) {
+		fail(what, "parsed");
+		return;
+	}
+	check_logged(what, from, want_message);
+}
+
+static void test_small_files() {
+	obj_mesh mesh;
+	const std::string quad_vs = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n";
+
+	const GLuint tri[] = { 0, 1, 2 };
+	if (!parse("# a triangle\nv 0 0 0\nv 1 0 0\nv 0 1 0\n\nf 1 2 3\n", &mesh, 1)) {
+		fail("triangle", "didn't parse");
+	} else {
+		check_indices("triangle", &mesh, tri, 3, 3);
+		float xyz[3];
+		position(&mesh, 1, xyz);
+		if (xyz[0] != 1.0f || xyz[1] != 0.0f || xyz[2] != 0.0f || mesh.has_normals || mesh.has_texcoords || mesh.format.stride != 12) {
+			fail("triangle", "wrong vertex data or format");
+		}
+	}
+
+	// no newline at the end, and negative indices
+	if (!parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1", &mesh, 1)) {
+		fail("negative indices", "didn't parse");
+	} else {
+		check_indices("negative indices", &mesh, tri, 3, 3);
+	}
+
+	// a quad is a fan of 2 triangles sharing corners 0 and 2
+	const GLuint fan[] = { 0, 1, 2, 0, 2, 3 };
+	if (!parse(quad_vs + "f 1 2 3 4\n", &mesh, 1)) {
+		fail("quad", "didn't parse");
+	} else {
+		check_indices("quad", &mesh, fan, 6, 4);
+	}
+	const GLuint pentagon[] = { 0, 1, 2, 0, 2, 3, 0, 3, 4 };
+	if (!parse(quad_vs + "v 0 2 0\nf 1 2 3 4 5\n", &mesh, 1)) {
+		fail("pentagon", "didn't parse");
+	} else {
+		check_indices("pentagon", &mesh, pentagon, 9, 5);
+	}
+
+	// v//vn. a different normal on a shared position makes a separate vertex
+	const GLuint split[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6 };
+	if (!parse(quad_vs + "vn 0 0 1\nvn 0 0 -1\nf 1//1 2//1 3//1 4//1\nf 1//2 2//2 3//2\n", &mesh, 1)) {
+		fail("v//vn", "didn't parse");
+	} else {
+		check_indices("v//vn", &mesh, split, 9, 7);
+		if (!mesh.has_normals || mesh.has_texcoords || mesh.format.stride != 16) {
+			fail("v//vn", "wrong format");
+		}
+	}
+
+	// v/vt, with vt's v left out on one line
+	if (!parse(quad_vs + "vt 0 0\nvt 1\nvt 1 1\nvt 0 1\nf 1/1 2/2 3/3 4/4\n", &mesh, 1)) {
+		fail("v/vt", "didn't parse");
+	} else {
+		check_indices("v/vt", &mesh, fan, 6, 4);
+		float uv[2];
+		memcpy(uv, &mesh.vertices[1 * mesh.format.stride + mesh.format.attrs[1].offset], sizeof(uv));
+		if (mesh.has_normals || !mesh.has_texcoords || uv[0] != 1.0f || uv[1] != 0.0f) {
+			fail("v/vt", "wrong format or texcoords");
+		}
+	}
+
+	// v/vt/vn, relative, skipping the lines that aren't geometry
+	if (!parse("o thing\ng part\ns 1\nusemtl stone\n" + quad_vs + "vt 0 0\nvt 1 0\nvt 1 1\nvn 0 0 1\nf -4/-3/-1 -3/-2/-1 -2/-1/-1\n", &mesh, 1)) {
+		fail("v/vt/vn", "didn't parse");
+	} else {
+		check_indices("v/vt/vn", &mesh, tri, 3, 3);
+		if (!mesh.has_normals || !mesh.has_texcoords || mesh.format.stride != 24) {
+			fail("v/vt/vn", "wrong format");
+		}
+	}
+
+	check_rejected("short v", "# comment\nv 1 2\n", "obj line 2: bad v");
+	check_rejected("bad vn", "v 0 0 0\n\nvn 0 x 1\n", "obj line 3: bad vn");
+	check_rejected("bad vt", "vt 0 y\n", "obj line 1: bad vt");
+	check_rejected("bad f", quad_vs + "f 1 x 3\n", "obj line 5: bad f");
+	check_rejected("index 0", quad_vs + "f 0 1 2\n", "obj line 5: bad f");
+	check_rejected("2 corners", quad_vs + "\n\nf 1 2\n", "obj line 7: face with fewer than 3 corners");
+	check_rejected("index past the end", quad_vs + "f 1 2 5\n", "face index out of range");
+	check_rejected("relative index before the start", quad_vs + "f -5 -2 -1\n", "face index out of range");
+	check_rejected("no faces", quad_vs, "obj has no faces");
+}
+
+/* a strip of quads, each written as its own 4 positions, 4 texcoords and a
+normal followed by the face. relative uses negative indices throughout */
+static std::string make_big_file(int n_quads, bool relative) {
+	std::string text;
+	text.reserve((size_t)n_quads * 160);
+	char line[160];
+	for (int q = 0; q < n_quads; q++) {
+		float x = (float)(q % 300), y = (float)(q / 300);
+		snprintf(line, sizeof(line), "v %g %g 0\nv %g %g 0\nv %g %g 0.5\nv %g %g 0\n", x, y, x + 1.0f, y, x + 1.0f, y + 1.0f, x, y + 1.0f);
+		text += line;
+		snprintf(line, sizeof(line), "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0.%i 1\n", q % 10);
+		text += line;
+		if (relative) {
+			text += "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n";
+		} else {
+			int v = q * 4 + 1, n = q + 1;
+			snprintf(line, sizeof(line), "f %i/%i/%i %i/%i/%i %i/%i/%i %i/%i/%i\n", v, v, n, v + 1, v + 1, n, v + 2, v + 2, n, v + 3, v + 3, n);
+			text += line;
+		}
+	}
+	return text;
+}
+
+static bool same_mesh(const obj_mesh* a, const obj_mesh* b) {
+	return a->n_vertices == b->n_vertices && a->vertices == b->vertices && a->indices == b->indices && a->format.stride == b->format.stride &&
+		memcmp(a->bounds_min, b->bounds_min, sizeof(a->bounds_min)) == 0 && memcmp(a->bounds_max, b->bounds_max, sizeof(a->bounds_max)) == 0;
+}
+
+static void test_big_file() {
+	const int n_quads = 30000;
+	std::string relative = make_big_file(n_quads, true);
+	std::string absolute = make_big_file(n_quads, false);
+	if (relative.size() < 3 * (1 << 20)) {
+		fail("big file", "too small to be split into 4 chunks");
+	}
+
+	obj_mesh one, four, four_absolute;
+	if (!parse(relative, &one, 1) || !parse(relative, &four, 4) || !parse(absolute, &four_absolute, 4)) {
+		fail("big file", "didn't parse");
+		return;
+	}
+	if (one.indices.size() != (size_t)n_quads * 6 || one.n_vertices != (size_t)n_quads * 4) {
+		fail("big file", "wrong vertex or index count");
+	}
+	if (!same_mesh(&one, &four)) {
+		fail("big file", "1 and 4 threads give different meshes");
+	}
+	if (!same_mesh(&four, &four_absolute)) {
+		fail("big file", "relative and absolute indices give different meshes");
+	}
+
+	// a bad line three quarters of the way in, well inside a later chunk
+	size_t at = relative.size() * 3 / 4;
+	at = relative.find('\n', at) + 1;
+	int line = 1;
+	for (size_t i = 0; i < at; i++) {
+		line += relative[i] == '\n';
+	}
+	std::string bad = relative.substr(0, at) + "f 1 2\n" + relative.substr(at);
+	char want[64];
+	snprintf(want, sizeof(want), "obj line %i: face with fewer than 3 corners", line);
+	check_rejected("bad line in a later chunk, 1 thread", bad, want, 1);
+	check_rejected("bad line in a later chunk, 4 threads", bad, want, 4);
+}
+
+int main() {
+	restart_gl_log();
+	test_small_files();
+	test_big_file();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,156 @@
+/* builds a batch of programmes on the headless context: four good ones with
+different defines, one whose fragment shader doesn't compile and one whose
+file is missing. polls the batch until it's done, through
+GL_COMPLETION_STATUS_KHR when the driver has parallel compiles, then checks
+the good programmes linked, the broken ones come back as 0 with the file named
+in gl.log, and a programme added after the first submit is built on its own.
+run from a directory of its own - it writes its shaders there. exits 77
+(skipped) if there is no headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "programme_batch.h"
+#include "test_common.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_programme_batch needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define VERT_FILE "batch_vs.glsl"
+#define FRAG_FILE "batch_fs.glsl"
+#define BROKEN_FRAG_FILE "batch_broken_fs.glsl"
+#define MISSING_FILE "batch_missing_fs.glsl"
+#define N_GOOD 4
+// polling gives up after this long
+#define POLL_TIMEOUT_S 30
+
+int g_gl_width = 64;
+int g_gl_height = 64;
+GLFWwindow* g_window = NULL;
+
+static bool write_text_file(const char* file_name, const char* text) {
+	FILE* f = fopen(file_name, "w");
+	if (!f) {
+		return false;
+	}
+	bool ok = fputs(text, f) >= 0;
+	return fclose(f) == 0 && ok;
+}
+
+// polls until every programme is ready. returns the number of polls, or -1 on timeout
+static int poll_until_done(programme_batch* batch) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int polls = 1;
+	while (!programme_batch_poll(batch)) {
+		if (std::chrono::steady_clock::now() - start > std::chrono::seconds(POLL_TIMEOUT_S)) {
+			return -1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		polls++;
+	}
+	return polls;
+}
+
+static void check_linked(const char* what, GLuint programme) {
+	GLint linked = GL_FALSE;
+	if (programme) {
+		glGetProgramiv(programme, GL_LINK_STATUS, &linked);
+	}
+	if (linked != GL_TRUE) {
+		fail(what, "did not link");
+	} else {
+		printf("ok   %s\n", what);
+	}
+}
+
+// the programme has to come back as 0, with file_name named in what was logged
+static void check_failed(const char* what, programme_batch* batch, int handle, const char* file_name) {
+	size_t from = log_size();
+	GLuint programme = programme_batch_get(batch, handle);
+	if (programme != 0) {
+		fail(what, "built");
+	} else if (check_logged(what, from, file_name)) {
+		printf("ok   %s\n", what);
+	}
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	if (!write_text_file(VERT_FILE, "#version 410\nin vec3 vp;\nvoid main() { gl_Position = vec4(vp, 1.0); }\n") ||
+		!write_text_file(FRAG_FILE, "#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = COLOUR; }\n") ||
+		!write_text_file(BROKEN_FRAG_FILE, "#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = not_declared; }\n")) {
+		printf("FAIL could not write the test shaders\n");
+		return 1;
+	}
+	remove(MISSING_FILE);
+
+	programme_batch batch;
+	int good[N_GOOD];
+	for (int i = 0; i < N_GOOD; i++) {
+		char defines[64];
+		snprintf(defines, sizeof(defines), "#define COLOUR vec4(%i.0 / %i.0, 0.0, 0.0, 1.0)\n", i, N_GOOD);
+		good[i] = programme_batch_add(&batch, VERT_FILE, FRAG_FILE, defines);
+	}
+	int broken = programme_batch_add(&batch, VERT_FILE, BROKEN_FRAG_FILE, NULL);
+	int missing = programme_batch_add(&batch, VERT_FILE, MISSING_FILE, NULL);
+	if (programme_batch_ready(&batch, good[0]) || programme_batch_poll(&batch)) {
+		fail("before submit", "a queued programme reported ready");
+	}
+
+	size_t from = log_size();
+	programme_batch_submit(&batch);
+	// the batch has to have switched on the driver's compile threads if there are any
+	bool has_parallel = gl_extension_supported("GL_KHR_parallel_shader_compile") || gl_extension_supported("GL_ARB_parallel_shader_compile");
+	check_logged("submit", from, has_parallel ? "parallel shader compile: yes" : "parallel shader compile: no");
+	int polls = poll_until_done(&batch);
+	if (polls < 0) {
+		fail("poll", "the batch never finished");
+		return 1;
+	}
+	printf("ok   batch ready after %i polls (%s)\n", polls, has_parallel ? "GL_COMPLETION_STATUS_KHR" : "no parallel compile");
+
+	for (int i = 0; i < N_GOOD; i++) {
+		char what[64];
+		snprintf(what, sizeof(what), "programme %i of %i", i + 1, N_GOOD);
+		check_linked(what, programme_batch_get(&batch, good[i]));
+	}
+	check_failed("fragment shader that doesn't compile", &batch, broken, BROKEN_FRAG_FILE);
+	if (programme_batch_get(&batch, missing) != 0) {
+		fail("missing shader file", "built");
+	} else {
+		printf("ok   missing shader file\n");
+	}
+	// asking again gives the same answer without touching GL
+	if (programme_batch_get(&batch, good[0]) == 0 || programme_batch_get(&batch, broken) != 0) {
+		fail("second get", "changed its answer");
+	}
+
+	// only the new job is built by the second submit
+	GLuint first = programme_batch_get(&batch, good[0]);
+	int late = programme_batch_add(&batch, VERT_FILE, FRAG_FILE, "#define COLOUR vec4(1.0)\n");
+	programme_batch_submit(&batch);
+	if (poll_until_done(&batch) < 0) {
+		fail("second submit", "never finished");
+		return 1;
+	}
+	check_linked("programme added after the first submit", programme_batch_get(&batch, late));
+	if (programme_batch_get(&batch, good[0]) != first) {
+		fail("second submit", "rebuilt a programme from the first");
+	}
+
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
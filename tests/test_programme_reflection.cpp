@@ -0,0 +1,197 @@
+/* reflects a programme with enough uniforms that the hash table has to probe
+past collisions, a uniform array, an attribute array and a name longer than
+any fixed buffer would have held, and checks every handle's location against
+glGetUniformLocation() / glGetAttribLocation(). then checks that the setters
+write the value and that setting it again is skipped by the gl_state cache.
+exits 77 (skipped) if there is no headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "programme_reflection.h"
+#include "shader_cache.h"
+#include "test_common.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_programme_reflection needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+// single floats, so the table gets well past its first 16 slots
+#define N_SCALARS 24
+#define N_COLOURS 4
+#define LONG_NAME "a_uniform_name_long_enough_to_have_overrun_the_old_fixed_size_name_buffers_in_print_all"
+
+int g_gl_width = 64;
+int g_gl_height = 64;
+GLFWwindow* g_window = NULL;
+
+static std::string vertex_source() {
+	std::string src = "#version 410\nin vec3 vp;\nin vec4 weights[2];\nuniform vec4 colours[" + std::to_string(N_COLOURS) +
+		"];\nuniform mat4 model;\nuniform vec3 " LONG_NAME ";\n";
+	for (int i = 0; i < N_SCALARS; i++) {
+		src += "uniform float s" + std::to_string(i) + ";\n";
+	}
+	src += "out vec4 colour;\nvoid main() {\n  float sum = 0.0;\n";
+	for (int i = 0; i < N_SCALARS; i++) {
+		src += "  sum += s" + std::to_string(i) + ";\n";
+	}
+	src += "  colour = colours[0] + colours[1] + colours[2] + colours[3] + weights[0] + weights[1] + vec4(" LONG_NAME ", sum);\n";
+	src += "  gl_Position = model * vec4(vp, 1.0);\n}\n";
+	return src;
+}
+
+static const char* g_fragment_source = "#version 410\nin vec4 colour;\nout vec4 frag_colour;\nvoid main() { frag_colour = colour; }\n";
+
+static GLuint build_programme() {
+	std::string vert_src = vertex_source();
+	GLuint vs, fs, programme;
+	if (!create_shader_from_source("reflection test vs", vert_src.data(), vert_src.size(), NULL, &vs, GL_VERTEX_SHADER) ||
+		!create_shader_from_source("reflection test fs", g_fragment_source, strlen(g_fragment_source), NULL, &fs, GL_FRAGMENT_SHADER) ||
+		!create_programme(vs, fs, &programme)) {
+		return 0;
+	}
+	return programme;
+}
+
+static void check_uniform(const programme_reflection* refl, const char* name) {
+	GLint want = glGetUniformLocation(refl->programme, name);
+	GLint got = handle_location(refl, uniform_handle(refl, name));
+	if (want < 0 || got != want) {
+		printf("FAIL uniform %s: location %i, glGetUniformLocation says %i\n", name, got, want);
+		g_failures++;
+	}
+}
+
+static void check_attribute(const programme_reflection* refl, const char* name) {
+	GLint want = glGetAttribLocation(refl->programme, name);
+	GLint got = handle_location(refl, attribute_handle(refl, name));
+	if (want < 0 || got != want) {
+		printf("FAIL attribute %s: location %i, glGetAttribLocation says %i\n", name, got, want);
+		g_failures++;
+	}
+}
+
+static void check_missing(const programme_reflection* refl, const char* name, bool is_uniform) {
+	int handle = is_uniform ? uniform_handle(refl, name) : attribute_handle(refl, name);
+	if (handle != -1) {
+		printf("FAIL %s %s: found, handle %i\n", is_uniform ? "uniform" : "attribute", name, handle);
+		g_failures++;
+	}
+}
+
+// the setter calls since the last check that reached GL and that were skipped
+static void check_counters(const char* what, unsigned long long issued, unsigned long long skipped) {
+	const gl_state_counters* counters = gl_state_get_counters();
+	if (counters->issued != issued || counters->skipped != skipped) {
+		printf("FAIL %s: %llu issued (want %llu), %llu skipped (want %llu)\n", what, counters->issued, issued, counters->skipped, skipped);
+		g_failures++;
+	} else {
+		printf("ok   %s\n", what);
+	}
+	gl_state_reset_counters();
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	GLuint programme = build_programme();
+	if (!programme) {
+		printf("FAIL could not build the test programme\n");
+		return 1;
+	}
+	programme_reflection refl;
+	if (!build_programme_reflection(programme, &refl)) {
+		printf("FAIL could not reflect the test programme\n");
+		return 1;
+	}
+
+	/* every name is found wherever it landed. at most half full, so with this
+	many names some have to have been pushed past their home slot */
+	size_t mask = refl.slots.size() - 1, displaced = 0;
+	for (size_t slot = 0; slot < refl.slots.size(); slot++) {
+		int index = refl.slots[slot];
+		if (index >= 0 && (refl.vars[index].hash & mask) != slot) {
+			displaced++;
+		}
+	}
+	if (refl.vars.size() * 2 > refl.slots.size() || displaced == 0) {
+		printf("FAIL hash table: %u names in %u slots, %u off their home slot\n", (unsigned int)refl.vars.size(), (unsigned int)refl.slots.size(),
+			(unsigned int)displaced);
+		g_failures++;
+	} else {
+		printf("ok   hash table: %u names in %u slots, %u off their home slot\n", (unsigned int)refl.vars.size(), (unsigned int)refl.slots.size(),
+			(unsigned int)displaced);
+	}
+	for (size_t i = 0; i < refl.vars.size(); i++) {
+		const reflected_var* var = &refl.vars[i];
+		int handle = var->is_uniform ? uniform_handle(&refl, var->name.c_str()) : attribute_handle(&refl, var->name.c_str());
+		if (handle != (int)i || var->hash != hash_bytes(var->name.data(), var->name.size())) {
+			printf("FAIL %s: handle %i, want %i\n", var->name.c_str(), handle, (int)i);
+			g_failures++;
+		}
+	}
+
+	int failures_before = g_failures;
+	for (int i = 0; i < N_SCALARS; i++) {
+		check_uniform(&refl, ("s" + std::to_string(i)).c_str());
+	}
+	check_uniform(&refl, "model");
+	check_uniform(&refl, LONG_NAME);
+	// arrays by the bare name and by each element
+	check_uniform(&refl, "colours");
+	for (int i = 0; i < N_COLOURS; i++) {
+		check_uniform(&refl, ("colours[" + std::to_string(i) + "]").c_str());
+	}
+	check_attribute(&refl, "vp");
+	check_attribute(&refl, "weights");
+	check_attribute(&refl, "weights[1]");
+	check_missing(&refl, "not_there", true);
+	check_missing(&refl, "colours[4]", true);
+	check_missing(&refl, "vp", true); // an attribute, not a uniform
+	check_missing(&refl, "model", false);
+	if (g_failures == failures_before) {
+		printf("ok   locations match glGetUniformLocation / glGetAttribLocation\n");
+	}
+
+	// the setters write through, and an unchanged value never reaches GL again
+	int colour = uniform_handle(&refl, "colours[2]");
+	int scalar = uniform_handle(&refl, "s5");
+	gl_state_reset_counters();
+	set_uniform4f(&refl, colour, 0.25f, 0.5f, 0.75f, 1.0f);
+	set_uniform1f(&refl, scalar, 2.0f);
+	check_counters("first set of each uniform", 2, 0);
+	set_uniform4f(&refl, colour, 0.25f, 0.5f, 0.75f, 1.0f);
+	set_uniform1f(&refl, scalar, 2.0f);
+	check_counters("setting the same values again", 0, 2);
+	set_uniform4f(&refl, colour, 0.25f, 0.5f, 0.75f, 0.5f);
+	check_counters("changing one component", 1, 0);
+	set_uniform1f(&refl, -1, 1.0f);
+	check_counters("-1 handle", 0, 0);
+
+	float got[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glGetUniformfv(programme, handle_location(&refl, colour), got);
+	if (got[0] != 0.25f || got[1] != 0.5f || got[2] != 0.75f || got[3] != 0.5f) {
+		printf("FAIL colours[2] reads back as %.2f %.2f %.2f %.2f\n", got[0], got[1], got[2], got[3]);
+		g_failures++;
+	}
+	glGetUniformfv(programme, handle_location(&refl, scalar), got);
+	if (got[0] != 2.0f) {
+		printf("FAIL s5 reads back as %.2f\n", got[0]);
+		g_failures++;
+	}
+
+	glDeleteProgram(programme);
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,122 @@
+/* checks render_queue_sort() against std::stable_sort on the same keys. the
+sort is CPU only, so the queue is made by render_queue_alloc() without the GL
+half of render_queue_create(). every case is sorted twice - the second sort
+has to give the same answer as the first. exits non-zero on any failure */
+
+#include "render_queue.h"
+#include "test_common.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+static render_item make_item(GLuint programme, GLuint vao, GLuint material, float depth, GLint first) {
+	render_item item;
+	memset(&item, 0, sizeof(item));
+	item.programme = programme;
+	item.vao = vao;
+	item.material = material;
+	item.depth = depth;
+	item.index_type = GL_UNSIGNED_INT;
+	item.first = first;
+	item.count = 36;
+	return item;
+}
+
+/* the order has to be the stable sort of the submitted keys, and each sorted
+key has to be the key of the item it's paired with */
+static void check_sorted(const char* what, const render_queue* rq) {
+	size_t n = rq->n_items;
+	std::vector<unsigned int> want(n);
+	for (size_t i = 0; i < n; i++) {
+		want[i] = (unsigned int)i;
+	}
+	std::stable_sort(want.begin(), want.end(), [rq](unsigned int a, unsigned int b) { return rq->keys[a] < rq->keys[b]; });
+	for (size_t i = 0; i < n; i++) {
+		if (rq->order[i] != want[i] || rq->sorted_keys[i] != rq->keys[rq->order[i]]) {
+			printf("FAIL %s: position %u has item %u (want %u), key %016llx for item key %016llx\n", what, (unsigned int)i, rq->order[i], want[i],
+				rq->sorted_keys[i], rq->keys[rq->order[i]]);
+			g_failures++;
+			return;
+		}
+	}
+}
+
+static void sort_twice(const char* what, render_queue* rq) {
+	char name[128];
+	render_queue_sort(rq);
+	snprintf(name, sizeof(name), "%s, first sort", what);
+	check_sorted(name, rq);
+	render_queue_sort(rq);
+	snprintf(name, sizeof(name), "%s, second sort", what);
+	check_sorted(name, rq);
+}
+
+int main() {
+	render_queue rq;
+	render_queue_alloc(&rq, 100000);
+
+	render_queue_begin(&rq);
+	sort_twice("empty queue", &rq);
+
+	// programmes {3, 1, 2, 1}, the second and fourth instanced
+	render_queue_begin(&rq);
+	render_item item = make_item(3, 1, 0, 1.0f, 0);
+	render_queue_submit(&rq, &item);
+	item = make_item(1, 1, 0, 1.0f, 0);
+	render_queue_submit_instance(&rq, &item, identity_mat4());
+	item = make_item(2, 1, 0, 1.0f, 0);
+	render_queue_submit(&rq, &item);
+	item = make_item(1, 1, 0, 1.0f, 0);
+	render_queue_submit_instance(&rq, &item, identity_mat4());
+	sort_twice("four programmes", &rq);
+	if (rq.items[rq.order[0]].programme != 1 || rq.items[rq.order[3]].programme != 3 || !((rq.sorted_keys[0] >> 31) & 1)) {
+		fail("four programmes", "wrong items or instanced flags after sorting twice");
+	}
+
+	// a few of everything, so most key bytes vary and every radix pass runs
+	std::mt19937 rng(1234);
+	render_queue_begin(&rq);
+	for (int i = 0; i < 100000; i++) {
+		item = make_item(1 + rng() % 8, 1 + rng() % 40, rng() % 300, (float)(rng() % 10000) / 100.0f, (GLint)(rng() % 64) * 144);
+		if (rng() % 2) {
+			render_queue_submit_instance(&rq, &item, identity_mat4());
+		} else {
+			render_queue_submit(&rq, &item);
+		}
+	}
+	sort_twice("100000 random items", &rq);
+
+	// duplicate keys keep submission order
+	render_queue_begin(&rq);
+	for (int i = 0; i < 1000; i++) {
+		item = make_item(1 + i % 3, 1, 0, 0.0f, 0);
+		render_queue_submit(&rq, &item);
+	}
+	sort_twice("equal keys", &rq);
+
+	// past max_items is dropped, not written
+	render_queue rq_small;
+	render_queue_alloc(&rq_small, 2);
+	render_queue_begin(&rq_small);
+	for (int i = 0; i < 3; i++) {
+		render_queue_submit(&rq_small, &item);
+	}
+	if (rq_small.n_items != 2 || rq_small.stats.dropped != 1) {
+		printf("FAIL overflow: %u items, %u dropped\n", (unsigned int)rq_small.n_items, rq_small.stats.dropped);
+		g_failures++;
+	}
+
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
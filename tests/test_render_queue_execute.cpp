@@ -0,0 +1,350 @@
+/* draws a frame through render_queue_execute() on the headless context. the
+scene has three instanced meshes sharing a programme and VAO, two runs of
+indexed draws, a run of non-indexed draws and one draw with a texture of its
+own, all submitted shuffled. every draw is a small triangle in a cell of its
+own on an 8 x 8 grid, so a run cut in the wrong place, or instances reading the
+wrong matrices, leaves cells dark or lights the wrong ones. checks the runs it
+was split into, each instanced run's first_matrix, the stats and the pixels.
+the frame is drawn once with multi draw indirect, when the context has it,
+checking the commands that went up to the indirect buffer, and once with
+glMultiDrawElementsBaseVertex(), and the two have to give the same pixels.
+exits 77 (skipped) if there is no headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "render_queue.h"
+#include "test_common.h"
+#include "vertex_format.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_render_queue_execute needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define GRID_SIDE 8
+#define CELL_PIXELS 8
+#define N_CELLS (GRID_SIDE * GRID_SIDE)
+// cells drawn by the scene, 0 to N_DRAWN - 1
+#define N_DRAWN 21
+#define N_RUNS 7
+#define N_INSTANCED 10
+// the indexed plain draws, cells 10-13 and 18-20
+#define N_COMMANDS 7
+
+int g_gl_width = GRID_SIDE * CELL_PIXELS;
+int g_gl_height = GRID_SIDE * CELL_PIXELS;
+GLFWwindow* g_window = NULL;
+
+struct scene {
+	GLuint instanced_programme;
+	GLuint plain_programme;
+	GLuint vbo;
+	GLuint ibo;
+	GLuint instanced_vao; // also used by the non-indexed plain draws, with plain_programme
+	GLuint plain_vao;
+	GLuint indexed_vao; // a second state for plain indexed draws
+	GLuint texture;
+};
+
+struct scene_draw {
+	render_item item;
+	bool instanced;
+	mat4 model;
+};
+
+static const char* g_instanced_vs = "#version 410\nlayout(location = 0) in vec3 vp;\nlayout(location = 2) in mat4 instance_matrix;\n"
+									"void main() { gl_Position = instance_matrix * vec4(vp, 1.0); }\n";
+static const char* g_plain_vs = "#version 410\nlayout(location = 0) in vec3 vp;\nvoid main() { gl_Position = vec4(vp, 1.0); }\n";
+static const char* g_fs = "#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = vec4(1.0); }\n";
+
+static GLuint build_programme(const char* vert_src) {
+	GLuint vs, fs, programme;
+	if (!create_shader_from_source("render queue test vs", vert_src, strlen(vert_src), NULL, &vs, GL_VERTEX_SHADER) ||
+		!create_shader_from_source("render queue test fs", g_fs, strlen(g_fs), NULL, &fs, GL_FRAGMENT_SHADER) ||
+		!create_programme(vs, fs, &programme)) {
+		return 0;
+	}
+	return programme;
+}
+
+static vec3 cell_centre(int cell) {
+	const float cell_size = 2.0f / GRID_SIDE;
+	return vec3(((cell % GRID_SIDE) + 0.5f) * cell_size - 1.0f, ((cell / GRID_SIDE) + 0.5f) * cell_size - 1.0f, 0.0f);
+}
+
+// the first vertex of the triangle already sitting in cell, for the plain draws
+static GLint cell_vertex(int cell) { return 3 * (cell + 1); }
+
+/* vertices 0 to 2 are a triangle round the origin for the instanced draws,
+then one triangle in each cell. the indices are 0 1 2 twice, so a mesh can
+start at byte 0 or byte 12 */
+static bool build_scene(scene* s) {
+	s->instanced_programme = build_programme(g_instanced_vs);
+	s->plain_programme = build_programme(g_plain_vs);
+	if (!s->instanced_programme || !s->plain_programme) {
+		return false;
+	}
+	// smaller than half a cell, so a triangle never reaches a neighbour's centre
+	const float size = 0.4f * 2.0f / GRID_SIDE;
+	std::vector<float> points;
+	for (int block = 0; block <= N_CELLS; block++) {
+		vec3 c = block == 0 ? vec3(0.0f, 0.0f, 0.0f) : cell_centre(block - 1);
+		float corners[9] = { c.v[0], c.v[1] + size, 0.0f, c.v[0] + size, c.v[1] - size, 0.0f, c.v[0] - size, c.v[1] - size, 0.0f };
+		points.insert(points.end(), corners, corners + 9);
+	}
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	const float* sources[] = { points.data() };
+	s->vbo = create_interleaved_vbo(&fmt, sources, points.size() / 3);
+
+	GLuint indices[6] = { 0, 1, 2, 0, 1, 2 };
+	glGenBuffers(1, &s->ibo);
+	// the element buffer binding is part of each VAO, which is still bound
+	s->instanced_vao = create_vao_for_format(&fmt, s->vbo);
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, s->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	s->plain_vao = create_vao_for_format(&fmt, s->vbo);
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, s->ibo);
+	s->indexed_vao = create_vao_for_format(&fmt, s->vbo);
+	gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, s->ibo);
+
+	unsigned char white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &s->texture);
+	gl_state_bind_texture(0, s->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	return glGetError() == GL_NO_ERROR;
+}
+
+static void destroy_scene(scene* s) {
+	gl_state_forget_texture(s->texture);
+	glDeleteTextures(1, &s->texture);
+	gl_state_forget_vao(s->instanced_vao);
+	gl_state_forget_vao(s->plain_vao);
+	gl_state_forget_vao(s->indexed_vao);
+	GLuint vaos[3] = { s->instanced_vao, s->plain_vao, s->indexed_vao };
+	glDeleteVertexArrays(3, vaos);
+	gl_state_forget_buffer(s->vbo);
+	gl_state_forget_buffer(s->ibo);
+	GLuint buffers[2] = { s->vbo, s->ibo };
+	glDeleteBuffers(2, buffers);
+	gl_state_forget_programme(s->instanced_programme);
+	gl_state_forget_programme(s->plain_programme);
+	glDeleteProgram(s->instanced_programme);
+	glDeleteProgram(s->plain_programme);
+}
+
+static void add_draw(std::vector<scene_draw>* draws, GLuint programme, GLuint vao, GLuint material, GLenum index_type, GLint first, GLint base_vertex,
+	bool instanced, int cell) {
+	scene_draw d;
+	memset(&d.item, 0, sizeof(d.item));
+	d.item.programme = programme;
+	d.item.vao = vao;
+	d.item.material = material;
+	d.item.depth = (float)(cell % 5);
+	d.item.index_type = index_type;
+	d.item.first = first;
+	d.item.count = 3;
+	d.item.base_vertex = base_vertex;
+	d.instanced = instanced;
+	d.model = translate(identity_mat4(), cell_centre(cell));
+	draws->push_back(d);
+}
+
+/* N_RUNS runs: instanced non-indexed (cells 0-4), instanced indexed from byte
+0 (5-6) and from byte 12 (7-9), plain indexed (10-13), plain non-indexed
+(14-16), the textured one (17) and plain indexed on another VAO (18-20).
+shuffled, so only the sort puts runs together */
+static void submit_scene(render_queue* rq, const scene* s) {
+	std::vector<scene_draw> draws;
+	for (int cell = 0; cell < 5; cell++) {
+		add_draw(&draws, s->instanced_programme, s->instanced_vao, 0, 0, 0, 0, true, cell);
+	}
+	for (int cell = 5; cell < 10; cell++) {
+		add_draw(&draws, s->instanced_programme, s->instanced_vao, 0, GL_UNSIGNED_INT, cell < 7 ? 0 : 12, 0, true, cell);
+	}
+	for (int cell = 10; cell < 14; cell++) {
+		add_draw(&draws, s->plain_programme, s->plain_vao, 0, GL_UNSIGNED_INT, cell % 2 ? 12 : 0, cell_vertex(cell), false, cell);
+	}
+	for (int cell = 14; cell < 17; cell++) {
+		add_draw(&draws, s->plain_programme, s->instanced_vao, 0, 0, cell_vertex(cell), 0, false, cell);
+	}
+	add_draw(&draws, s->plain_programme, s->plain_vao, s->texture, 0, cell_vertex(17), 0, false, 17);
+	for (int cell = 18; cell < 21; cell++) {
+		add_draw(&draws, s->plain_programme, s->indexed_vao, 0, GL_UNSIGNED_INT, cell % 2 ? 12 : 0, cell_vertex(cell), false, cell);
+	}
+	std::mt19937 rng(1234);
+	std::shuffle(draws.begin(), draws.end(), rng);
+
+	render_queue_begin(rq);
+	for (size_t i = 0; i < draws.size(); i++) {
+		if (draws[i].instanced) {
+			render_queue_submit_instance(rq, &draws[i].item, draws[i].model);
+		} else {
+			render_queue_submit(rq, &draws[i].item);
+		}
+	}
+}
+
+// a bit each for the cells with their centre pixel lit
+static unsigned long long lit_cells(const std::vector<unsigned char>& pixels) {
+	unsigned long long lit = 0;
+	for (int cell = 0; cell < N_CELLS; cell++) {
+		int x = (cell % GRID_SIDE) * CELL_PIXELS + CELL_PIXELS / 2, y = (cell / GRID_SIDE) * CELL_PIXELS + CELL_PIXELS / 2;
+		if (pixels[(y * g_gl_width + x) * 4] == 255) {
+			lit |= 1ull << cell;
+		}
+	}
+	return lit;
+}
+
+/* the runs in rq->runs: their lengths, and each instanced run's matrices have
+to start where the previous instanced run's ended */
+static bool check_runs(const render_queue* rq, std::vector<unsigned int>* lengths) {
+	unsigned int n_matrices = 0;
+	for (unsigned int r = 0; r < rq->stats.draw_calls; r++) {
+		const render_run* run = &rq->runs[r];
+		lengths->push_back(run->length);
+		if (run->instanced) {
+			if (run->first_matrix != n_matrices) {
+				return false;
+			}
+			n_matrices += run->length;
+		}
+	}
+	std::sort(lengths->begin(), lengths->end());
+	return n_matrices == N_INSTANCED;
+}
+
+/* the frame's commands all went up in one upload, one per indexed plain draw,
+and each indirect run's first_command is where the previous one's ended */
+static void check_commands(const char* what, const render_queue* rq) {
+	unsigned int n_commands = 0;
+	for (unsigned int r = 0; r < rq->stats.draw_calls; r++) {
+		const render_run* run = &rq->runs[r];
+		const render_item* first = &rq->items[rq->order[run->start]];
+		if (run->instanced || !first->index_type || run->length < 2) {
+			continue;
+		}
+		if (run->first_command != n_commands) {
+			fail(what, "a run's first_command doesn't follow on from the last");
+			return;
+		}
+		for (unsigned int k = 0; k < run->length; k++) {
+			const render_item* item = &rq->items[rq->order[run->start + k]];
+			const draw_elements_indirect_command* cmd = &rq->commands[n_commands + k];
+			if (cmd->count != 3 || cmd->instance_count != 1 || cmd->first_index != (GLuint)item->first / sizeof(GLuint) ||
+				cmd->base_vertex != item->base_vertex || cmd->base_instance != 0) {
+				fail(what, "a command doesn't match its item");
+				return;
+			}
+		}
+		n_commands += run->length;
+	}
+	draw_elements_indirect_command uploaded[N_COMMANDS];
+	gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, rq->indirect_buffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(uploaded), uploaded);
+	if (n_commands != N_COMMANDS || memcmp(uploaded, rq->commands.data(), sizeof(uploaded)) != 0) {
+		printf("FAIL %s: %u commands (want %i), %s the indirect buffer\n", what, n_commands, N_COMMANDS,
+			memcmp(uploaded, rq->commands.data(), sizeof(uploaded)) ? "not matching" : "matching");
+		g_failures++;
+	} else {
+		printf("ok   %s: %u commands in the indirect buffer\n", what, n_commands);
+	}
+}
+
+/* one frame of the scene with the indirect path on or off. the pixels are
+read back into pixels */
+static void draw_frame(const char* what, render_queue* rq, const scene* s, bool use_indirect, std::vector<unsigned char>* pixels) {
+	rq->use_indirect = use_indirect;
+	glClear(GL_COLOR_BUFFER_BIT);
+	submit_scene(rq, s);
+	gl_clear_errors();
+	render_queue_execute(rq);
+	GLenum error = glGetError();
+
+	std::vector<unsigned int> lengths;
+	bool runs_ok = check_runs(rq, &lengths);
+	const unsigned int want_lengths[N_RUNS] = { 1, 2, 3, 3, 3, 4, 5 };
+	if (!runs_ok || lengths.size() != N_RUNS || !std::equal(lengths.begin(), lengths.end(), want_lengths)) {
+		printf("FAIL %s runs: %u of them, instanced matrices %s\n", what, (unsigned int)lengths.size(), runs_ok ? "in order" : "out of order");
+		g_failures++;
+	} else {
+		printf("ok   %s runs: %i, instanced ones reading their own matrices\n", what, N_RUNS);
+	}
+	if (use_indirect) {
+		check_commands(what, rq);
+	}
+
+	// the plain non-indexed run is always a glMultiDrawArrays()
+	const render_queue_stats* st = &rq->stats;
+	unsigned int want_multi = use_indirect ? 1 : 3, want_indirect = use_indirect ? 2 : 0;
+	if (st->items != N_DRAWN || st->dropped != 0 || st->draw_calls != N_RUNS || st->instanced_draws != 3 || st->multi_draws != want_multi ||
+		st->indirect_draws != want_indirect) {
+		printf("FAIL %s stats: %u items, %u dropped, %u draw calls, %u instanced, %u multi, %u indirect (want %i, 0, %i, 3, %u, %u)\n", what,
+			st->items, st->dropped, st->draw_calls, st->instanced_draws, st->multi_draws, st->indirect_draws, N_DRAWN, N_RUNS, want_multi,
+			want_indirect);
+		g_failures++;
+	} else {
+		printf("ok   %s stats: %u items in %u draw calls\n", what, st->items, st->draw_calls);
+	}
+
+	pixels->resize(g_gl_width * g_gl_height * 4);
+	glReadPixels(0, 0, g_gl_width, g_gl_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+	unsigned long long lit = lit_cells(*pixels), want_lit = (1ull << N_DRAWN) - 1;
+	if (error != GL_NO_ERROR || lit != want_lit) {
+		printf("FAIL %s pixels: cells lit %016llx (want %016llx), GL error 0x%x\n", what, lit, want_lit, error);
+		g_failures++;
+	} else {
+		printf("ok   %s pixels: every draw in its own cell\n", what);
+	}
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	scene s;
+	if (!build_scene(&s)) {
+		printf("FAIL could not build the test scene\n");
+		return 1;
+	}
+	render_queue rq;
+	if (!render_queue_create(&rq, 1000)) {
+		printf("FAIL could not create the render queue\n");
+		return 1;
+	}
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	bool has_indirect = rq.use_indirect;
+	std::vector<unsigned char> indirect_pixels, multi_draw_pixels;
+	if (has_indirect) {
+		draw_frame("multi draw indirect", &rq, &s, true, &indirect_pixels);
+	} else {
+		printf("skipped multi draw indirect: the context doesn't have it\n");
+	}
+	draw_frame("multi draw", &rq, &s, false, &multi_draw_pixels);
+	if (has_indirect) {
+		if (indirect_pixels != multi_draw_pixels) {
+			fail("indirect against multi draw", "different pixels");
+		} else {
+			printf("ok   indirect and multi draw give the same pixels\n");
+		}
+	}
+
+	render_queue_destroy(&rq);
+	destroy_scene(&s);
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
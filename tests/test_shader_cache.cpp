@@ -0,0 +1,174 @@
+/* builds the same programme through the shader cache on the headless context
+and checks which path each build took:
+  1. empty cache         - compiled from source, binary written out
+  2. same again          - restored with glProgramBinary()
+  3. truncated file      - the header check fails, compiled from source
+  4. scribbled-on binary - the driver turns it down, compiled from source
+after each rebuild the entry is rewritten, so the build after it hits again.
+run from a directory of its own - it writes its shaders there and empties
+SHADER_CACHE_DIR below it. exits 77 (skipped) if there is no headless context
+or the driver has no binary formats, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "shader_cache.h"
+#include "test_common.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <dirent.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_shader_cache needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+#define VERT_FILE "cache_test_vs.glsl"
+#define FRAG_FILE "cache_test_fs.glsl"
+#define DEFINES "#define COLOUR vec4(1.0, 0.5, 0.0, 1.0)"
+
+int g_gl_width = 64;
+int g_gl_height = 64;
+GLFWwindow* g_window = NULL;
+
+static bool write_text_file(const char* file_name, const char* text) {
+	FILE* f = fopen(file_name, "w");
+	if (!f) {
+		return false;
+	}
+	bool ok = fputs(text, f) >= 0;
+	return fclose(f) == 0 && ok;
+}
+
+// every file in the cache directory. the test only ever has one programme in it
+static std::vector<std::string> cache_files() {
+	std::vector<std::string> files;
+	DIR* dir = opendir(SHADER_CACHE_DIR);
+	if (!dir) {
+		return files;
+	}
+	while (dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] != '.') {
+			files.push_back(std::string(SHADER_CACHE_DIR "/") + entry->d_name);
+		}
+	}
+	closedir(dir);
+	return files;
+}
+
+static bool read_file(const std::string& file_name, std::vector<char>* data) {
+	FILE* f = fopen(file_name.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+	char buffer[4096];
+	size_t n;
+	data->clear();
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		data->insert(data->end(), buffer, buffer + n);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool write_file(const std::string& file_name, const char* data, size_t size) {
+	FILE* f = fopen(file_name.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+	bool ok = fwrite(data, 1, size, f) == size;
+	return fclose(f) == 0 && ok;
+}
+
+/* builds the programme and checks it linked, and that the hit/miss/rejected
+counters moved by the given amounts */
+static void build_and_check(const char* what, int hits, int misses, int rejected) {
+	shader_cache_stats before, after;
+	shader_cache_get_stats(&before);
+	GLuint programme = create_programme_from_files_cached(VERT_FILE, FRAG_FILE, DEFINES);
+	shader_cache_get_stats(&after);
+
+	GLint linked = GL_FALSE;
+	if (programme) {
+		glGetProgramiv(programme, GL_LINK_STATUS, &linked);
+	}
+	int got_hits = (int)(after.hits - before.hits);
+	int got_misses = (int)(after.misses - before.misses);
+	int got_rejected = (int)(after.rejected - before.rejected);
+	if (linked != GL_TRUE || got_hits != hits || got_misses != misses || got_rejected != rejected) {
+		printf("FAIL %s: linked %i, hits %i (want %i), misses %i (want %i), rejected %i (want %i)\n", what, linked == GL_TRUE, got_hits, hits,
+			got_misses, misses, got_rejected, rejected);
+		g_failures++;
+	} else {
+		printf("ok   %s\n", what);
+	}
+	if (programme) {
+		glDeleteProgram(programme);
+	}
+}
+
+int main() {
+	restart_gl_log();
+	// no usable EGL driver on this box is a skip, not a failure
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	GLint n_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+	if (n_formats < 1) {
+		printf("skipped: the driver has no programme binary formats\n");
+		return 77;
+	}
+
+	/* the #version line comes after a comment, and the defines have no newline
+	on the end, to make sure both still splice in correctly */
+	if (!write_text_file(VERT_FILE, "// cache test\n#version 410\nin vec3 vp;\nvoid main() { gl_Position = vec4(vp, 1.0); }\n") ||
+		!write_text_file(FRAG_FILE, "// cache test\n#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = COLOUR; }\n")) {
+		printf("FAIL could not write the test shaders\n");
+		return 1;
+	}
+	std::vector<std::string> stale = cache_files();
+	for (size_t i = 0; i < stale.size(); i++) {
+		remove(stale[i].c_str());
+	}
+
+	build_and_check("first build compiles from source", 0, 1, 0);
+	std::vector<std::string> files = cache_files();
+	if (files.size() != 1) {
+		printf("FAIL expected 1 cache file, found %i\n", (int)files.size());
+		return 1;
+	}
+	build_and_check("second build loads the binary", 1, 0, 0);
+
+	std::vector<char> entry;
+	if (!read_file(files[0], &entry) || entry.size() < 64) {
+		printf("FAIL could not read %s\n", files[0].c_str());
+		return 1;
+	}
+
+	// cut off part way through the binary, so the length in the header is a lie
+	write_file(files[0], entry.data(), entry.size() / 2);
+	build_and_check("truncated entry falls back to a full compile", 0, 1, 1);
+	build_and_check("rewritten entry loads again", 1, 0, 0);
+
+	// header intact, binary scribbled on. it's up to the driver to spot this one
+	if (!read_file(files[0], &entry)) {
+		printf("FAIL could not read %s\n", files[0].c_str());
+		return 1;
+	}
+	for (size_t i = 32; i < entry.size(); i++) {
+		entry[i] = (char)(entry[i] ^ 0x5a);
+	}
+	write_file(files[0], entry.data(), entry.size());
+	build_and_check("corrupt binary falls back to a full compile", 0, 1, 1);
+	build_and_check("rewritten entry loads again", 1, 0, 0);
+
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
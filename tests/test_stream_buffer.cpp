@@ -0,0 +1,183 @@
+/* streams two triangles a frame through a stream buffer on the headless context,
+for more frames than there are regions, first on the persistent mapped ring
+(when the context has buffer storage) and then forced onto the orphaning
+fallback. each triangle lands in a different strip of the framebuffer,
+so drawing the wrong frame's data shows up in the pixels. checks the offsets
+walk round the regions, the fences are set and waited on, an alloc after a
+flush and draw in the same frame works on both paths, and the stats count the
+frames, orphans and an overflowing alloc. exits 77 (skipped) if there is
+no headless context, non-zero on any failure */
+
+#include "gl_utils.h"
+#include "stream_buffer.h"
+#include "test_common.h"
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+
+#ifndef GL_UTILS_HEADLESS
+#error test_stream_buffer needs gl_utils built with GL_UTILS_HEADLESS
+#endif
+
+// a whole number of float3 vertices, and of the 256 byte region alignment
+#define REGION_SIZE 3072
+#define VERTEX_SIZE (3 * sizeof(float))
+#define N_FRAMES (STREAM_BUFFER_REGIONS * 3 + 1)
+#define N_STRIPS 4
+
+int g_gl_width = 64;
+int g_gl_height = 64;
+GLFWwindow* g_window = NULL;
+
+static GLuint build_programme() {
+	const char* vert_src = "#version 410\nlayout(location = 0) in vec3 vp;\nvoid main() { gl_Position = vec4(vp, 1.0); }\n";
+	const char* frag_src = "#version 410\nout vec4 frag_colour;\nvoid main() { frag_colour = vec4(1.0); }\n";
+	GLuint vs, fs, programme;
+	if (!create_shader_from_source("stream test vs", vert_src, strlen(vert_src), NULL, &vs, GL_VERTEX_SHADER) ||
+		!create_shader_from_source("stream test fs", frag_src, strlen(frag_src), NULL, &fs, GL_FRAGMENT_SHADER) ||
+		!create_programme(vs, fs, &programme)) {
+		return 0;
+	}
+	return programme;
+}
+
+// a triangle filling most of one vertical strip of the framebuffer
+static void write_strip_triangle(float* v, int strip) {
+	float left = -1.0f + 2.0f * strip / N_STRIPS, right = left + 2.0f / N_STRIPS;
+	float corners[9] = { left, -1.0f, 0.0f, right, -1.0f, 0.0f, left, 1.0f, 0.0f };
+	memcpy(v, corners, sizeof(corners));
+}
+
+// which strips have anything drawn in them, as a bit each, from the lower left of each
+static unsigned int lit_strips() {
+	unsigned int lit = 0;
+	for (int strip = 0; strip < N_STRIPS; strip++) {
+		unsigned char pixel[4];
+		glReadPixels(strip * g_gl_width / N_STRIPS + 2, 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+		if (pixel[0] == 255) {
+			lit |= 1u << strip;
+		}
+	}
+	return lit;
+}
+
+static void stream_frames(const char* what, bool allow_persistent, GLuint programme) {
+	stream_buffer sb;
+	if (!stream_buffer_create(&sb, REGION_SIZE, allow_persistent)) {
+		fail(what, "could not create the stream buffer");
+		return;
+	}
+	if (sb.region_size != REGION_SIZE || sb.persistent != (allow_persistent && g_gl_caps.buffer_storage)) {
+		fail(what, "wrong region size or path");
+	}
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	gl_state_bind_vao(vao);
+	gl_state_bind_buffer(GL_ARRAY_BUFFER, sb.buffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, NULL);
+	gl_state_use_programme(programme);
+
+	int bad_offsets = 0, bad_fences = 0, bad_pixels = 0;
+	for (int frame = 0; frame < N_FRAMES; frame++) {
+		stream_buffer_begin_frame(&sb);
+		// the region being written can't still have a fence on it
+		if (sb.fences[sb.region]) {
+			bad_fences++;
+		}
+		// a few bytes first so the triangle's alloc has to be aligned up past them
+		size_t padding_offset, offset;
+		void* padding = stream_buffer_alloc(&sb, 5, 1, &padding_offset);
+		float* v = (float*)stream_buffer_alloc(&sb, 3 * VERTEX_SIZE, VERTEX_SIZE, &offset);
+		if (!padding || !v) {
+			fail(what, "alloc failed");
+			break;
+		}
+		size_t region_start = sb.persistent ? (size_t)(frame % STREAM_BUFFER_REGIONS) * REGION_SIZE : 0;
+		if (padding_offset != region_start || offset != region_start + VERTEX_SIZE) {
+			bad_offsets++;
+		}
+		write_strip_triangle(v, frame % N_STRIPS);
+		stream_buffer_flush(&sb);
+
+		// orphaning keeps the buffer name, so the VAO's pointer into it still holds
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLES, (GLint)(offset / VERTEX_SIZE), 3);
+
+		// more after the flush and draw, into the next strip. the first triangle has to survive it
+		size_t second_offset;
+		v = (float*)stream_buffer_alloc(&sb, 3 * VERTEX_SIZE, VERTEX_SIZE, &second_offset);
+		if (!v) {
+			fail(what, "alloc after a flush failed");
+			break;
+		}
+		if (second_offset != offset + 3 * VERTEX_SIZE) {
+			bad_offsets++;
+		}
+		write_strip_triangle(v, (frame + 1) % N_STRIPS);
+		stream_buffer_flush(&sb);
+		glDrawArrays(GL_TRIANGLES, (GLint)(offset / VERTEX_SIZE), 6);
+		stream_buffer_end_frame(&sb);
+		if (sb.persistent && !sb.fences[sb.region]) {
+			bad_fences++;
+		}
+		if (lit_strips() != ((1u << (frame % N_STRIPS)) | (1u << ((frame + 1) % N_STRIPS)))) {
+			bad_pixels++;
+		}
+	}
+
+	// more than a region's worth in one frame
+	stream_buffer_begin_frame(&sb);
+	size_t offset;
+	if (stream_buffer_alloc(&sb, REGION_SIZE + 1, 1, &offset) != NULL) {
+		fail(what, "an alloc bigger than a region succeeded");
+	}
+	stream_buffer_end_frame(&sb);
+	stream_buffer_log_stats(&sb);
+
+	const stream_buffer_stats* s = &sb.stats;
+	unsigned long long want_orphans = sb.persistent ? 0 : N_FRAMES + 1;
+	if (bad_offsets || bad_fences || bad_pixels || s->frames != N_FRAMES + 1 || s->orphans != want_orphans || s->overflows != 1) {
+		printf("FAIL %s: %i bad offsets, %i bad fences, %i frames drew the wrong strip. %llu frames (want %i), %llu orphans (want %llu), "
+			   "%llu overflows (want 1)\n",
+			what, bad_offsets, bad_fences, bad_pixels, s->frames, N_FRAMES + 1, s->orphans, want_orphans, s->overflows);
+		g_failures++;
+	} else {
+		printf("ok   %s: %llu frames, %llu fence waits, %llu orphans\n", what, s->frames, s->fence_waits, s->orphans);
+	}
+	gl_state_forget_vao(vao);
+	glDeleteVertexArrays(1, &vao);
+	stream_buffer_destroy(&sb);
+}
+
+int main() {
+	restart_gl_log();
+	if (!start_gl_headless(g_gl_width, g_gl_height)) {
+		printf("skipped: could not start a headless context\n");
+		return 77;
+	}
+	GLuint programme = build_programme();
+	if (!programme) {
+		printf("FAIL could not build the test programme\n");
+		return 1;
+	}
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	if (g_gl_caps.buffer_storage) {
+		stream_frames("persistent mapped ring", true, programme);
+	} else {
+		printf("skipped persistent mapped ring: the context has no buffer storage\n");
+	}
+	stream_frames("orphaning fallback", false, programme);
+
+	gl_state_forget_programme(programme);
+	glDeleteProgram(programme);
+	stop_gl_headless();
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,222 @@
+/* checks the CPU side of vertex_format: float_to_half() rounding to nearest
+even, into and out of the subnormals, overflowing to inf and keeping NaNs
+NaN; the normalised int types clamping and scaling; the 2_10_10_10 types'
+sign and w bits; and the offsets, stride and padding pack_vertices() lays a
+vertex out with. no GL calls. exits non-zero on any failure */
+
+#include "vertex_format.h"
+#include "gl_utils.h"
+#include "test_common.h"
+#include <GLFW/glfw3.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+static void check_half(const char* what, float f, unsigned short want) {
+	unsigned short got = float_to_half(f);
+	if (got != want) {
+		printf("FAIL half %s: %g gave 0x%04x, want 0x%04x\n", what, f, got, want);
+		g_failures++;
+	}
+}
+
+// packs one value of a single attribute and returns its bytes
+static void pack_one(vertex_attr_type type, int components, const float* in, void* out) {
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, components, type);
+	unsigned char vertex[16];
+	const float* sources[] = { in };
+	pack_vertices(&fmt, sources, 1, vertex);
+	memcpy(out, vertex, vertex_attr_size(type, components));
+}
+
+static void check_snorm8(float f, signed char want) {
+	signed char got;
+	pack_one(VA_SNORM8, 1, &f, &got);
+	if (got != want) {
+		printf("FAIL snorm8 %g: %i, want %i\n", f, got, want);
+		g_failures++;
+	}
+}
+
+static void check_unorm8(float f, unsigned char want) {
+	unsigned char got;
+	pack_one(VA_UNORM8, 1, &f, &got);
+	if (got != want) {
+		printf("FAIL unorm8 %g: %u, want %u\n", f, got, want);
+		g_failures++;
+	}
+}
+
+static void check_snorm16(float f, short want) {
+	short got;
+	pack_one(VA_SNORM16, 1, &f, &got);
+	if (got != want) {
+		printf("FAIL snorm16 %g: %i, want %i\n", f, got, want);
+		g_failures++;
+	}
+}
+
+static void check_unorm16(float f, unsigned short want) {
+	unsigned short got;
+	pack_one(VA_UNORM16, 1, &f, &got);
+	if (got != want) {
+		printf("FAIL unorm16 %g: %u, want %u\n", f, got, want);
+		g_failures++;
+	}
+}
+
+static void check_packed(const char* what, vertex_attr_type type, float x, float y, float z, float w, unsigned int want) {
+	float in[4] = { x, y, z, w };
+	unsigned int got;
+	pack_one(type, 4, in, &got);
+	if (got != want) {
+		printf("FAIL %s: (%g %g %g %g) gave 0x%08x, want 0x%08x\n", what, x, y, z, w, got, want);
+		g_failures++;
+	}
+}
+
+int main() {
+	restart_gl_log();
+	int failures_before = g_failures;
+
+	check_half("one", 1.0f, 0x3C00);
+	check_half("minus two", -2.0f, 0xC000);
+	check_half("minus zero", -0.0f, 0x8000);
+	check_half("largest", 65504.0f, 0x7BFF);
+	// halfway between two halves goes to the even one, above halfway goes up
+	check_half("tie down to even", 1.0f + ldexpf(1.0f, -11), 0x3C00);
+	check_half("tie up to even", 1.0f + 3.0f * ldexpf(1.0f, -11), 0x3C02);
+	check_half("just over halfway", 1.0f + ldexpf(1.0f, -11) + ldexpf(1.0f, -20), 0x3C01);
+	check_half("smallest normal", ldexpf(1.0f, -14), 0x0400);
+	check_half("smallest subnormal", ldexpf(1.0f, -24), 0x0001);
+	check_half("negative subnormal", -ldexpf(1.0f, -24), 0x8001);
+	check_half("largest subnormal", 1023.0f * ldexpf(1.0f, -24), 0x03FF);
+	check_half("subnormal tie to even zero", ldexpf(1.0f, -25), 0x0000);
+	check_half("subnormal over halfway", 3.0f * ldexpf(1.0f, -26), 0x0001);
+	check_half("subnormal rounding up to normal", ldexpf(1.0f, -14) - ldexpf(1.0f, -25), 0x0400);
+	check_half("underflow", ldexpf(1.0f, -26), 0x0000);
+	check_half("negative underflow", -ldexpf(1.0f, -30), 0x8000);
+	// 65520 is halfway to 65536, so it rounds out of range
+	check_half("rounding up to inf", 65520.0f, 0x7C00);
+	check_half("overflow", 1e6f, 0x7C00);
+	check_half("negative overflow", -1e6f, 0xFC00);
+	check_half("inf", std::numeric_limits<float>::infinity(), 0x7C00);
+	check_half("minus inf", -std::numeric_limits<float>::infinity(), 0xFC00);
+	unsigned short nan = float_to_half(std::numeric_limits<float>::quiet_NaN());
+	if ((nan & 0x7C00) != 0x7C00 || (nan & 0x3FF) == 0) {
+		printf("FAIL half NaN: 0x%04x is not a NaN\n", nan);
+		g_failures++;
+	}
+	if (g_failures == failures_before) {
+		printf("ok   half floats\n");
+	}
+
+	failures_before = g_failures;
+	check_snorm8(1.0f, 127);
+	check_snorm8(-1.0f, -127);
+	check_snorm8(0.5f, 64);
+	check_snorm8(2.0f, 127);
+	check_snorm8(-5.0f, -127);
+	check_unorm8(1.0f, 255);
+	check_unorm8(0.5f, 128);
+	check_unorm8(1.5f, 255);
+	check_unorm8(-0.5f, 0);
+	check_snorm16(1.0f, 32767);
+	check_snorm16(-1.0f, -32767);
+	check_snorm16(0.25f, 8192);
+	check_snorm16(-3.0f, -32767);
+	check_unorm16(1.0f, 65535);
+	check_unorm16(0.5f, 32768);
+	check_unorm16(2.0f, 65535);
+	check_unorm16(-1.0f, 0);
+	if (g_failures == failures_before) {
+		printf("ok   normalised ints\n");
+	}
+
+	// x in the low 10 bits, w in the top 2. negative values are two's complement in their field
+	failures_before = g_failures;
+	check_packed("int 2_10_10_10", VA_INT_2_10_10_10, 1.0f, -1.0f, 0.0f, 1.0f, 0x1FFu | (0x201u << 10) | (1u << 30));
+	check_packed("int 2_10_10_10 negative w", VA_INT_2_10_10_10, 0.0f, 0.0f, -1.0f, -1.0f, (0x201u << 20) | (3u << 30));
+	check_packed("int 2_10_10_10 clamped", VA_INT_2_10_10_10, 2.0f, -2.0f, 0.5f, 0.0f, 0x1FFu | (0x201u << 10) | (256u << 20));
+	check_packed("uint 2_10_10_10", VA_UINT_2_10_10_10, 1.0f, 0.0f, 0.5f, 1.0f, 1023u | (512u << 20) | (3u << 30));
+	check_packed("uint 2_10_10_10 clamped", VA_UINT_2_10_10_10, -1.0f, 2.0f, 0.0f, 0.4f, (1023u << 10) | (1u << 30));
+	if (g_failures == failures_before) {
+		printf("ok   2_10_10_10\n");
+	}
+
+	// every attribute starts 4-byte aligned and the padding is zeroed
+	failures_before = g_failures;
+	vertex_format fmt;
+	vertex_format_init(&fmt);
+	vertex_format_add(&fmt, 0, 3, VA_FLOAT);
+	vertex_format_add(&fmt, 1, 3, VA_UNORM8);
+	vertex_format_add(&fmt, 2, 2, VA_HALF);
+	vertex_format_add(&fmt, 3, 4, VA_INT_2_10_10_10);
+	vertex_format_add(&fmt, 4, 1, VA_SNORM16);
+	const size_t want_offsets[5] = { 0, 12, 16, 20, 24 };
+	for (int a = 0; a < 5; a++) {
+		if (fmt.attrs[a].offset != want_offsets[a]) {
+			printf("FAIL layout: attribute %i at %u, want %u\n", a, (unsigned int)fmt.attrs[a].offset, (unsigned int)want_offsets[a]);
+			g_failures++;
+		}
+	}
+	if (fmt.n_attrs != 5 || fmt.stride != 28) {
+		printf("FAIL layout: %i attributes, stride %u, want 5 and 28\n", fmt.n_attrs, (unsigned int)fmt.stride);
+		g_failures++;
+	}
+	float positions[6] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+	float colours[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.5f, 0.0f };
+	float uvs[4] = { 0.0f, 0.0f, 1.0f, -2.0f };
+	float normals[8] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+	float weights[2] = { 0.0f, -1.0f };
+	const float* sources[] = { positions, colours, uvs, normals, weights };
+	unsigned char packed[56];
+	memset(packed, 0xAB, sizeof(packed));
+	pack_vertices(&fmt, sources, 2, packed);
+	// the second vertex, field by field
+	const unsigned char* v = packed + 28;
+	float position[3];
+	unsigned short uv[2];
+	unsigned int normal;
+	short weight;
+	memcpy(position, v, 12);
+	memcpy(uv, v + 16, 4);
+	memcpy(&normal, v + 20, 4);
+	memcpy(&weight, v + 24, 2);
+	if (position[0] != 4.0f || position[2] != 6.0f || v[12] != 255 || v[13] != 128 || v[14] != 0 || uv[0] != 0x3C00 || uv[1] != 0xC000 ||
+		normal != (511u << 10) || weight != -32767) {
+		fail("pack_vertices", "the second vertex's fields are wrong");
+	}
+	if (v[15] != 0 || v[26] != 0 || v[27] != 0 || packed[15] != 0) {
+		fail("pack_vertices", "padding not zeroed");
+	}
+
+	// refused: a packed type without 4 components, 5 components, a 17th attribute
+	if (vertex_format_add(&fmt, 5, 3, VA_UINT_2_10_10_10) || vertex_format_add(&fmt, 5, 5, VA_FLOAT) || vertex_format_add(&fmt, 5, 0, VA_FLOAT) ||
+		fmt.n_attrs != 5 || fmt.stride != 28) {
+		fail("vertex_format_add", "took a bad component count");
+	}
+	while (fmt.n_attrs < VERTEX_FORMAT_MAX_ATTRS) {
+		vertex_format_add(&fmt, (GLuint)fmt.n_attrs, 1, VA_FLOAT);
+	}
+	if (vertex_format_add(&fmt, VERTEX_FORMAT_MAX_ATTRS, 1, VA_FLOAT)) {
+		fail("vertex_format_add", "went past VERTEX_FORMAT_MAX_ATTRS");
+	}
+	if (g_failures == failures_before) {
+		printf("ok   offsets, stride and padding\n");
+	}
+
+	if (g_failures) {
+		printf("%i failures\n", g_failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
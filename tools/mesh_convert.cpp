@@ -0,0 +1,92 @@
+/* builds .mesh cache files (see mesh_cache.h) from source assets, offline.
+
+  mesh_convert input.obj output.mesh   - parse, deduplicate, optimise and write
+                                         the cache
+  mesh_convert --no-optimise in out    - the same, keeping the file's triangle
+                                         and vertex order
+  mesh_convert --info file.mesh        - check a cache file and print its header
+
+no GL context is created - only the file and vertex packing code is used */
+
+#include "gl_utils.h"
+#include "mesh_cache.h"
+#include "mesh_optimiser.h"
+#include "obj_loader.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window = NULL;
+
+static const char* g_attr_type_names[] = { "float", "half", "snorm8", "unorm8", "snorm16", "unorm16", "int_2_10_10_10", "uint_2_10_10_10" };
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int print_info(const char* file_name) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mesh_cache_view view;
+	if (!mesh_cache_open(file_name, &view, true)) {
+		fprintf(stderr, "%s: not a valid mesh cache, see %s\n", file_name, GL_LOG_FILE);
+		return 1;
+	}
+	printf("%s: opened and verified in %.2f ms\n", file_name, ms_since(start));
+	printf("  %u vertices, %u triangles, %u bytes a vertex\n", (unsigned int)view.n_vertices, (unsigned int)(view.n_indices / 3),
+		(unsigned int)view.format.stride);
+	for (int i = 0; i < view.format.n_attrs; i++) {
+		const vertex_attr* a = &view.format.attrs[i];
+		printf("  location %u: %i x %s at offset %u\n", a->location, a->components, g_attr_type_names[a->type], (unsigned int)a->offset);
+	}
+	printf("  bounds (%g, %g, %g) to (%g, %g, %g)\n", view.bounds_min[0], view.bounds_min[1], view.bounds_min[2], view.bounds_max[0],
+		view.bounds_max[1], view.bounds_max[2]);
+	mesh_cache_close(&view);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	restart_gl_log();
+	if (argc == 3 && strcmp(argv[1], "--info") == 0) {
+		return print_info(argv[2]);
+	}
+	bool optimise = true;
+	if (argc == 4 && strcmp(argv[1], "--no-optimise") == 0) {
+		optimise = false;
+		argv++;
+		argc--;
+	}
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s [--no-optimise] input.obj output.mesh\n       %s --info file.mesh\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	obj_mesh mesh;
+	if (!load_obj(argv[1], &mesh)) {
+		fprintf(stderr, "could not load %s, see %s\n", argv[1], GL_LOG_FILE);
+		return 1;
+	}
+	double parse_ms = ms_since(start);
+
+	if (optimise) {
+		start = std::chrono::steady_clock::now();
+		mesh_opt_stats stats = optimise_obj_mesh(&mesh);
+		double optimise_ms = ms_since(start);
+		printf("optimised in %.1f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", optimise_ms, stats.before.acmr, stats.after.acmr, stats.before.atvr,
+			stats.after.atvr);
+	}
+
+	start = std::chrono::steady_clock::now();
+	if (!mesh_cache_write_obj(argv[2], &mesh)) {
+		fprintf(stderr, "could not write %s, see %s\n", argv[2], GL_LOG_FILE);
+		return 1;
+	}
+	double write_ms = ms_since(start);
+
+	printf("%s: %u vertices, %u triangles. parsed in %.1f ms, written in %.1f ms\n", argv[2], (unsigned int)mesh.n_vertices,
+		(unsigned int)(mesh.indices.size() / 3), parse_ms, write_ms);
+	return 0;
+}